@@ -38,6 +38,8 @@
 #include "cplx_wavelet_dec.h"
 #include "median.h"
 #include "iccstore.h"
+#include "StopWatch.h"
+#include "fftwplancache.h"
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -426,6 +428,7 @@ enum nrquality {QUALITY_STANDARD, QUALITY_HIGH};
 
 SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagefloat * dst, Imagefloat * calclum, float * ch_M, float *max_r, float *max_b, bool isRAW, const procparams::DirPyrDenoiseParams & dnparams, const double expcomp, const NoiseCurve & noiseLCurve, const NoiseCurve & noiseCCurve, float &chaut, float &redaut, float &blueaut, float &maxredaut, float &maxblueaut, float &nresi, float &highresi)
 {
+    BENCHFUN
 //#ifdef _DEBUG
     MyTime t1e, t2e;
     t1e.set();
@@ -699,27 +702,16 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
             // calculate min size of numblox_W.
             int min_numblox_W = ceil((static_cast<float>((MIN(imwidth, ((numtiles_W - 1) * tileWskip) + tilewidth)) - ((numtiles_W - 1) * tileWskip))) / (offset)) + 2 * blkrad;
 
-            // these are needed only for creation of the plans and will be freed before entering the parallel loop
-            fftwf_plan plan_forward_blox[2];
-            fftwf_plan plan_backward_blox[2];
+            FFTWPlanCache::Plan plan_forward_blox[2];
+            FFTWPlanCache::Plan plan_backward_blox[2];
 
             if (denoiseLuminance) {
-                float *Lbloxtmp  = reinterpret_cast<float*>( fftwf_malloc(max_numblox_W * TS * TS * sizeof (float)));
-                float *fLbloxtmp = reinterpret_cast<float*>( fftwf_malloc(max_numblox_W * TS * TS * sizeof (float)));
-
-                int nfwd[2] = {TS, TS};
-
-                //for DCT:
-                fftw_r2r_kind fwdkind[2] = {FFTW_REDFT10, FFTW_REDFT10};
-                fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
-
-                // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-                plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE || FFTW_DESTROY_INPUT  );
-                fftwf_free (Lbloxtmp);
-                fftwf_free (fLbloxtmp);
+                // The plans are kept by FFTWPlanCache, so FFTW_MEASURE is paid only once per tile row width
+                FFTWPlanCache& planCache = FFTWPlanCache::getInstance();
+                plan_forward_blox[0]  = planCache.getR2RPlan(TS, TS, max_numblox_W, FFTW_REDFT10, FFTW_REDFT10, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+                plan_backward_blox[0] = planCache.getR2RPlan(TS, TS, max_numblox_W, FFTW_REDFT01, FFTW_REDFT01, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+                plan_forward_blox[1]  = planCache.getR2RPlan(TS, TS, min_numblox_W, FFTW_REDFT10, FFTW_REDFT10, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+                plan_backward_blox[1] = planCache.getR2RPlan(TS, TS, min_numblox_W, FFTW_REDFT01, FFTW_REDFT01, FFTW_MEASURE | FFTW_DESTROY_INPUT);
             }
 
 #ifndef _OPENMP
@@ -1440,9 +1432,9 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
                                         //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
                                         //fftwf_print_plan (plan_forward_blox);
                                         if (numblox_W == max_numblox_W) {
-                                            fftwf_execute_r2r(plan_forward_blox[0], Lblox, fLblox);    // DCT an entire row of tiles
+                                            fftwf_execute_r2r(plan_forward_blox[0].get(), Lblox, fLblox);    // DCT an entire row of tiles
                                         } else {
-                                            fftwf_execute_r2r(plan_forward_blox[1], Lblox, fLblox);    // DCT an entire row of tiles
+                                            fftwf_execute_r2r(plan_forward_blox[1].get(), Lblox, fLblox);    // DCT an entire row of tiles
                                         }
 
                                         //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -1457,9 +1449,9 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
 
                                         //now perform inverse FT of an entire row of blocks
                                         if (numblox_W == max_numblox_W) {
-                                            fftwf_execute_r2r(plan_backward_blox[0], fLblox, Lblox);    //for DCT
+                                            fftwf_execute_r2r(plan_backward_blox[0].get(), fLblox, Lblox);    //for DCT
                                         } else {
-                                            fftwf_execute_r2r(plan_backward_blox[1], fLblox, Lblox);    //for DCT
+                                            fftwf_execute_r2r(plan_backward_blox[1].get(), fLblox, Lblox);    //for DCT
                                         }
 
                                         int topproc = (vblk - blkrad) * offset;
@@ -1725,15 +1717,6 @@ SSEFUNCTION void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagef
                     }
                 }
             }
-
-            if (denoiseLuminance) {
-                // destroy the plans
-                fftwf_destroy_plan(plan_forward_blox[0]);
-                fftwf_destroy_plan(plan_backward_blox[0]);
-                fftwf_destroy_plan(plan_forward_blox[1]);
-                fftwf_destroy_plan(plan_backward_blox[1]);
-                fftwf_cleanup();
-            }
         } while(memoryAllocationFailed && numTries < 2 && (options.rgbDenoiseThreadLimit == 0) && !ponder);
 
         if (memoryAllocationFailed) {
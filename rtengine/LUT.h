@@ -288,73 +288,45 @@ public:
     }
 
 #if defined( __SSE2__ ) && defined( __x86_64__ )
-/*
+    // use with float indices, same result as operator[](float) for each element
+    template<typename U = T, typename = typename std::enable_if<std::is_same<U, float>::value>::type>
     vfloat operator[](vfloat indexv ) const
     {
-//      printf("don't use this operator. It's not ready for production");
-        return _mm_setzero_ps();
-
-        // convert floats to ints
-        vint idxv =  _mm_cvttps_epi32( indexv );
-        vfloat tempv, resultv, p1v, p2v;
-        vmask maxmask = vmaskf_gt(indexv, maxsv);
-        idxv = _mm_castps_si128(vself(maxmask, maxsv, _mm_castsi128_ps(idxv)));
-        vmask minmask = vmaskf_lt(indexv, _mm_setzero_ps());
-        idxv = _mm_castps_si128(vself(minmask, _mm_setzero_ps(), _mm_castsi128_ps(idxv)));
-        // access the LUT 4 times and shuffle the values into p1v and p2v
-
-        int idx;
+        // Clamp only the indices used for the lookup, so that values outside of
+        // the range are extrapolated from the first or last segment unless
+        // clipped below. The operand order maps NaN to maxsv.
+        const vint idxv = _mm_cvttps_epi32(vmaxf(vminf(indexv, maxsv), ZEROV));
+        vfloat lowerv, upperv;
+#ifdef __AVX2__
+        lowerv = _mm_i32gather_ps(data, idxv, sizeof(float));
+        upperv = _mm_i32gather_ps(data + 1, idxv, sizeof(float));
+#else
+        int idx[4] ALIGNED16;
+        _mm_store_si128(reinterpret_cast<__m128i*>(idx), idxv);
+        lowerv = _mm_setr_ps(data[idx[0]], data[idx[1]], data[idx[2]], data[idx[3]]);
+        upperv = _mm_setr_ps(data[idx[0] + 1], data[idx[1] + 1], data[idx[2] + 1], data[idx[3] + 1]);
+#endif
+        vfloat resultv = lowerv + (upperv - lowerv) * (indexv - _mm_cvtepi32_ps(idxv));
 
-        // get 4th value
-        idx = _mm_cvtsi128_si32 (_mm_shuffle_epi32(idxv, _MM_SHUFFLE(3, 3, 3, 3)));
-        tempv = LVFU(data[idx]);
-        p1v = _mm_shuffle_ps(tempv, tempv, _MM_SHUFFLE(0, 0, 0, 0));
-        p2v = _mm_shuffle_ps(tempv, tempv, _MM_SHUFFLE(1, 1, 1, 1));
-        // now p1v is 3 3 3 3
-        //     p2v is 3 3 3 3
+        if (clip & LUT_CLIP_BELOW) {
+            resultv = vself(vmaskf_lt(indexv, ZEROV), F2V(data[0]), resultv);
+        }
 
-        // get 3rd value
-        idx = _mm_cvtsi128_si32 (_mm_shuffle_epi32(idxv, _MM_SHUFFLE(2, 2, 2, 2)));
-        tempv = LVFU(data[idx]);
-        p1v = _mm_move_ss( p1v, tempv);
-        tempv = _mm_shuffle_ps(tempv, tempv, _MM_SHUFFLE(1, 1, 1, 1));
-        p2v = _mm_move_ss( p2v, tempv);
-        // now p1v is 3 3 3 2
-        //     p2v is 3 3 3 2
+        if (clip & LUT_CLIP_ABOVE) {
+            resultv = vself(vmaskf_gt(indexv, maxsv), F2V(data[upperBound]), resultv);
+        }
 
-        // get 2nd value
-        idx = _mm_cvtsi128_si32 (_mm_shuffle_epi32(idxv, _MM_SHUFFLE(1, 1, 1, 1)));
-        tempv = LVFU(data[idx]);
-        p1v = _mm_shuffle_ps( p1v, p1v, _MM_SHUFFLE(1, 0, 1, 0));
-        p2v = _mm_shuffle_ps( p2v, p2v, _MM_SHUFFLE(1, 0, 1, 0));
-        // now p1v is 3 2 3 2
-        // now p2v is 3 2 3 2
-        p1v = _mm_move_ss( p1v, tempv );
-        // now p1v is 3 2 3 1
-        tempv = _mm_shuffle_ps(tempv, tempv, _MM_SHUFFLE(1, 1, 1, 1));
-        p2v = _mm_move_ss( p2v, tempv);
-        // now p1v is 3 2 3 1
+        return resultv;
+    }
 
-        // get 1st value
-        idx = _mm_cvtsi128_si32 (_mm_shuffle_epi32(idxv, _MM_SHUFFLE(0, 0, 0, 0)));
-        tempv = LVFU(data[idx]);
-        p1v = _mm_shuffle_ps( p1v, p1v, _MM_SHUFFLE(3, 2, 0, 0));
-        // now p1v is 3 2 1 1
-        p2v = _mm_shuffle_ps( p2v, p2v, _MM_SHUFFLE(3, 2, 0, 0));
-        // now p2v is 3 2 1 1
-        p1v = _mm_move_ss( p1v, tempv );
-        // now p1v is 3 2 1 0
-        tempv = _mm_shuffle_ps(tempv, tempv, _MM_SHUFFLE(1, 1, 1, 1));
-        p2v = _mm_move_ss( p2v, tempv);
-        // now p2v is 3 2 1 0
-
-        vfloat diffv = indexv - _mm_cvtepi32_ps ( idxv );
-        diffv = vself(vorm(maxmask, minmask), _mm_setzero_ps(), diffv);
-        resultv = p1v + p2v * diffv;
-        return resultv  ;
+#ifdef __AVX2__
+    template<typename U = T, typename = typename std::enable_if<std::is_same<U, float>::value>::type>
+    vfloat operator[](vint idxv ) const
+    {
+        idxv = _mm_max_epi32( _mm_setzero_si128(), _mm_min_epi32(idxv, sizeiv));
+        return _mm_i32gather_ps(data, idxv, sizeof(float));
     }
-*/
-#ifdef __SSE4_1__
+#elif defined( __SSE4_1__ )
     template<typename U = T, typename = typename std::enable_if<std::is_same<U, float>::value>::type>
     vfloat operator[](vint idxv ) const
     {
@@ -32,6 +32,7 @@
 #include "rt_math.h"
 #include "opthelper.h"
 #include "median.h"
+#include "StopWatch.h"
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -45,6 +46,7 @@ extern const Settings* settings;
 
 SSEFUNCTION void ImProcFunctions::PF_correct_RT(LabImage * src, LabImage * dst, double radius, int thresh)
 {
+    BENCHFUN
     const int halfwin = ceil(2 * radius) + 1;
 
     FlatCurve* chCurve = nullptr;
@@ -657,6 +659,7 @@ SSEFUNCTION void ImProcFunctions::PF_correct_RTcam(CieImage * src, CieImage * ds
 
 SSEFUNCTION void ImProcFunctions::Badpixelscam(CieImage * src, CieImage * dst, double radius, int thresh, int mode, float b_l, float t_l, float t_r, float b_r, float skinprot, float chrom, int hotbad)
 {
+    BENCHFUN
     const int halfwin = ceil(2 * radius) + 1;
     MyTime t1, t2;
     t1.set();
@@ -1265,6 +1268,7 @@ SSEFUNCTION void ImProcFunctions::Badpixelscam(CieImage * src, CieImage * dst, d
 
 SSEFUNCTION void ImProcFunctions::BadpixelsLab(LabImage * src, LabImage * dst, double radius, int thresh, int mode, float b_l, float t_l, float t_r, float b_r, float skinprot, float chrom)
 {
+    BENCHFUN
     const int halfwin = ceil(2 * radius) + 1;
     MyTime t1, t2;
     t1.set();
@@ -23,13 +23,16 @@
 #define STOPWATCH_H
 #include <iostream>
 #include "mytime.h"
+#include "profiler.h"
 
+// BENCHFUN always feeds the runtime profiler (see profiler.h), builds with
+// -DBENCHMARK additionally print the time taken to stdout
 #ifdef BENCHMARK
-    #define BENCHFUN StopWatch StopFun(__func__);
-    #define BENCHFUNMICRO StopWatch StopFun(__func__, true);
+    #define BENCHFUN PROFILE_SCOPE(__func__); StopWatch StopFun(__func__);
+    #define BENCHFUNMICRO PROFILE_SCOPE(__func__); StopWatch StopFun(__func__, true);
 #else
-    #define BENCHFUN
-    #define BENCHFUNMICRO
+    #define BENCHFUN PROFILE_SCOPE(__func__);
+    #define BENCHFUNMICRO PROFILE_SCOPE(__func__);
 #endif
 
 class StopWatch
@@ -34,12 +34,16 @@
 #include "opthelper.h"
 #include "median.h"
 #include "StopWatch.h"
+#include "cpudispatch.h"
+
+RT_TARGET_BEGIN
 
 namespace rtengine
 {
 
-SSEFUNCTION void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw, int winh, array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue)
+SSEFUNCTION void RawImageSource::RT_KERNEL(amaze_demosaic_RT)(int winx, int winy, int winw, int winh, array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue)
 {
+    RT_DISPATCH(amaze_demosaic_RT, winx, winy, winw, winh, rawData, red, green, blue)
     BENCHFUN
 
     volatile double progress = 0.0;
@@ -1585,3 +1589,5 @@ SSEFUNCTION void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw,
 
 }
 }
+
+RT_TARGET_END
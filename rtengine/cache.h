@@ -20,9 +20,12 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <list>
 #include <map>
 #include <memory>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 
@@ -47,6 +50,16 @@ namespace cache_helper
     {
     };
 
+    // Cost of a ConcurrentCache entry: one unit per entry, so the budget is an entry count
+    template<typename V>
+    struct UnitCost
+    {
+        unsigned long operator()(const V&) const
+        {
+            return 1;
+        }
+    };
+
 }
 
 template<class K, class V>
@@ -236,4 +249,319 @@ private:
     mutable LruList lru_list;
 };
 
+/**
+ * Variant of Cache for stores shared by many processing threads.
+ *
+ * The interface is the one of Cache, so a user can switch by changing the
+ * type. The differences are:
+ * - get() only takes a reader lock. Instead of moving the entry to the front
+ *   of the LRU list it sets the referenced flag of the entry, so lookups from
+ *   different threads do not serialize. Writers take the writer lock, and
+ *   eviction goes through the list from the back, like a CLOCK: an entry
+ *   referenced since it was last passed gets a second chance and moves to
+ *   the front, the first unpinned, unreferenced one is discarded.
+ * - The size is a budget in units of Cost (one per entry by default, or e.g.
+ *   the number of bytes of the value), not an entry count.
+ * - acquire() returns a value and pins its entry until release(). Pinned
+ *   entries are never discarded to make room, so the budget can be exceeded
+ *   while they are in use. remove() and clear() still drop them.
+ * - getStats() returns hit, miss and eviction counters.
+ */
+template<class K, class V, class Cost = cache_helper::UnitCost<V>>
+class ConcurrentCache
+{
+public:
+    using Hook = typename Cache<K, V>::Hook;
+
+    struct Stats {
+        unsigned long hits;
+        unsigned long misses;
+        unsigned long evictions;
+        unsigned long entries;
+        unsigned long cost;
+        unsigned long budget;
+    };
+
+    ConcurrentCache(unsigned long _budget, Hook* _hook = nullptr, const Cost& _cost = Cost()) :
+        budget(_budget),
+        total_cost(0),
+        hook(_hook),
+        cost(_cost),
+        evictions(0)
+    {
+        for (auto& counter : hits) {
+            counter.value = 0;
+        }
+        for (auto& counter : misses) {
+            counter.value = 0;
+        }
+    }
+
+    ~ConcurrentCache()
+    {
+        if (hook) {
+            MYWRITERLOCK(lock, mutex);
+            for (const auto& entry : store) {
+                hook->onDiscard(entry.first, entry.second->value);
+            }
+            hook->onDestroy();
+        }
+    }
+
+    bool get(const K& key, V& value) const
+    {
+        return lookup(key, value, false);
+    }
+
+    /** Like get(), but the entry is pinned until the matching release(). */
+    bool acquire(const K& key, V& value)
+    {
+        return lookup(key, value, true);
+    }
+
+    void release(const K& key)
+    {
+        bool over_budget = false;
+
+        {
+            MYREADERLOCK(lock, mutex);
+            const StoreConstIterator store_it = store.find(key);
+            if (store_it != store.end()) {
+                std::atomic<unsigned int>& pins = store_it->second->pins;
+                unsigned int count = pins.load(std::memory_order_relaxed);
+
+                // a release() without a matching acquire() must not wrap the count around
+                while (count > 0 && !pins.compare_exchange_weak(count, count - 1, std::memory_order_relaxed)) {
+                }
+
+                over_budget = count == 1 && total_cost > budget;
+            }
+        }
+
+        if (over_budget) {
+            MYWRITERLOCK(lock, mutex);
+            trim(budget);
+        }
+    }
+
+    bool set(const K& key, const V& value)
+    {
+        return set(key, value, Mode::UNCOND);
+    }
+
+    bool replace(const K& key, const V& value)
+    {
+        return set(key, value, Mode::KNOWN);
+    }
+
+    bool insert(const K& key, const V& value)
+    {
+        return set(key, value, Mode::UNKNOWN);
+    }
+
+    bool remove(const K& key)
+    {
+        MYWRITERLOCK(lock, mutex);
+        const StoreIterator store_it = store.find(key);
+        const bool present = store_it != store.end();
+        if (present) {
+            if (hook) {
+                hook->onRemove(store_it->first, store_it->second->value);
+            }
+            total_cost -= store_it->second->cost;
+            lru_list.erase(store_it->second->lru_list_it);
+            store.erase(store_it);
+        }
+
+        return present;
+    }
+
+    void resize(unsigned long _budget)
+    {
+        MYWRITERLOCK(lock, mutex);
+        trim(_budget);
+        budget = _budget;
+    }
+
+    void clear()
+    {
+        MYWRITERLOCK(lock, mutex);
+        if (hook) {
+            for (const auto& entry : store) {
+                hook->onRemove(entry.first, entry.second->value);
+            }
+        }
+        lru_list.clear();
+        store.clear();
+        total_cost = 0;
+    }
+
+    Stats getStats() const
+    {
+        MYREADERLOCK(lock, mutex);
+        return {
+            sum(hits),
+            sum(misses),
+            evictions,
+            static_cast<unsigned long>(store.size()),
+            total_cost,
+            budget
+        };
+    }
+
+private:
+    struct Value;
+
+    using Store = typename std::conditional<
+        cache_helper::has_hash<K>::value,
+        std::unordered_map<K, std::unique_ptr<Value>>,
+        std::map<K, std::unique_ptr<Value>>
+    >::type;
+    using StoreIterator = typename Store::iterator;
+    using StoreConstIterator = typename Store::const_iterator;
+
+    using LruList = std::list<StoreIterator>;
+    using LruListIterator = typename LruList::iterator;
+
+    struct Value {
+        V value;
+        unsigned long cost;
+        LruListIterator lru_list_it;
+        std::atomic<bool> referenced;
+        std::atomic<unsigned int> pins;
+    };
+
+    // The hit and miss counters are striped by thread, so that lookups from
+    // different threads do not write to the same cache line
+    struct Counter {
+        std::atomic<unsigned long> value;
+        char padding[64 - sizeof(std::atomic<unsigned long>)];
+    };
+
+    static constexpr std::size_t counter_stripes = 16;
+    using Counters = std::array<Counter, counter_stripes>;
+
+    enum class Mode {
+        UNCOND,
+        KNOWN,
+        UNKNOWN
+    };
+
+    static void count(Counters& counters)
+    {
+        const std::size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id()) % counter_stripes;
+        counters[stripe].value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static unsigned long sum(const Counters& counters)
+    {
+        unsigned long result = 0;
+        for (const auto& counter : counters) {
+            result += counter.value.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    bool lookup(const K& key, V& value, bool pin) const
+    {
+        MYREADERLOCK(lock, mutex);
+        const StoreConstIterator store_it = store.find(key);
+        const bool present = store_it != store.end();
+        if (present) {
+            // Only written when it changes, so that hot entries stay shared between the cores' caches
+            if (!store_it->second->referenced.load(std::memory_order_relaxed)) {
+                store_it->second->referenced.store(true, std::memory_order_relaxed);
+            }
+            if (pin) {
+                store_it->second->pins.fetch_add(1, std::memory_order_relaxed);
+            }
+            value = store_it->second->value;
+            count(hits);
+        } else {
+            count(misses);
+        }
+
+        return present;
+    }
+
+    // Discards least recently used, unpinned entries until the cost fits
+    // into max_cost. Must be called with the writer lock held.
+    void trim(unsigned long max_cost)
+    {
+        // Two rounds clear every referenced flag and reach every entry once more
+        for (std::size_t steps = 2 * lru_list.size(); total_cost > max_cost && steps > 0; --steps) {
+            const StoreIterator store_it = lru_list.back();
+            Value& v = *store_it->second;
+            if (v.pins.load(std::memory_order_relaxed) != 0 || v.referenced.exchange(false, std::memory_order_relaxed)) {
+                lru_list.splice(lru_list.begin(), lru_list, v.lru_list_it);
+                continue;
+            }
+            if (hook) {
+                hook->onDiscard(store_it->first, v.value);
+            }
+            total_cost -= v.cost;
+            lru_list.pop_back();
+            store.erase(store_it);
+            ++evictions;
+        }
+    }
+
+    bool set(const K& key, const V& value, Mode mode)
+    {
+        MYWRITERLOCK(lock, mutex);
+        const StoreIterator store_it = store.find(key);
+        const bool is_new_key = store_it == store.end();
+        const unsigned long value_cost = cost(value);
+        if (is_new_key) {
+            if (mode == Mode::UNCOND || mode == Mode::UNKNOWN) {
+                // A value larger than the whole budget is still stored, it
+                // is the first one to go on the next insertion
+                trim(value_cost < budget ? budget - value_cost : 0);
+                lru_list.push_front(store.end());
+                std::unique_ptr<Value> v(
+                    new Value{
+                        value,
+                        value_cost,
+                        lru_list.begin(),
+                        {false},
+                        {0}
+                    }
+                );
+                lru_list.front() = store.emplace(key, std::move(v)).first;
+                total_cost += value_cost;
+            }
+        } else {
+            if (mode == Mode::UNCOND || mode == Mode::KNOWN) {
+                if (hook) {
+                    hook->onDisplace(key, store_it->second->value);
+                }
+                total_cost = total_cost - store_it->second->cost + value_cost;
+                store_it->second->value = value;
+                store_it->second->cost = value_cost;
+                lru_list.splice(lru_list.begin(), lru_list, store_it->second->lru_list_it);
+                if (total_cost > budget) {
+                    const unsigned int pins = store_it->second->pins.load(std::memory_order_relaxed);
+                    // Keep the entry just set, it is the most recently used one
+                    store_it->second->pins = pins + 1;
+                    trim(budget);
+                    store_it->second->pins = pins;
+                }
+            }
+        }
+
+        return is_new_key;
+    }
+
+    unsigned long budget;
+    unsigned long total_cost;
+    Hook* const hook;
+    const Cost cost;
+    mutable MyRWMutex mutex;
+    Store store;
+    LruList lru_list;
+    mutable Counters hits;
+    mutable Counters misses;
+    unsigned long evictions;
+};
+
 }
@@ -64,7 +64,7 @@ public:
 private:
     CLUTStore();
 
-    Cache<Glib::ustring, std::shared_ptr<HaldCLUT>> cache;
+    ConcurrentCache<Glib::ustring, std::shared_ptr<HaldCLUT>> cache;
 };
 
 }
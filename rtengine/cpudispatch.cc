@@ -0,0 +1,95 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+
+#include "cpudispatch.h"
+#include "settings.h"
+
+namespace
+{
+
+rtengine::CpuTarget cpuTarget = rtengine::CpuTarget::GENERIC;
+
+bool isSupported (rtengine::CpuTarget target)
+{
+    switch (target) {
+        case rtengine::CpuTarget::GENERIC:
+            return true;
+
+        case rtengine::CpuTarget::AVX2:
+#ifdef RT_CPU_DISPATCH
+            // also checks that the OS saves the AVX registers
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+}
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+void initCpuTarget (const Glib::ustring& override)
+{
+    const Glib::ustring value = override.lowercase();
+    CpuTarget target = CpuTarget::GENERIC;
+
+    if (value.empty() || value == "auto") {
+        target = isSupported(CpuTarget::AVX2) ? CpuTarget::AVX2 : CpuTarget::GENERIC;
+    } else if (value == "avx2" && isSupported(CpuTarget::AVX2)) {
+        target = CpuTarget::AVX2;
+    } else if (value != "generic") {
+        printf("CPU target \"%s\" unknown or not supported by the processor, using the generic kernels\n", override.c_str());
+    }
+
+    cpuTarget = target;
+
+    if (settings->verbose) {
+#ifdef RT_CPU_DISPATCH
+        printf("CPU target: %s (gaussianBlur, amaze_demosaic_RT, lab2rgb)\n", getCpuTargetName(cpuTarget));
+#else
+        printf("CPU target: %s (built without run time dispatch)\n", getCpuTargetName(cpuTarget));
+#endif
+    }
+}
+
+CpuTarget getCpuTarget ()
+{
+    return cpuTarget;
+}
+
+const char* getCpuTargetName (CpuTarget target)
+{
+    switch (target) {
+        case CpuTarget::GENERIC:
+            return "generic";
+
+        case CpuTarget::AVX2:
+            return "avx2";
+    }
+
+    return "unknown";
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <glibmm/ustring.h>
+
+/*
+ * Kernels built for several instruction sets, selected at run time.
+ *
+ * With WITH_CPU_DISPATCH (GCC on x86-64), the source file of a dispatched
+ * kernel is compiled once as usual, for the instruction set of the build, and
+ * once more through a <file>_avx2.cc wrapper, which defines RT_AVX2_VARIANT
+ * before including it. In that second translation unit, the code between
+ * RT_TARGET_BEGIN and RT_TARGET_END is generated for AVX2 and FMA, and
+ * RT_KERNEL(name) renames the entry points to name_avx2.
+ *
+ * All the headers of a kernel file must be included before RT_TARGET_BEGIN:
+ * their inline functions and templates are shared with the other translation
+ * units, so they have to stay generic. They are still inlined into the AVX2
+ * code, which then uses the wider instruction set for them too. But their
+ * #ifdef __AVX2__ paths, like the gathers of the vectorized LUT lookups,
+ * follow the flags of the generic build: a kernel needing such a path has to
+ * provide its own between RT_TARGET_BEGIN and RT_TARGET_END.
+ *
+ * RT_DISPATCH(name, args...) at the start of the generic entry point calls the
+ * AVX2 variant when getCpuTarget() selected it.
+ */
+
+#if defined(RT_CPU_DISPATCH) && defined(RT_AVX2_VARIANT)
+    #define RT_TARGET_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma\")")
+    #define RT_TARGET_END _Pragma("GCC pop_options")
+    #define RT_KERNEL(name) name##_avx2
+    #define RT_DISPATCH(name, ...)
+#elif defined(RT_CPU_DISPATCH)
+    #define RT_TARGET_BEGIN
+    #define RT_TARGET_END
+    #define RT_KERNEL(name) name
+    #define RT_DISPATCH(name, ...) \
+        if (rtengine::getCpuTarget() == rtengine::CpuTarget::AVX2) { \
+            return name##_avx2(__VA_ARGS__); \
+        }
+#else
+    #define RT_TARGET_BEGIN
+    #define RT_TARGET_END
+    #define RT_KERNEL(name) name
+    #define RT_DISPATCH(name, ...)
+#endif
+
+namespace rtengine
+{
+
+enum class CpuTarget {
+    GENERIC,    // the instruction set of the build
+    AVX2        // AVX2 and FMA
+};
+
+/** Selects the variant of the dispatched kernels, to be called once at startup.
+  * @param override "auto" (or empty) for the best variant supported by the processor,
+  *                 "generic" or "avx2" to force one, if supported */
+void initCpuTarget (const Glib::ustring& override);
+
+CpuTarget getCpuTarget ();
+
+const char* getCpuTargetName (CpuTarget target);
+
+}
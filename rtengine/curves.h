@@ -800,6 +800,9 @@ class StandardToneCurve : public ToneCurve
 {
 public:
     void Apply(float& r, float& g, float& b) const;
+#if defined( __SSE2__ ) && defined( __x86_64__ )
+    void Apply(vfloat& r, vfloat& g, vfloat& b) const;
+#endif
 };
 class StandardToneCurvebw : public ToneCurve
 {
@@ -902,6 +905,17 @@ inline void StandardToneCurve::Apply (float& r, float& g, float& b) const
     g = lutToneCurve[g];
     b = lutToneCurve[b];
 }
+#if defined( __SSE2__ ) && defined( __x86_64__ )
+inline void StandardToneCurve::Apply (vfloat& r, vfloat& g, vfloat& b) const
+{
+
+    assert (lutToneCurve);
+
+    r = lutToneCurve[r];
+    g = lutToneCurve[g];
+    b = lutToneCurve[b];
+}
+#endif
 // Standard tone curve
 inline void StandardToneCurvebw::Apply (float& r, float& g, float& b) const
 {
@@ -64,9 +64,15 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <atomic>
 #include <ctime>
+#include <thread>
+#include <vector>
 #include <strings.h>
 #include <sys/types.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #if defined(DJGPP) || defined(__MINGW32__)
 #define fseeko fseek
@@ -119,6 +125,7 @@ typedef unsigned char uchar;
 typedef unsigned short ushort;
 
 #include "dcraw.h"
+#include "rawunpack.h"
 /*
    RT All global variables are defined here, and all functions that
    access them are prefixed with "CLASS".  Note that a thread-safe
@@ -256,6 +263,10 @@ void CLASS merror (void *ptr, const char *where)
 
 void CLASS derror()
 {
+#ifdef _OPENMP
+  #pragma omp critical(derror)
+#endif
+  {
   if (!data_error) {
     fprintf (stderr, "%s: ", ifname);
     if (feof(ifp))
@@ -268,6 +279,7 @@ void CLASS derror()
 #endif
   }
   data_error++;
+  }
 /*RT Issue 2467  longjmp (failure, 1);*/
 }
 
@@ -794,7 +806,7 @@ struct jhead {
   ushort *huff[6], *free[4], *row;
 };
 
-int CLASS ljpeg_start (struct jhead *jh, int info_only)
+int CLASS ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp, unsigned &zero_after_ff)
 {
   ushort c, tag, len;
   uchar data[0x10000];
@@ -858,7 +870,7 @@ void CLASS ljpeg_end (struct jhead *jh)
   free (jh->row);
 }
 
-inline int CLASS ljpeg_diff (ushort *huff)
+inline int CLASS ljpeg_diff (ushort *huff, getbithuff_t &getbithuff)
 {
   int len, diff;
 
@@ -871,7 +883,7 @@ inline int CLASS ljpeg_diff (ushort *huff)
   return diff;
 }
 
-ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
+ushort * CLASS ljpeg_row (int jrow, struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff)
 {
   int col, c, diff, pred, spred=0;
   ushort mark=0, *row[3];
@@ -888,7 +900,7 @@ ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
   FORC3 row[c] = (jh->row + ((jrow & 1) + 1) * (jh->wide*jh->clrs*((jrow+c) & 1)));
   for (col=0; col < jh->wide; col++)
     FORC(jh->clrs) {
-      diff = ljpeg_diff (jh->huff[c]);
+      diff = ljpeg_diff (jh->huff[c], getbithuff);
       if (jh->sraw && c <= jh->sraw && (col | c))
 		    pred = spred;
       else if (col) pred = row[0][-jh->clrs];
@@ -912,53 +924,146 @@ ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
 void CLASS lossless_jpeg_load_raw()
 {
   struct jhead jh;
-  int row=0, col=0;
 
   if (!ljpeg_start (&jh, 0)) return;
-  int jwide = jh.wide * jh.clrs;
-  ushort *rp[2];
-  rp[0] = ljpeg_row (0, &jh);
+  const int jwide = jh.wide * jh.clrs;
+  const INT64 start = ftell(ifp);
+
+  // Without slices the old code places the pixels by a running position when
+  // load_flags & 1 or raw_width == 3984, so the rows depend on each other
+  const bool rows_independent = cr2_slice[0] || (!(load_flags & 1) && raw_width != 3984);
+
+  // Restart intervals of whole rows can be decoded independently, as long as
+  // the predictor does not look at the row above (psv == 1, as in all CR2 files)
+  std::vector<INT64> segments;
+  int seg_rows = 0, nseg = 1;
+  if (rows_independent && jh.psv == 1 && jh.restart < INT_MAX && jh.restart % jh.wide == 0) {
+    seg_rows = jh.restart / jh.wide;
+    nseg = (jh.high + seg_rows - 1) / seg_rows;
+    const uchar *data = fdata(0, ifp);
+    for (INT64 pos = start; pos + 1 < ifp->size && (int) segments.size() < nseg - 1; pos++)
+      if (data[pos] == 0xff) {
+        if (data[pos+1] >= 0xd0 && data[pos+1] <= 0xd7)
+          segments.push_back (++pos + 1);
+        else if (data[pos+1] == 0xd9)
+          break;
+      }
+  }
 
-  for (int jrow=0; jrow < jh.high; jrow++) {
+  if (nseg > 1 && (int) segments.size() == nseg - 1) {
 #ifdef _OPENMP
-#pragma omp parallel sections
+    #pragma omp parallel for schedule(dynamic,1)
 #endif
-{
+    for (int s = 0; s < nseg; s++) {
+      // Own cursor over the file data, bit reader and row buffer for each restart interval
+      IMFILE segFile = *ifp;
+      segFile.plistener = nullptr;
+      IMFILE *segIfp = &segFile;
+      unsigned segZeroAfterFF = 1;
+      getbithuff_t segBits (this, segIfp, segZeroAfterFF);
+      struct jhead sjh = jh;
+      sjh.row = (ushort *) calloc (2 * jh.wide*jh.clrs, 4);
+      if (sjh.row) {
+        fseek (segIfp, s ? segments[s-1] : start, SEEK_SET);
+        for (int jrow = s * seg_rows; jrow < MIN(jh.high, (s + 1) * seg_rows); jrow++)
+          lossless_jpeg_copy_row (jrow, jwide, ljpeg_row (jrow, &sjh, segIfp, segBits));
+        free (sjh.row);
+      } else
+        derror();
+    }
+  } else {
+    // One thread decodes the rows into a ring buffer, the other one places them
+    int row=0, col=0;
+    const auto put_row = [&](int jrow, const ushort *rp) {
+      if (rows_independent)
+        lossless_jpeg_copy_row (jrow, jwide, rp);
+      else
+        lossless_jpeg_put_row (jrow, jwide, rp, row, col);
+    };
 #ifdef _OPENMP
-    #pragma omp section
-#endif
+    const int ring_rows = 64;
+    std::vector<ushort> ring (ring_rows * jwide);
+    std::atomic<int> produced(0), consumed(0);
+    #pragma omp parallel num_threads(2) if(jh.high > 1)
     {
-        if(jrow < jh.high - 1)
-            rp[(jrow + 1)&1] = ljpeg_row (jrow + 1, &jh);
+      if (omp_get_num_threads() < 2) {
+        for (int jrow=0; jrow < jh.high; jrow++)
+          put_row (jrow, ljpeg_row (jrow, &jh));
+      } else if (omp_get_thread_num() == 0) {
+        for (int jrow=0; jrow < jh.high; jrow++) {
+          const ushort *rp = ljpeg_row (jrow, &jh);
+          while (jrow - consumed.load (std::memory_order_acquire) >= ring_rows)
+            std::this_thread::yield();
+          memcpy (&ring[(jrow % ring_rows) * jwide], rp, jwide * sizeof(ushort));
+          produced.store (jrow + 1, std::memory_order_release);
+        }
+      } else {
+        for (int jrow=0; jrow < jh.high; jrow++) {
+          while (jrow >= produced.load (std::memory_order_acquire))
+            std::this_thread::yield();
+          put_row (jrow, &ring[(jrow % ring_rows) * jwide]);
+          consumed.store (jrow + 1, std::memory_order_release);
+        }
+      }
     }
-#ifdef _OPENMP
-     #pragma omp section
+#else
+    for (int jrow=0; jrow < jh.high; jrow++)
+      put_row (jrow, ljpeg_row (jrow, &jh));
 #endif
-    {
-    if (load_flags & 1)
-      row = jrow & 1 ? height-1-jrow/2 : jrow/2;
+  }
+  ljpeg_end (&jh);
+}
+
+/* Places a decoded row, the position only depends on jrow (see rows_independent) */
+void CLASS lossless_jpeg_copy_row (int jrow, int jwide, const ushort *rp)
+{
+  INT64 jidx = (INT64) jrow * jwide;
+
+  if (!cr2_slice[0]) {
+    int row = jidx / raw_width, col = jidx % raw_width;
     for (int jcol=0; jcol < jwide; jcol++) {
-      int val = curve[*rp[jrow&1]++];
-      if (cr2_slice[0]) {
-	int jidx = jrow*jwide + jcol;
-	int i = jidx / (cr2_slice[1]*raw_height);
-	int j;
-	if ((j = i >= cr2_slice[0]))
-		 i  = cr2_slice[0];
-	jidx -= i * (cr2_slice[1]*raw_height);
-	row = jidx / cr2_slice[1+j];
-	col = jidx % cr2_slice[1+j] + i*cr2_slice[1];
-      }
-      if (raw_width == 3984 && (col -= 2) < 0)
-	col += (row--,raw_width);
-      if ((unsigned) row < raw_height) RAW(row,col) = val;
+      if ((unsigned) row < raw_height) RAW(row,col) = curve[rp[jcol]];
       if (++col >= raw_width)
 	col = (row++,0);
     }
+    return;
+  }
+
+  const INT64 slice_size = (INT64) cr2_slice[1] * raw_height;
+  for (int jcol=0; jcol < jwide; ) {
+    int i = jidx / slice_size;
+    int j;
+    if ((j = i >= cr2_slice[0]))
+      i = cr2_slice[0];
+    const INT64 sidx = jidx - i * slice_size;
+    const int row = sidx / cr2_slice[1+j];
+    const int scol = sidx % cr2_slice[1+j];
+    // the pixels up to the end of the row of this slice go to the same image row
+    const int n = MIN(cr2_slice[1+j] - scol, jwide - jcol);
+    for (int k=0; k < n; k++) {
+      int r = row, c = scol + k + i*cr2_slice[1];
+      if (raw_width == 3984 && (c -= 2) < 0)
+	c += (r--,raw_width);
+      if ((unsigned) r < raw_height) RAW(r,c) = curve[rp[jcol+k]];
     }
+    jcol += n;
+    jidx += n;
+  }
 }
+
+/* Places a decoded row at the running position row, col */
+void CLASS lossless_jpeg_put_row (int jrow, int jwide, const ushort *rp, int &row, int &col)
+{
+  if (load_flags & 1)
+    row = jrow & 1 ? height-1-jrow/2 : jrow/2;
+  for (int jcol=0; jcol < jwide; jcol++) {
+    int val = curve[*rp++];
+    if (raw_width == 3984 && (col -= 2) < 0)
+      col += (row--,raw_width);
+    if ((unsigned) row < raw_height) RAW(row,col) = val;
+    if (++col >= raw_width)
+      col = (row++,0);
   }
-  ljpeg_end (&jh);
 }
 
 void CLASS canon_sraw_load_raw()
@@ -1051,21 +1156,24 @@ void CLASS adobe_copy_pixel (unsigned row, unsigned col, ushort **rp)
   if (tiff_samples == 2 && shot_select) (*rp)--;
 }
 
-void CLASS ljpeg_idct (struct jhead *jh)
+void CLASS ljpeg_idct (struct jhead *jh, getbithuff_t &getbithuff)
 {
   int c, i, j, len, skip, coef;
   float work[3][8][8];
-  static float cs[106] = { 0 };
+  // initialized once, also when several threads decode tiles
+  static const struct cs_table {
+    float v[106];
+    cs_table() { for (int c=0; c < 106; c++) v[c] = cos((c & 31)*rtengine::RT_PI/16)/2; }
+  } cs_init;
+  const float *cs = cs_init.v;
   static const uchar zigzag[80] =
   {  0, 1, 8,16, 9, 2, 3,10,17,24,32,25,18,11, 4, 5,12,19,26,33,
     40,48,41,34,27,20,13, 6, 7,14,21,28,35,42,49,56,57,50,43,36,
     29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,
     47,55,62,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63 };
 
-  if (!cs[0])
-    FORC(106) cs[c] = cos((c & 31)*rtengine::RT_PI/16)/2;
   memset (work, 0, sizeof work);
-  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0]) * jh->quant[0];
+  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0], getbithuff) * jh->quant[0];
   for (i=1; i < 64; i++ ) {
     len = gethuff (jh->huff[16]);
     i += skip = len >> 4;
@@ -1089,48 +1197,72 @@ void CLASS ljpeg_idct (struct jhead *jh)
 
 void CLASS lossless_dng_load_raw()
 {
-  unsigned save, trow=0, tcol=0, jwide, jrow, jcol, row, col, i, j;
-  struct jhead jh;
-  ushort *rp;
+  unsigned trow=0, tcol=0;
+  std::vector<std::pair<unsigned, unsigned>> tiles; // start of the tile in the image
+  std::vector<unsigned> offsets;
 
+  // Read the whole tile offset table first, so that the tiles can be decoded independently
   while (trow < raw_height) {
-    save = ftell(ifp);
-    if (tile_length < INT_MAX)
-      fseek (ifp, get4(), SEEK_SET);
-    if (!ljpeg_start (&jh, 0)) break;
-    jwide = jh.wide;
-    if (filters) jwide *= jh.clrs;
-    jwide /= MIN (is_raw, tiff_samples);
-    switch (jh.algo) {
-      case 0xc1:
-	jh.vpred[0] = 16384;
-	getbits(-1);
-	for (jrow=0; jrow+7 < jh.high; jrow += 8) {
-	  for (jcol=0; jcol+7 < jh.wide; jcol += 8) {
-	    ljpeg_idct (&jh);
-	    rp = jh.idct;
-	    row = trow + jcol/tile_width + jrow*2;
-	    col = tcol + jcol%tile_width;
-	    for (i=0; i < 16; i+=2)
-	      for (j=0; j < 8; j++)
-		adobe_copy_pixel (row+i, col+j, &rp);
-	  }
-	}
-	break;
-      case 0xc3:
-	for (row=col=jrow=0; jrow < jh.high; jrow++) {
-	  rp = ljpeg_row (jrow, &jh);
-	  for (jcol=0; jcol < jwide; jcol++) {
-	    adobe_copy_pixel (trow+row, tcol+col, &rp);
-	    if (++col >= tile_width || col >= raw_width)
-	      row += 1 + (col = 0);
-	  }
-	}    }
-    fseek (ifp, save+4, SEEK_SET);
+    tiles.emplace_back (trow, tcol);
+    offsets.push_back (tile_length < INT_MAX ? get4() : ftell(ifp));
     if ((tcol += tile_width) >= raw_width)
       trow += tile_length + (tcol = 0);
-    ljpeg_end (&jh);
   }
+  const unsigned end = ftell(ifp);
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic,1) if(tiles.size() > 1)
+#endif
+  for (size_t t = 0; t < tiles.size(); t++) {
+    // Each tile gets its own cursor over the (memory mapped) file data and its own bit reader
+    IMFILE tileFile = *ifp;
+    tileFile.plistener = nullptr;
+    IMFILE *tileIfp = &tileFile;
+    unsigned tileZeroAfterFF = 0;
+    getbithuff_t tileBits (this, tileIfp, tileZeroAfterFF);
+    fseek (tileIfp, offsets[t], SEEK_SET);
+    lossless_dng_decode_tile (tiles[t].first, tiles[t].second, tileIfp, tileBits, tileZeroAfterFF);
+  }
+  fseek (ifp, end, SEEK_SET);
+}
+
+void CLASS lossless_dng_decode_tile (unsigned trow, unsigned tcol, IMFILE *ifp, getbithuff_t &getbithuff, unsigned &zero_after_ff)
+{
+  unsigned jwide, jrow, jcol, row, col, i, j;
+  struct jhead jh;
+  ushort *rp;
+
+  if (!ljpeg_start (&jh, 0, ifp, zero_after_ff)) return;
+  jwide = jh.wide;
+  if (filters) jwide *= jh.clrs;
+  jwide /= MIN (is_raw, tiff_samples);
+  switch (jh.algo) {
+    case 0xc1:
+      jh.vpred[0] = 16384;
+      getbits(-1);
+      for (jrow=0; jrow+7 < jh.high; jrow += 8) {
+	for (jcol=0; jcol+7 < jh.wide; jcol += 8) {
+	  ljpeg_idct (&jh, getbithuff);
+	  rp = jh.idct;
+	  row = trow + jcol/tile_width + jrow*2;
+	  col = tcol + jcol%tile_width;
+	  for (i=0; i < 16; i+=2)
+	    for (j=0; j < 8; j++)
+	      adobe_copy_pixel (row+i, col+j, &rp);
+	}
+      }
+      break;
+    case 0xc3:
+      for (row=col=jrow=0; jrow < jh.high; jrow++) {
+	rp = ljpeg_row (jrow, &jh, ifp, getbithuff);
+	for (jcol=0; jcol < jwide; jcol++) {
+	  adobe_copy_pixel (trow+row, tcol+col, &rp);
+	  if (++col >= tile_width || col >= raw_width)
+	    row += 1 + (col = 0);
+	}
+      }
+  }
+  ljpeg_end (&jh);
 }
 
 void CLASS packed_dng_load_raw()
@@ -2259,6 +2391,32 @@ void CLASS packed_load_raw()
   if (load_flags & 1) bwide = bwide * 16 / 15;
   bite = 8 + (load_flags & 24);
   half = (raw_height+1) >> 1;
+
+  // If the rows end at word boundaries and are not interleaved, each one
+  // starts at a known position and is unpacked by a kernel for its layout
+  if (!(load_flags & 3) && tiff_bps > 0 && tiff_bps <= 16 && bwide % (bite >> 3) == 0 && !(load_flags & 64 && raw_width & 1)) {
+    const rtengine::PackedRowUnpacker unpack = rtengine::getPackedRowUnpacker (tiff_bps, bite >> 3);
+    const INT64 start = ftell(ifp);
+    const int rows = LIM((ifp->size - start) / bwide, 0, raw_height);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic,16)
+#endif
+    for (int r=0; r < rows; r++) {
+      const uchar *src = fdata(start + (INT64) r * bwide, ifp);
+      ushort *dst = raw_image + (size_t) r * raw_width;
+      if (unpack)
+        unpack (src, bwide, dst, raw_width);
+      else
+        rtengine::unpackPackedRowReference (src, bwide, dst, raw_width, tiff_bps, bite >> 3);
+      if (load_flags & 64)
+        for (int c=0; c < raw_width; c+=2)
+          std::swap (dst[c], dst[c+1]);
+    }
+    fseek (ifp, start + (INT64) rows * bwide, SEEK_SET);
+    if (rows < raw_height) derror();
+    return;
+  }
+
   for (irow=0; irow < raw_height; irow++) {
     row = irow;
     if (load_flags & 2 &&
@@ -3044,15 +3202,35 @@ void CLASS sony_arw_load_raw()
 }
 
 void CLASS sony_arw2_load_raw()
+{
+  // The rows are read from the file data directly, so they can be decoded in parallel
+  const INT64 start = ftell(ifp);
+  const int rows = LIM((ifp->size - start) / raw_width, 0, (INT64) height);
+  // one row buffer per thread, allocated before the parallel region so that every thread reaches the loop
+#ifdef _OPENMP
+  const int threads = omp_get_max_threads();
+#else
+  const int threads = 1;
+#endif
+  uchar *buffers = (uchar *) calloc ((size_t) threads * (raw_width+1), 1);
+  merror (buffers, "sony_arw2_load_raw()");
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(threads)
+#endif
 {
   uchar *data, *dp;
   ushort pix[16];
-  int row, col, val, max, min, imax, imin, sh, bit, i;
+  int col, val, max, min, imax, imin, sh, bit, i;
 
-  data = (uchar *) malloc (raw_width+1);
-  merror (data, "sony_arw2_load_raw()");
-  for (row=0; row < height; row++) {
-    fread (data, 1, raw_width, ifp);
+#ifdef _OPENMP
+  data = buffers + (size_t) omp_get_thread_num() * (raw_width+1);
+  #pragma omp for schedule(dynamic,16)
+#else
+  data = buffers;
+#endif
+  for (int row=0; row < rows; row++) {
+    memcpy (data, fdata(start + (INT64) row * raw_width, ifp), raw_width);
     for (dp=data, col=0; col < raw_width-30; dp+=16) {
       max = 0x7ff & (val = sget4(dp));
       min = 0x7ff & val >> 11;
@@ -3072,7 +3250,10 @@ void CLASS sony_arw2_load_raw()
       col -= col & 1 ? 1:31;
     }
   }
-  free (data);
+}
+  free (buffers);
+  fseek (ifp, start + (INT64) rows * raw_width, SEEK_SET);
+  if (rows < height) derror();
   maximum = curve[0x7ff << 1]; // RT: fix maximum.
   maximum = 16300; // RT: conservative white level tested on various ARW2 cameras. This constant was set in 2013-12-17, may need re-evaluation in the future.
 }
@@ -9615,11 +9796,52 @@ notraw:
 #include <zlib.h>
 #include <stdint.h>
 
+#ifdef __SSE2__
+// Running sum of bytes with a stride of factor bytes, 16 bytes at a time: log2(16 / factor)
+// shifted additions give the sums within the vector, the last sum of the previous vector is added as carry
+template<int factor>
+static void decodeDeltaBytes(Bytef * src, size_t size) {
+  __m128i carry = _mm_setzero_si128();
+  size_t col = 0;
+  for (; col + 16 <= size; col += 16) {
+    __m128i x = _mm_loadu_si128((__m128i *)(src + col));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, factor));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 2 * factor));
+    if (factor < 4) x = _mm_add_epi8(x, _mm_slli_si128(x, 4 * (factor & 3)));
+    if (factor < 2) x = _mm_add_epi8(x, _mm_slli_si128(x, 8 * (factor & 1)));
+    x = _mm_add_epi8(x, carry);
+    _mm_storeu_si128((__m128i *)(src + col), x);
+    if (factor == 1) {
+      carry = _mm_set1_epi8(src[col + 15]);
+    } else if (factor == 2) {
+      uint16_t last;
+      memcpy(&last, src + col + 14, 2);
+      carry = _mm_set1_epi16(last);
+    } else {
+      uint32_t last;
+      memcpy(&last, src + col + 12, 4);
+      carry = _mm_set1_epi32(last);
+    }
+  }
+  for (col = std::max<size_t>(col, factor); col < size; ++col) {
+    src[col] += src[col - factor];
+  }
+}
+#endif
+
 static void decodeFPDeltaRow(Bytef * src, Bytef * dst, size_t tileWidth, size_t realTileWidth, int bytesps, int factor) {
   // DecodeDeltaBytes
+#ifdef __SSE2__
+  switch (factor) {
+    case 1: decodeDeltaBytes<1>(src, realTileWidth*bytesps); break;
+    case 2: decodeDeltaBytes<2>(src, realTileWidth*bytesps); break;
+    default: decodeDeltaBytes<4>(src, realTileWidth*bytesps);
+  }
+#else
   for (size_t col = factor; col < realTileWidth*bytesps; ++col) {
     src[col] += src[col - factor];
   }
+#endif
   // Reorder bytes into the image
   // 16 and 32-bit versions depend on local architecture, 24-bit does not
   if (bytesps == 3) {
@@ -9629,14 +9851,39 @@ static void decodeFPDeltaRow(Bytef * src, Bytef * dst, size_t tileWidth, size_t
       dst[col*3 + 2] = src[col + realTileWidth*2];
     }
   } else {
+    size_t start = 0;
+#ifdef __SSE2__
+    // x86 is little endian: interleave the byte planes, least significant plane (the last one) first
+    if (bytesps == 4) {
+      for (; start + 16 <= tileWidth; start += 16) {
+        const __m128i p0 = _mm_loadu_si128((__m128i *)(src + start + realTileWidth*3));
+        const __m128i p1 = _mm_loadu_si128((__m128i *)(src + start + realTileWidth*2));
+        const __m128i p2 = _mm_loadu_si128((__m128i *)(src + start + realTileWidth));
+        const __m128i p3 = _mm_loadu_si128((__m128i *)(src + start));
+        const __m128i lo01 = _mm_unpacklo_epi8(p0, p1), hi01 = _mm_unpackhi_epi8(p0, p1);
+        const __m128i lo23 = _mm_unpacklo_epi8(p2, p3), hi23 = _mm_unpackhi_epi8(p2, p3);
+        _mm_storeu_si128((__m128i *)(dst + start*4), _mm_unpacklo_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i *)(dst + start*4 + 16), _mm_unpackhi_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i *)(dst + start*4 + 32), _mm_unpacklo_epi16(hi01, hi23));
+        _mm_storeu_si128((__m128i *)(dst + start*4 + 48), _mm_unpackhi_epi16(hi01, hi23));
+      }
+    } else if (bytesps == 2) {
+      for (; start + 16 <= tileWidth; start += 16) {
+        const __m128i p0 = _mm_loadu_si128((__m128i *)(src + start + realTileWidth));
+        const __m128i p1 = _mm_loadu_si128((__m128i *)(src + start));
+        _mm_storeu_si128((__m128i *)(dst + start*2), _mm_unpacklo_epi8(p0, p1));
+        _mm_storeu_si128((__m128i *)(dst + start*2 + 16), _mm_unpackhi_epi8(p0, p1));
+      }
+    }
+#endif
     union X { uint32_t x; uint8_t c; };
     if (((union X){1}).c) {
-		for (size_t col = 0; col < tileWidth; ++col) {
+		for (size_t col = start; col < tileWidth; ++col) {
 			for (size_t byte = 0; byte < bytesps; ++byte)
 				dst[col*bytesps + byte] = src[col + realTileWidth*(bytesps-byte-1)];  // Little endian
 		}
     } else {
-		for (size_t col = 0; col < tileWidth; ++col) {
+		for (size_t col = start; col < tileWidth; ++col) {
 			for (size_t byte = 0; byte < bytesps; ++byte)
 				dst[col*bytesps + byte] = src[col + realTileWidth*byte];
         }
@@ -9732,7 +9979,7 @@ static void copyFloatDataToInt(float * src, ushort * dst, size_t size, float max
   bool negative = false, nan = false;
 
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for reduction(||:negative,nan)
 #endif
   for (size_t i = 0; i < size; ++i) {
     if (src[i] < 0.0f) {
@@ -9793,50 +10040,42 @@ void CLASS deflate_dng_load_raw() {
     size_t tilesHigh = (raw_height + tile_length - 1) / tile_length;
     size_t tileCount = tilesWide * tilesHigh;
     //fprintf(stderr, "%dx%d tiles, %d total\n", tilesWide, tilesHigh, tileCount);
-    size_t tileOffsets[tileCount];
+    std::vector<size_t> tileOffsets(tileCount);
     for (size_t t = 0; t < tileCount; ++t) {
       tileOffsets[t] = get4();
     }
-    size_t tileBytes[tileCount];
-    uLongf maxCompressed = 0;
+    std::vector<size_t> tileBytes(tileCount);
     if (tileCount == 1) {
-      tileBytes[0] = maxCompressed = ifd->bytes;
+      tileBytes[0] = ifd->bytes;
     } else {
       fseek(ifp, ifd->bytes, SEEK_SET);
       for (size_t t = 0; t < tileCount; ++t) {
         tileBytes[t] = get4();
         //fprintf(stderr, "Tile %d at %d, size %d\n", t, tileOffsets[t], tileBytes[t]);
-        if (maxCompressed < tileBytes[t])
-          maxCompressed = tileBytes[t];
       }
     }
-    uLongf dstLen = tile_width * tile_length * 4;
+    const int bytesps = ifd->bps >> 3;
 
-#if defined(_OPENMP) && ZLIB_VER_REVISION == 8
+    // The tiles are inflated straight from the file data (zlib is thread safe),
+    // each thread only needs a buffer for the planes of one tile
+#ifdef _OPENMP
 #pragma omp parallel
 #endif
 {
-    Bytef * cBuffer = new Bytef[maxCompressed];
-    Bytef * uBuffer = new Bytef[dstLen];
+    const uLongf bufferLen = tile_width * tile_length * 4;
+    Bytef * uBuffer = new Bytef[bufferLen];
 
-#if defined(_OPENMP) && ZLIB_VER_REVISION == 8
-#pragma omp for collapse(2) nowait
-#endif
-    for (size_t y = 0; y < raw_height; y += tile_length) {
-      for (size_t x = 0; x < raw_width; x += tile_width) {
-		size_t t = (y / tile_length) * tilesWide + (x / tile_width);
-#if defined(_OPENMP) && ZLIB_VER_REVISION == 8
-#pragma omp critical
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic) nowait
 #endif
-{
-        fseek(ifp, tileOffsets[t], SEEK_SET);
-        fread(cBuffer, 1, tileBytes[t], ifp);
-}
-        int err = uncompress(uBuffer, &dstLen, cBuffer, tileBytes[t]);
+    for (size_t t = 0; t < tileCount; ++t) {
+        const size_t y = (t / tilesWide) * tile_length;
+        const size_t x = (t % tilesWide) * tile_width;
+        uLongf dstLen = bufferLen;
+        int err = tileOffsets[t] + tileBytes[t] <= (size_t) ifp->size ? uncompress(uBuffer, &dstLen, fdata(tileOffsets[t], ifp), tileBytes[t]) : Z_DATA_ERROR;
         if (err != Z_OK) {
           fprintf(stderr, "DNG Deflate: Failed uncompressing tile %d, with error %d\n", (int)t, err);
         } else if (ifd->sample_format == 3) {  // Floating point data
-          int bytesps = ifd->bps >> 3;
           size_t thisTileLength = y + tile_length > raw_height ? raw_height - y : tile_length;
           size_t thisTileWidth = x + tile_width > raw_width ? raw_width - x : tile_width;
           for (size_t row = 0; row < thisTileLength; ++row) {
@@ -9849,10 +10088,8 @@ void CLASS deflate_dng_load_raw() {
         } else {  // 32-bit Integer data
           // TODO
         }
-      }
     }
 
-    delete [] cBuffer;
     delete [] uBuffer;
 }
   }
@@ -258,17 +258,24 @@ ushort * make_decoder (const uchar *source);
 void crw_init_tables (unsigned table, ushort *huff[2]);
 int canon_has_lowbits();
 void canon_load_raw();
-int ljpeg_start (struct jhead *jh, int info_only);
+// The variants with an explicit file and bit reader allow to decode several ljpeg streams of the same file concurrently
+int ljpeg_start (struct jhead *jh, int info_only) { return ljpeg_start (jh, info_only, ifp, zero_after_ff); }
+int ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp, unsigned &zero_after_ff);
 void ljpeg_end (struct jhead *jh);
-int ljpeg_diff (ushort *huff);
-ushort * ljpeg_row (int jrow, struct jhead *jh);
+int ljpeg_diff (ushort *huff) { return ljpeg_diff (huff, getbithuff); }
+int ljpeg_diff (ushort *huff, getbithuff_t &getbithuff);
+ushort * ljpeg_row (int jrow, struct jhead *jh) { return ljpeg_row (jrow, jh, ifp, getbithuff); }
+ushort * ljpeg_row (int jrow, struct jhead *jh, IMFILE *ifp, getbithuff_t &getbithuff);
 void lossless_jpeg_load_raw();
-void ljpeg_idct (struct jhead *jh);
+void lossless_jpeg_copy_row (int jrow, int jwide, const ushort *rp);
+void lossless_jpeg_put_row (int jrow, int jwide, const ushort *rp, int &row, int &col);
+void ljpeg_idct (struct jhead *jh, getbithuff_t &getbithuff);
 
 
 void canon_sraw_load_raw();
 void adobe_copy_pixel (unsigned row, unsigned col, ushort **rp);
 void lossless_dng_load_raw();
+void lossless_dng_decode_tile (unsigned trow, unsigned tcol, IMFILE *ifp, getbithuff_t &getbithuff, unsigned &zero_after_ff);
 void packed_dng_load_raw();
 void deflate_dng_load_raw();
 void init_fuji_compr(struct fuji_compressed_params* info);
@@ -22,6 +22,7 @@
 #include "mytime.h"
 #include "refreshmap.h"
 #include "rt_math.h"
+#include "taskscheduler.h"
 
 namespace
 {
@@ -1322,6 +1323,9 @@ bool Crop::tryUpdate()
 void Crop::fullUpdate ()
 {
 
+    // admitted before taking updaterThreadStart, which the GUI thread needs to start the preview updates
+    TaskScheduler::Scope scope(TaskScheduler::Priority::DETAIL);
+
     parent->updaterThreadStart.lock ();
 
     if (parent->updaterRunning && parent->thread) {
@@ -1329,6 +1333,8 @@ void Crop::fullUpdate ()
         // causing Color::lab2rgb to return a black image on some opens
         //parent->changeSinceLast = 0;
         parent->thread->join ();
+        // the preview is done, the crop may use all the cores again
+        TaskScheduler::checkpoint();
     }
 
     if (parent->plistener) {
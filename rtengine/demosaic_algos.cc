@@ -64,6 +64,7 @@ extern const Settings* settings;
 
 void RawImageSource::eahd_demosaic ()
 {
+    BENCHFUN
     if (plistener) {
         plistener->setProgressStr (Glib::ustring::compose(M("TP_RAW_DMETHOD_PROGRESSBAR"), RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::eahd]));
         plistener->setProgress (0.0);
@@ -493,6 +494,7 @@ void RawImageSource::hphd_green (float** hpmap)
 
 void RawImageSource::hphd_demosaic ()
 {
+    BENCHFUN
     if (plistener) {
         plistener->setProgressStr (Glib::ustring::compose(M("TP_RAW_DMETHOD_PROGRESSBAR"), RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::hphd]));
         plistener->setProgress (0.0);
@@ -565,6 +567,7 @@ void RawImageSource::hphd_demosaic ()
 typedef unsigned short ushort;
 void RawImageSource::vng4_demosaic ()
 {
+    BENCHFUN
     const signed short int *cp, terms[] = {
         -2, -2, +0, -1, 0, 0x01, -2, -2, +0, +0, 1, 0x01, -2, -1, -1, +0, 0, 0x01,
         -2, -1, +0, -1, 0, 0x02, -2, -1, +0, +0, 0, 0x03, -2, -1, +0, +1, 1, 0x01,
@@ -1317,6 +1320,7 @@ void RawImageSource::jdl_interpolate_omp()  // from "Lassus"
 //TODO Tiles to reduce memory consumption
 SSEFUNCTION void RawImageSource::lmmse_interpolate_omp(int winw, int winh, array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, int iterations)
 {
+    BENCHFUN
     const int width = winw, height = winh;
     const int ba = 10;
     const int rr1 = height + 2 * ba;
@@ -1949,6 +1953,7 @@ SSEFUNCTION void RawImageSource::lmmse_interpolate_omp(int winw, int winh, array
 #define CLIPV(a) LIMV(a,zerov,c65535v)
 SSEFUNCTION void RawImageSource::igv_interpolate(int winw, int winh)
 {
+    BENCHFUN
     static const float eps = 1e-5f, epssq = 1e-5f; //mod epssq -10f =>-5f Jacques 3/2013 to prevent artifact (divide by zero)
 
     static const int h1 = 1, h2 = 2, h3 = 3, h5 = 5;
@@ -2341,6 +2346,7 @@ SSEFUNCTION void RawImageSource::igv_interpolate(int winw, int winh)
 #else
 void RawImageSource::igv_interpolate(int winw, int winh)
 {
+    BENCHFUN
     static const float eps = 1e-5f, epssq = 1e-5f; //mod epssq -10f =>-5f Jacques 3/2013 to prevent artifact (divide by zero)
     static const int h1 = 1, h2 = 2, h3 = 3, h4 = 4, h5 = 5, h6 = 6;
     const int width = winw, height = winh;
@@ -2614,6 +2620,7 @@ void RawImageSource::igv_interpolate(int winw, int winh)
 
 void RawImageSource::ahd_demosaic(int winx, int winy, int winw, int winh)
 {
+    BENCHFUN
     int i, j, k, top, left, row, col, tr, tc, c, d, val, hm[2];
     float (*pix)[4], (*rix)[3];
     static const int dir[4] = { -1, 1, -TS, TS };
@@ -2864,6 +2871,98 @@ void RawImageSource::nodemosaic(bool bw)
     }
 }
 
+/*
+ * Demosaic for the previews below 100%: the colors of each 2x2 (Bayer) or 3x3
+ * (X-Trans) cell of the CFA are averaged into one RGB value, which is copied to
+ * all the pixels of the cell. Whatever pixel a preview scaled by 1/2 (resp. 1/3)
+ * or less samples, it gets the binned value of its cell, at the cost of a single
+ * pass over the raw data. Any 2x2 window of a Bayer CFA and any 3x3 window of an
+ * X-Trans CFA holds the three colors, so the cells at the right and bottom
+ * borders are binned from the last full cell rows and columns.
+ *
+ * Returns false, leaving the planes untouched, if the CFA does not have that property.
+ */
+bool RawImageSource::binned_demosaic()
+{
+    BENCHFUN
+
+    const bool xtrans = ri->getSensorType() == ST_FUJI_XTRANS;
+    const int cell = xtrans ? 3 : 2;
+
+    if ((!xtrans && ri->getSensorType() != ST_BAYER) || W < cell || H < cell) {
+        return false;
+    }
+
+    const auto color = [this, xtrans](int row, int col) -> unsigned {
+        return xtrans ? ri->XTRANSFC(row, col) : FC(row, col);
+    };
+
+    // the filter patterns repeat every 16 rows and columns at most
+    for (int row = 0; row < 16; ++row) {
+        for (int col = 0; col < 16; ++col) {
+            unsigned found = 0;
+
+            for (int y = row; y < row + cell; ++y) {
+                for (int x = col; x < col + cell; ++x) {
+                    const unsigned c = color(y, x);
+                    found |= c < 3 ? 1 << c : 8;
+                }
+            }
+
+            if (found != 7) {
+                return false;
+            }
+        }
+    }
+
+    if (plistener) {
+        plistener->setProgressStr (Glib::ustring::compose(M("TP_RAW_DMETHOD_PROGRESSBAR"), "binned"));
+        plistener->setProgress (0.0);
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 16)
+#endif
+
+    for (int top = 0; top < H; top += cell) {
+        const int srcTop = std::min(top, H - cell);
+        const int bottom = std::min(top + cell, H);
+
+        for (int left = 0; left < W; left += cell) {
+            const int srcLeft = std::min(left, W - cell);
+            const int right = std::min(left + cell, W);
+            float sum[3] = {};
+            int count[3] = {};
+
+            for (int y = srcTop; y < srcTop + cell; ++y) {
+                for (int x = srcLeft; x < srcLeft + cell; ++x) {
+                    const unsigned c = color(y, x);
+                    sum[c] += rawData[y][x];
+                    ++count[c];
+                }
+            }
+
+            const float r = sum[0] / count[0];
+            const float g = sum[1] / count[1];
+            const float b = sum[2] / count[2];
+
+            for (int y = top; y < bottom; ++y) {
+                for (int x = left; x < right; ++x) {
+                    red[y][x] = r;
+                    green[y][x] = g;
+                    blue[y][x] = b;
+                }
+            }
+        }
+    }
+
+    if (plistener) {
+        plistener->setProgress (1.0);
+    }
+
+    return true;
+}
+
 /*
    Refinement based on EECI demosaicing algorithm by L. Chang and Y.P. Tan
    Paul Lee
@@ -4773,6 +4872,7 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab)
 #undef CLIP
 void RawImageSource::fast_xtrans_interpolate ()
 {
+    BENCHFUN
     if (settings->verbose) {
         printf("fast X-Trans interpolation...\n");
     }
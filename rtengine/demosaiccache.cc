@@ -0,0 +1,365 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#include <giomm.h>
+#include <glib/gstdio.h>
+
+#include "demosaiccache.h"
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+}
+
+namespace
+{
+
+// Bump this whenever the output of preprocess() or demosaic() changes for
+// identical parameters, so that stale entries are not used anymore
+constexpr std::uint32_t formatVersion = 1;
+constexpr char magic[8] = {'R', 'T', 'D', 'M', 'C', 'A', 'C', 'H'};
+constexpr std::size_t headerSize = 4096;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+    std::uint32_t planes;
+    char key[32];
+};
+
+static_assert(sizeof(Header) <= headerSize, "Header of demosaic cache files too large");
+
+// A temporary file this old is left over by a process that did not finish writing it
+constexpr gint64 staleTemporaryAge = 3600;
+
+bool isTemporary(const std::string& name)
+{
+    return name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0;
+}
+
+bool readPlane(FILE* f, int width, int height, array2D<float>& plane)
+{
+    for (int i = 0; i < height; ++i) {
+        if (fread(plane[i], sizeof(float), width, f) != static_cast<std::size_t>(width)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool writePlane(FILE* f, int width, int height, array2D<float>& plane)
+{
+    for (int i = 0; i < height; ++i) {
+        if (fwrite(plane[i], sizeof(float), width, f) != static_cast<std::size_t>(width)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+rtengine::DemosaicCache& rtengine::DemosaicCache::getInstance()
+{
+    static DemosaicCache instance;
+    return instance;
+}
+
+void rtengine::DemosaicCache::init(const Glib::ustring& cacheDir, bool enabled, std::size_t maxSizeMB)
+{
+    MyMutex::MyLock lock(mutex);
+
+    this->cacheDir = cacheDir;
+    this->enabled = enabled && maxSizeMB > 0;
+    maxSize = maxSizeMB << 20;
+
+    if (this->enabled && g_mkdir_with_parents(cacheDir.c_str(), 511) != 0) {
+        if (settings->verbose) {
+            printf("DemosaicCache: could not create %s, cache disabled\n", cacheDir.c_str());
+        }
+
+        this->enabled = false;
+    }
+}
+
+bool rtengine::DemosaicCache::isEnabled() const
+{
+    MyMutex::MyLock lock(mutex);
+    return enabled;
+}
+
+std::string rtengine::DemosaicCache::getKey(
+    const Glib::ustring& fname,
+    unsigned int frame,
+    const procparams::RAWParams& raw,
+    const procparams::LensProfParams& lensProf,
+    const procparams::CoarseTransformParams& coarse,
+    const Glib::ustring& darkFrame,
+    const Glib::ustring& flatField
+)
+{
+    std::ostringstream id;
+    id << std::setprecision(17);
+
+    // Same identity as CacheManager::getMD5, plus the modification time,
+    // as a file rewritten in place keeps its name and usually its size
+    try {
+        const auto file = Gio::File::create_for_path(fname);
+
+        if (!file || !file->query_exists()) {
+            return {};
+        }
+
+        const auto info = file->query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+        if (!info) {
+            return {};
+        }
+
+        id << fname << '|' << info->get_size() << '|' << info->get_attribute_uint64(G_FILE_ATTRIBUTE_TIME_MODIFIED) << '|' << frame << '|' << formatVersion;
+    } catch (Gio::Error&) {
+        return {};
+    }
+
+    const auto& bayer = raw.bayersensor;
+    id << "|bayer|" << bayer.method << '|' << bayer.imageNum << '|' << bayer.ccSteps
+       << '|' << bayer.black0 << '|' << bayer.black1 << '|' << bayer.black2 << '|' << bayer.black3
+       << '|' << bayer.twogreen << '|' << bayer.linenoise << '|' << bayer.greenthresh
+       << '|' << bayer.dcb_iterations << '|' << bayer.dcb_enhance << '|' << bayer.lmmse_iterations
+       << '|' << bayer.pixelShiftMotion << '|' << static_cast<int>(bayer.pixelShiftMotionCorrection)
+       << '|' << static_cast<int>(bayer.pixelShiftMotionCorrectionMethod)
+       << '|' << bayer.pixelShiftStddevFactorGreen << '|' << bayer.pixelShiftStddevFactorRed << '|' << bayer.pixelShiftStddevFactorBlue
+       << '|' << bayer.pixelShiftEperIso << '|' << bayer.pixelShiftNreadIso << '|' << bayer.pixelShiftPrnu
+       << '|' << bayer.pixelShiftSigma << '|' << bayer.pixelShiftSum << '|' << bayer.pixelShiftRedBlueWeight
+       << '|' << bayer.pixelShiftShowMotion << '|' << bayer.pixelShiftShowMotionMaskOnly << '|' << bayer.pixelShiftAutomatic
+       << '|' << bayer.pixelShiftNonGreenHorizontal << '|' << bayer.pixelShiftNonGreenVertical << '|' << bayer.pixelShiftHoleFill
+       << '|' << bayer.pixelShiftMedian << '|' << bayer.pixelShiftMedian3 << '|' << bayer.pixelShiftGreen
+       << '|' << bayer.pixelShiftBlur << '|' << bayer.pixelShiftSmoothFactor << '|' << bayer.pixelShiftExp0
+       << '|' << bayer.pixelShiftLmmse << '|' << bayer.pixelShiftEqualBright << '|' << bayer.pixelShiftEqualBrightChannel
+       << '|' << bayer.pixelShiftNonGreenCross << '|' << bayer.pixelShiftNonGreenCross2 << '|' << bayer.pixelShiftNonGreenAmaze;
+
+    const auto& xtrans = raw.xtranssensor;
+    id << "|xtrans|" << xtrans.method << '|' << xtrans.ccSteps
+       << '|' << xtrans.blackred << '|' << xtrans.blackgreen << '|' << xtrans.blackblue;
+
+    id << "|raw|" << darkFrame << '|' << flatField
+       << '|' << raw.ff_BlurRadius << '|' << raw.ff_BlurType << '|' << raw.ff_AutoClipControl << '|' << raw.ff_clipControl
+       << '|' << raw.ca_autocorrect << '|' << raw.caautostrength << '|' << raw.cared << '|' << raw.cablue
+       << '|' << raw.expos << '|' << raw.preser
+       << '|' << raw.hotPixelFilter << '|' << raw.deadPixelFilter << '|' << raw.hotdeadpix_thresh;
+
+    id << "|lens|" << lensProf.lcpFile << '|' << lensProf.useDist << '|' << lensProf.useVign << '|' << lensProf.useCA;
+    id << "|coarse|" << coarse.rotate << '|' << coarse.hflip << '|' << coarse.vflip;
+
+    return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, id.str());
+}
+
+bool rtengine::DemosaicCache::load(const std::string& key, int width, int height, array2D<float>& red, array2D<float>& green, array2D<float>& blue)
+{
+    if (key.empty() || !isEnabled()) {
+        return false;
+    }
+
+    const Glib::ustring fname = getFileName(key);
+    FILE* const f = g_fopen(fname.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    Header header;
+    bool ok =
+        fread(&header, sizeof(Header), 1, f) == 1
+        && !memcmp(header.magic, magic, sizeof(magic))
+        && header.version == formatVersion
+        && header.width == width
+        && header.height == height
+        && header.planes == 3
+        && !key.compare(0, key.size(), header.key, std::min(key.size(), sizeof(header.key)))
+        && !fseek(f, headerSize, SEEK_SET);
+
+    if (ok) {
+        red(width, height);
+        green(width, height);
+        blue(width, height);
+        ok = readPlane(f, width, height, red) && readPlane(f, width, height, green) && readPlane(f, width, height, blue);
+    }
+
+    fclose(f);
+
+    if (ok) {
+        // Mark the entry as recently used, trim() removes the least recently used ones first
+        g_utime(fname.c_str(), nullptr);
+    } else {
+        // Damaged or foreign file, drop it so it gets rewritten
+        g_remove(fname.c_str());
+    }
+
+    if (settings->verbose) {
+        printf("DemosaicCache: %s %s\n", ok ? "hit" : "invalid entry", key.c_str());
+    }
+
+    return ok;
+}
+
+void rtengine::DemosaicCache::store(const std::string& key, int width, int height, array2D<float>& red, array2D<float>& green, array2D<float>& blue)
+{
+    if (key.empty() || !isEnabled()) {
+        return;
+    }
+
+    if (static_cast<std::size_t>(width) * height * 3 * sizeof(float) + headerSize > maxSize) {
+        return;
+    }
+
+    const Glib::ustring fname = getFileName(key);
+    // Several processes may share the cache directory, so write to a unique
+    // temporary file and move it in place once complete
+    const Glib::ustring tmpName = Glib::ustring::compose("%1.%2.tmp", fname, g_random_int());
+    FILE* const f = g_fopen(tmpName.c_str(), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    Header header = {};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = formatVersion;
+    header.width = width;
+    header.height = height;
+    header.planes = 3;
+    key.copy(header.key, sizeof(header.key));
+
+    std::vector<char> padding(headerSize - sizeof(Header), 0);
+
+    const bool ok =
+        fwrite(&header, sizeof(Header), 1, f) == 1
+        && fwrite(padding.data(), 1, padding.size(), f) == padding.size()
+        && writePlane(f, width, height, red)
+        && writePlane(f, width, height, green)
+        && writePlane(f, width, height, blue);
+
+    if (fclose(f) != 0 || !ok) {
+        g_remove(tmpName.c_str());
+        return;
+    }
+
+    MyMutex::MyLock lock(mutex);
+
+#ifdef WIN32
+    g_remove(fname.c_str());
+#endif
+
+    if (g_rename(tmpName.c_str(), fname.c_str()) != 0) {
+        g_remove(tmpName.c_str());
+        return;
+    }
+
+    if (settings->verbose) {
+        printf("DemosaicCache: stored %s\n", key.c_str());
+    }
+
+    trim();
+}
+
+void rtengine::DemosaicCache::clear()
+{
+    MyMutex::MyLock lock(mutex);
+
+    try {
+        Glib::Dir dir(cacheDir);
+
+        for (const std::string& name : dir) {
+            g_remove(Glib::build_filename(cacheDir, name).c_str());
+        }
+    } catch (Glib::Exception&) {}
+}
+
+rtengine::DemosaicCache::DemosaicCache() :
+    enabled(false),
+    maxSize(0)
+{
+}
+
+Glib::ustring rtengine::DemosaicCache::getFileName(const std::string& key) const
+{
+    return Glib::build_filename(cacheDir, key + ".rtdm");
+}
+
+void rtengine::DemosaicCache::trim()
+{
+    // mtime, size, file name
+    std::vector<std::tuple<gint64, std::size_t, std::string>> entries;
+    std::size_t totalSize = 0;
+    const gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+
+    try {
+        Glib::Dir dir(cacheDir);
+
+        for (const std::string& name : dir) {
+            const std::string fname = Glib::build_filename(cacheDir, name);
+            GStatBuf st;
+
+            if (Glib::file_test(fname, Glib::FILE_TEST_IS_REGULAR) && g_stat(fname.c_str(), &st) == 0) {
+                if (isTemporary(name)) {
+                    // another process may still be writing it
+                    if (now - st.st_mtime > staleTemporaryAge) {
+                        g_remove(fname.c_str());
+                    }
+
+                    continue;
+                }
+
+                entries.emplace_back(st.st_mtime, st.st_size, fname);
+                totalSize += st.st_size;
+            }
+        }
+    } catch (Glib::Exception&) {
+        return;
+    }
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto& entry : entries) {
+        if (totalSize <= maxSize) {
+            break;
+        }
+
+        if (g_remove(std::get<2>(entry).c_str()) == 0) {
+            totalSize -= std::get<1>(entry);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <glibmm.h>
+
+#include "array2D.h"
+#include "noncopyable.h"
+#include "procparams.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/**
+ * Persistent on-disk cache of demosaiced raw data.
+ *
+ * Each entry holds the red, green and blue planes produced by
+ * RawImageSource::demosaic(). These planes do not depend on the white
+ * balance or on any of the later processing steps, so a re-export after a
+ * Lab-stage tweak can reuse them. Entries are keyed by the identity of the
+ * raw file and by every parameter that influences preprocessing and
+ * demosaicing (see getKey()).
+ *
+ * A file holds a fixed size header padded to 4 KiB followed by the three
+ * planes as raw native-endian floats, row after row, so that the planes
+ * start at page aligned offsets and the file can be memory-mapped.
+ */
+class DemosaicCache final :
+    public NonCopyable
+{
+public:
+    static DemosaicCache& getInstance();
+
+    /** Sets up the cache.
+      * @param cacheDir directory holding the cache files, created if needed
+      * @param enabled whether the cache is used at all
+      * @param maxSizeMB upper bound of the total size of the cache files, in MiB */
+    void init(const Glib::ustring& cacheDir, bool enabled, std::size_t maxSizeMB);
+
+    bool isEnabled() const;
+
+    /** Computes the key of the demosaiced data of a raw file.
+      * @param fname the raw file name
+      * @param frame the frame of the raw file
+      * @param raw the raw parameters
+      * @param lensProf the lens profile parameters (vignetting is applied to the raw data)
+      * @param coarse the coarse transform parameters (flip of the raw data)
+      * @param darkFrame the file name of the dark frame actually used, or empty
+      * @param flatField the file name of the flat field actually used, or empty
+      * @return the key, or an empty string if the raw file can not be identified */
+    static std::string getKey(
+        const Glib::ustring& fname,
+        unsigned int frame,
+        const procparams::RAWParams& raw,
+        const procparams::LensProfParams& lensProf,
+        const procparams::CoarseTransformParams& coarse,
+        const Glib::ustring& darkFrame,
+        const Glib::ustring& flatField
+    );
+
+    /** Loads the planes stored under key. The planes are resized to width x height.
+      * @return true on a cache hit */
+    bool load(const std::string& key, int width, int height, array2D<float>& red, array2D<float>& green, array2D<float>& blue);
+
+    /** Stores the planes under key and trims the cache to its maximum size. */
+    void store(const std::string& key, int width, int height, array2D<float>& red, array2D<float>& green, array2D<float>& blue);
+
+    /** Removes all cache files. */
+    void clear();
+
+private:
+    DemosaicCache();
+
+    Glib::ustring getFileName(const std::string& key) const;
+    void trim();
+
+    mutable MyMutex mutex;
+    bool enabled;
+    Glib::ustring cacheDir;
+    std::size_t maxSize;
+};
+
+}
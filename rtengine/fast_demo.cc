@@ -27,6 +27,7 @@
 #include "../rtgui/multilangmgr.h"
 #include "procparams.h"
 #include "opthelper.h"
+#include "StopWatch.h"
 
 using namespace std;
 using namespace rtengine;
@@ -54,6 +55,7 @@ LUTf RawImageSource::initInvGrad()
 
 SSEFUNCTION void RawImageSource::fast_demosaic(int winx, int winy, int winw, int winh)
 {
+    BENCHFUN
 
     double progress = 0.0;
     const bool plistenerActive = plistener;
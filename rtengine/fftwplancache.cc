@@ -0,0 +1,147 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+
+#include <glib/gstdio.h>
+
+#include "fftwplancache.h"
+#include "settings.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+}
+
+namespace
+{
+
+// The denoise tiles of an image need two shapes, so this holds the plans of a few image and crop sizes
+constexpr unsigned long maxPlans = 16;
+
+}
+
+MyMutex rtengine::FFTWPlanCache::plannerMutex;
+
+rtengine::FFTWPlanCache& rtengine::FFTWPlanCache::getInstance()
+{
+    static FFTWPlanCache instance;
+    return instance;
+}
+
+void rtengine::FFTWPlanCache::init(const Glib::ustring& wisdomFile)
+{
+    MyMutex::MyLock lock(plannerMutex);
+
+    this->wisdomFile = wisdomFile;
+    wisdomChanged = false;
+
+    if (Glib::file_test(wisdomFile, Glib::FILE_TEST_EXISTS)) {
+        const bool ok = fftwf_import_wisdom_from_filename(wisdomFile.c_str());
+
+        if (settings->verbose) {
+            printf("FFTW wisdom %s %s\n", ok ? "loaded from" : "could not be loaded from", wisdomFile.c_str());
+        }
+    }
+}
+
+void rtengine::FFTWPlanCache::saveWisdom()
+{
+    MyMutex::MyLock lock(plannerMutex);
+
+    if (wisdomFile.empty() || !wisdomChanged) {
+        return;
+    }
+
+    // Several processes may share the cache directory, so write to a unique
+    // temporary file and move it in place once complete
+    const Glib::ustring tmpName = Glib::ustring::compose("%1.%2.tmp", wisdomFile, g_random_int());
+
+    g_mkdir_with_parents(Glib::path_get_dirname(wisdomFile).c_str(), 511);
+
+    if (!fftwf_export_wisdom_to_filename(tmpName.c_str())) {
+        g_remove(tmpName.c_str());
+        return;
+    }
+
+#ifdef WIN32
+    g_remove(wisdomFile.c_str());
+#endif
+
+    if (g_rename(tmpName.c_str(), wisdomFile.c_str()) != 0) {
+        g_remove(tmpName.c_str());
+        return;
+    }
+
+    wisdomChanged = false;
+
+    if (settings->verbose) {
+        printf("FFTW wisdom saved to %s\n", wisdomFile.c_str());
+    }
+}
+
+rtengine::FFTWPlanCache::Plan rtengine::FFTWPlanCache::getR2RPlan(int n0, int n1, int howmany, fftwf_r2r_kind kind0, fftwf_r2r_kind kind1, unsigned int flags)
+{
+    const Key key(n0, n1, howmany, kind0, kind1, flags);
+    Plan plan;
+
+    if (plans.get(key, plan)) {
+        return plan;
+    }
+
+    fftwf_plan newPlan = nullptr;
+
+    {
+        MyMutex::MyLock lock(plannerMutex);
+
+        // FFTW_MEASURE overwrites the arrays while planning, so they can not be the ones of the caller
+        const std::size_t size = std::size_t(n0) * n1 * howmany;
+        float* const in = fftwf_alloc_real(size);
+        float* const out = fftwf_alloc_real(size);
+
+        if (in && out) {
+            const int n[2] = {n0, n1};
+            const fftwf_r2r_kind kind[2] = {kind0, kind1};
+            newPlan = fftwf_plan_many_r2r(2, n, howmany, in, nullptr, 1, n0 * n1, out, nullptr, 1, n0 * n1, kind, flags);
+            wisdomChanged = wisdomChanged || newPlan;
+        }
+
+        fftwf_free(in);
+        fftwf_free(out);
+    }
+
+    if (newPlan) {
+        plan.reset(newPlan, destroyPlan);
+        // Outside of the lock, as inserting may drop the last reference to an older plan
+        plans.insert(key, plan);
+    }
+
+    return plan;
+}
+
+rtengine::FFTWPlanCache::FFTWPlanCache() :
+    wisdomChanged(false),
+    plans(maxPlans)
+{
+}
+
+void rtengine::FFTWPlanCache::destroyPlan(fftwf_plan plan)
+{
+    MyMutex::MyLock lock(plannerMutex);
+    fftwf_destroy_plan(plan);
+}
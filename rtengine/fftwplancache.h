@@ -0,0 +1,81 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+
+#include <fftw3.h>
+#include <glibmm.h>
+
+#include "cache.h"
+#include "noncopyable.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/**
+ * Process-wide cache of FFTW plans.
+ *
+ * Planning with FFTW_MEASURE runs and times several algorithms, which costs
+ * more than the transforms of a small image. The plans are therefore kept
+ * for the next calls with the same transform shape, and the accumulated
+ * FFTW wisdom is stored in the cache directory, so that measuring happens
+ * once per machine rather than once per image.
+ *
+ * Only the execution of a plan is thread safe in FFTW. All planner calls
+ * (creation, destruction, wisdom import and export) are serialized here.
+ */
+class FFTWPlanCache final :
+    public NonCopyable
+{
+public:
+    using Plan = std::shared_ptr<std::remove_pointer<fftwf_plan>::type>;
+
+    static FFTWPlanCache& getInstance();
+
+    /** Loads the wisdom stored in wisdomFile, if any. saveWisdom() writes it back. */
+    void init(const Glib::ustring& wisdomFile);
+
+    /** Stores the wisdom gathered since init(), if new plans have been measured. */
+    void saveWisdom();
+
+    /** Returns a plan for howmany two-dimensional real-to-real transforms of n0 x n1 floats,
+      * stored one after the other without gaps, from one array to another.
+      * The plan can be executed with fftwf_execute_r2r() on any arrays allocated by fftwf_malloc(),
+      * also by several threads at once. It stays valid as long as the returned pointer is held.
+      * @return the plan, or an empty pointer if FFTW could not create it */
+    Plan getR2RPlan(int n0, int n1, int howmany, fftwf_r2r_kind kind0, fftwf_r2r_kind kind1, unsigned int flags);
+
+private:
+    // n0, n1, howmany, kind0, kind1, flags
+    using Key = std::tuple<int, int, int, int, int, unsigned int>;
+
+    FFTWPlanCache();
+
+    static void destroyPlan(fftwf_plan plan);
+
+    static MyMutex plannerMutex;
+
+    Glib::ustring wisdomFile;
+    bool wisdomChanged;
+    Cache<Key, Plan> plans;
+};
+
+}
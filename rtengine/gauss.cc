@@ -21,6 +21,9 @@
 #include <cstdlib>
 #include "opthelper.h"
 #include "boxblur.h"
+#include "cpudispatch.h"
+
+RT_TARGET_BEGIN
 
 namespace
 {
@@ -1294,8 +1297,11 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
 }
 }
 
-void gaussianBlur(float** src, float** dst, const int W, const int H, const double sigma, float *buffer, eGaussType gausstype, float** buffer2)
+void RT_KERNEL(gaussianBlur)(float** src, float** dst, const int W, const int H, const double sigma, float *buffer, eGaussType gausstype, float** buffer2)
 {
+    RT_DISPATCH(gaussianBlur, src, dst, W, H, sigma, buffer, gausstype, buffer2)
     gaussianBlurImpl<float>(src, dst, W, H, sigma, buffer, gausstype, buffer2);
 }
 
+RT_TARGET_END
+
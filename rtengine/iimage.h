@@ -20,6 +20,8 @@
 #define _IIMAGE_
 
 #include <glibmm.h>
+#include <cstring>
+#include <string>
 #include <vector>
 #include "rt_math.h"
 #include "alignedbuffer.h"
@@ -78,10 +80,10 @@ public:
     virtual void hflip () {}
     virtual void vflip () {}
 
-    // Read the raw dump of the data
-    void readData  (FILE *fh) {}
-    // Write a raw dump of the data
-    void writeData (FILE *fh) {}
+    // Read the raw dump of the data, as written by writeData
+    void readData  (const char *data) {}
+    // Append a raw dump of the data
+    void writeData (std::string &data) {}
 
     virtual void normalizeInt (int srcMinVal, int srcMaxVal) {};
     virtual void normalizeFloat (float srcMinVal, float srcMaxVal) {};
@@ -567,17 +569,17 @@ public:
         value = n ? T(accumulator / float(n)) : T(0);
     }
 
-    void readData   (FILE *f)
+    void readData   (const char *data)
     {
-        for (int i = 0; i < height; i++) {
-            fread (v(i), sizeof(T), width, f);
+        for (int i = 0; i < height; i++, data += width * sizeof(T)) {
+            memcpy (v(i), data, width * sizeof(T));
         }
     }
 
-    void writeData  (FILE *f)
+    void writeData  (std::string &data)
     {
         for (int i = 0; i < height; i++) {
-            fwrite (v(i), sizeof(T), width, f);
+            data.append (reinterpret_cast<const char*>(v(i)), width * sizeof(T));
         }
     }
 
@@ -1133,33 +1135,33 @@ public:
         valueB = n ? T(accumulatorB / float(n)) : T(0);
     }
 
-    void readData   (FILE *f)
+    void readData   (const char *data)
     {
-        for (int i = 0; i < height; i++) {
-            fread (r(i), sizeof(T), width, f);
+        for (int i = 0; i < height; i++, data += width * sizeof(T)) {
+            memcpy (r(i), data, width * sizeof(T));
         }
 
-        for (int i = 0; i < height; i++) {
-            fread (g(i), sizeof(T), width, f);
+        for (int i = 0; i < height; i++, data += width * sizeof(T)) {
+            memcpy (g(i), data, width * sizeof(T));
         }
 
-        for (int i = 0; i < height; i++) {
-            fread (b(i), sizeof(T), width, f);
+        for (int i = 0; i < height; i++, data += width * sizeof(T)) {
+            memcpy (b(i), data, width * sizeof(T));
         }
     }
 
-    void writeData  (FILE *f)
+    void writeData  (std::string &data)
     {
         for (int i = 0; i < height; i++) {
-            fwrite (r(i), sizeof(T), width, f);
+            data.append (reinterpret_cast<const char*>(r(i)), width * sizeof(T));
         }
 
         for (int i = 0; i < height; i++) {
-            fwrite (g(i), sizeof(T), width, f);
+            data.append (reinterpret_cast<const char*>(g(i)), width * sizeof(T));
         }
 
         for (int i = 0; i < height; i++) {
-            fwrite (b(i), sizeof(T), width, f);
+            data.append (reinterpret_cast<const char*>(b(i)), width * sizeof(T));
         }
     }
 
@@ -1709,17 +1711,17 @@ public:
         }
     }
 
-    void readData   (FILE *f)
+    void readData   (const char *data)
     {
-        for (int i = 0; i < height; i++) {
-            fread (r(i), sizeof(T), 3 * width, f);
+        for (int i = 0; i < height; i++, data += 3 * width * sizeof(T)) {
+            memcpy (r(i), data, 3 * width * sizeof(T));
         }
     }
 
-    void writeData  (FILE *f)
+    void writeData  (std::string &data)
     {
         for (int i = 0; i < height; i++) {
-            fwrite (r(i), sizeof(T), 3 * width, f);
+            data.append (reinterpret_cast<const char*>(r(i)), 3 * width * sizeof(T));
         }
     }
 
@@ -1758,9 +1760,11 @@ public:
     virtual int saveAsJPEG (Glib::ustring fname, int quality = 100, int subSamp = 3 ) = 0;
     /** @brief Saves the image to file in a tif format.
       * @param fname is the name of the file
-      * @param bps can be 8 or 16 depending on the bits per pixels the output file will have
+      * @param bps can be 8 or 16 depending on the bits per pixels the output file will have, or 16 and 32 for floating point samples
+      * @param uncompressed if true, the data are written without compression
+      * @param isFloat if true, the samples are written as floating point numbers in [0;1]
         @return the error code, 0 if none */
-    virtual int saveAsTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false) = 0;
+    virtual int saveAsTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false, bool isFloat = false) = 0;
     /** @brief Sets the progress listener if you want to follow the progress of the image saving operations (optional).
       * @param pl is the pointer to the class implementing the ProgressListener interface */
     virtual void setSaveProgressListener (ProgressListener* pl) = 0;
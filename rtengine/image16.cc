@@ -60,7 +60,7 @@ Image16::~Image16 ()
 {
 }
 
-void Image16::getScanline (int row, unsigned char* buffer, int bps)
+void Image16::getScanline (int row, unsigned char* buffer, int bps, bool isFloat)
 {
 
     if (data == nullptr) {
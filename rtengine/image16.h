@@ -55,7 +55,7 @@ public:
     {
         return 8 * sizeof(unsigned short);
     }
-    virtual void         getScanline (int row, unsigned char* buffer, int bps);
+    virtual void         getScanline (int row, unsigned char* buffer, int bps, bool isFloat = false);
     virtual void         setScanline (int row, unsigned char* buffer, int bps, float *minValue = nullptr, float *maxValue = nullptr);
 
     // functions inherited from IImage16:
@@ -83,9 +83,9 @@ public:
     {
         return saveJPEG (fname, quality, subSamp);
     }
-    virtual int          saveAsTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false)
+    virtual int          saveAsTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false, bool isFloat = false)
     {
-        return saveTIFF (fname, bps, uncompressed);
+        return saveTIFF (fname, bps, uncompressed, isFloat);
     }
     virtual void         setSaveProgressListener (ProgressListener* pl)
     {
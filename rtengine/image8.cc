@@ -37,7 +37,7 @@ Image8::~Image8 ()
 {
 }
 
-void Image8::getScanline (int row, unsigned char* buffer, int bps)
+void Image8::getScanline (int row, unsigned char* buffer, int bps, bool isFloat)
 {
 
     if (data == nullptr) {
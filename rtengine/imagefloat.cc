@@ -30,6 +30,57 @@
 
 using namespace rtengine;
 
+namespace
+{
+
+// IEEE 754 half precision, rounded to the nearest, the out of range values becoming infinite
+uint16_t floatToHalf (float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = int((bits >> 23) & 0xff) - (127 - 15);
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff - (127 - 15)) {
+        // infinite or NaN, which keeps a non zero mantissa
+        return sign | 0x7c00 | (mantissa ? (mantissa >> 13) | 1 : 0);
+    }
+
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+
+        // denormalized
+        mantissa = (mantissa | 0x800000) >> (1 - exponent);
+
+        if (mantissa & 0x1000) {
+            mantissa += 0x2000;
+        }
+
+        return sign | (mantissa >> 13);
+    }
+
+    if (mantissa & 0x1000) {
+        mantissa += 0x2000;
+
+        if (mantissa & 0x800000) {
+            mantissa = 0;
+            ++exponent;
+        }
+    }
+
+    if (exponent > 30) {
+        return sign | 0x7c00;
+    }
+
+    return sign | (exponent << 10) | (mantissa >> 13);
+}
+
+}
+
 Imagefloat::Imagefloat ()
 {
 }
@@ -143,21 +194,45 @@ void Imagefloat::setScanline (int row, unsigned char* buffer, int bps, float *mi
     }
 }
 
-void Imagefloat::getScanline (int row, unsigned char* buffer, int bps)
+void Imagefloat::getScanline (int row, unsigned char* buffer, int bps, bool isFloat)
 {
 
     if (data == nullptr) {
         return;
     }
 
-    if (bps == 32) {
-        int ix = 0;
-        float* sbuffer = (float*) buffer;
+    if (isFloat) {
+        // floating point samples are written in [0;1]
+        if (bps == 32) {
+            float* sbuffer = (float*) buffer;
 
-        for (int i = 0; i < width; i++) {
-            sbuffer[ix++] = r(row, i);
-            sbuffer[ix++] = g(row, i);
-            sbuffer[ix++] = b(row, i);
+            for (int i = 0, ix = 0; i < width; i++) {
+                sbuffer[ix++] = r(row, i) / 65535.f;
+                sbuffer[ix++] = g(row, i) / 65535.f;
+                sbuffer[ix++] = b(row, i) / 65535.f;
+            }
+        } else if (bps == 16) {
+            uint16_t* sbuffer = (uint16_t*) buffer;
+
+            for (int i = 0, ix = 0; i < width; i++) {
+                sbuffer[ix++] = floatToHalf(r(row, i) / 65535.f);
+                sbuffer[ix++] = floatToHalf(g(row, i) / 65535.f);
+                sbuffer[ix++] = floatToHalf(b(row, i) / 65535.f);
+            }
+        }
+    } else if (bps == 16) {
+        uint16_t* sbuffer = (uint16_t*) buffer;
+
+        for (int i = 0, ix = 0; i < width; i++) {
+            sbuffer[ix++] = float2uint16range(r(row, i));
+            sbuffer[ix++] = float2uint16range(g(row, i));
+            sbuffer[ix++] = float2uint16range(b(row, i));
+        }
+    } else if (bps == 8) {
+        for (int i = 0, ix = 0; i < width; i++) {
+            buffer[ix++] = uint16ToUint8Rounded(float2uint16range(r(row, i)));
+            buffer[ix++] = uint16ToUint8Rounded(float2uint16range(g(row, i)));
+            buffer[ix++] = uint16ToUint8Rounded(float2uint16range(b(row, i)));
         }
     }
 }
@@ -511,3 +586,51 @@ void Imagefloat::ExecCMSTransform(cmsHTRANSFORM hTransform)
         } // End of parallelization
     }
 }
+
+void Imagefloat::ExecCMSTransform(cmsHTRANSFORM hTransform, const LabImage &labImage, int cx, int cy)
+{
+    // LittleCMS cannot parallelize planar Lab float images
+    // so build temporary buffers to allow multi processor execution
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        AlignedBuffer<float> bufferLab(width * 3);
+        AlignedBuffer<float> bufferRGB(width * 3);
+
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+
+        for (int y = cy; y < cy + height; y++)
+        {
+            float *pRGB, *pR, *pG, *pB;
+            float *pLab, *pL, *pa, *pb;
+
+            pLab= bufferLab.data;
+            pL = labImage.L[y] + cx;
+            pa = labImage.a[y] + cx;
+            pb = labImage.b[y] + cx;
+
+            for (int x = 0; x < width; x++) {
+                *(pLab++) = *(pL++)  / 327.68f;
+                *(pLab++) = *(pa++)  / 327.68f;
+                *(pLab++) = *(pb++)  / 327.68f;
+            }
+
+            cmsDoTransform (hTransform, bufferLab.data, bufferRGB.data, width);
+
+            pRGB = bufferRGB.data;
+            pR = r(y - cy);
+            pG = g(y - cy);
+            pB = b(y - cy);
+
+            // the float output of LittleCMS is in [0;1], and not clipped
+            for (int x = 0; x < width; x++) {
+                *(pR++) = 65535.f * *(pRGB++);
+                *(pG++) = 65535.f * *(pRGB++);
+                *(pB++) = 65535.f * *(pRGB++);
+            }
+        } // End of parallelization
+    }
+}
@@ -59,7 +59,7 @@ public:
     {
         return 8 * sizeof(float);
     }
-    virtual void         getScanline (int row, unsigned char* buffer, int bps);
+    virtual void         getScanline (int row, unsigned char* buffer, int bps, bool isFloat = false);
     virtual void         setScanline (int row, unsigned char* buffer, int bps, float *minValue = nullptr, float *maxValue = nullptr);
 
     // functions inherited from IImagefloat:
@@ -87,9 +87,9 @@ public:
     {
         return saveJPEG (fname, quality, subSamp);
     }
-    virtual int          saveAsTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false)
+    virtual int          saveAsTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false, bool isFloat = false)
     {
-        return saveTIFF (fname, bps, uncompressed);
+        return saveTIFF (fname, bps, uncompressed, isFloat);
     }
     virtual void         setSaveProgressListener (ProgressListener* pl)
     {
@@ -106,6 +106,7 @@ public:
     void                 calcCroppedHistogram(const ProcParams &params, float scale, LUTu & hist);
 
     void                 ExecCMSTransform(cmsHTRANSFORM hTransform);
+    void                 ExecCMSTransform(cmsHTRANSFORM hTransform, const LabImage &labImage, int cx, int cy);
 };
 
 }
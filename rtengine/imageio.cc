@@ -21,14 +21,22 @@
 #include <glib/gstdio.h>
 #include <tiff.h>
 #include <tiffio.h>
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <libiptcdata/iptc-jpeg.h>
+#include <vector>
+#include <zlib.h>
 #include "rt_math.h"
 #include "../rtgui/options.h"
 #include "../rtgui/version.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef WIN32
 #include <winsock2.h>
 #else
@@ -41,6 +49,7 @@
 #include "color.h"
 
 #include "jpeg.h"
+#include "StopWatch.h"
 
 using namespace std;
 using namespace rtengine;
@@ -84,6 +93,152 @@ Glib::ustring to_utf8 (const std::string& str)
     }
 }
 
+// Lets libjpeg decode a reduced image, by skipping the high frequencies in the IDCT, if both of its
+// sides stay at least minSize pixels. 1/2, 1/4 and 1/8 are supported by every version of libjpeg.
+void setJPEGReduction (jpeg_decompress_struct& cinfo, int minSize)
+{
+    if (minSize <= 0) {
+        return;
+    }
+
+    const JDIMENSION minSide = std::min(cinfo.image_width, cinfo.image_height);
+    unsigned int denom = 8;
+
+    // same rounding as jpeg_calc_output_dimensions()
+    while (denom > 1 && (minSide + denom - 1) / denom < static_cast<JDIMENSION>(minSize)) {
+        denom /= 2;
+    }
+
+    if (denom > 1) {
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = denom;
+        // the result is downscaled anyway, so the faster and less accurate methods are good enough
+        cinfo.dct_method = JDCT_IFAST;
+        cinfo.do_fancy_upsampling = FALSE;
+    }
+}
+
+// Rows of the blocks which savePNG and saveTIFF compress in parallel, about 256 KiB each
+int getBlockRows (std::size_t rowBytes)
+{
+    return std::max<std::size_t>((256 << 10) / std::max<std::size_t>(rowBytes, 1), 1);
+}
+
+int getThreadCount ()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Deflates a block on its own: a zlib stream if windowBits is 15, a raw deflate stream if -15, primed with
+// the dictionary if any. A raw stream ends with a sync flush, so that the next block can be appended, unless
+// it is the last one.
+bool deflateBlock (const std::vector<unsigned char>& in, const unsigned char* dictionary, std::size_t dictionaryLength, int level, int windowBits, int strategy, bool last, std::vector<unsigned char>& out)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+
+    if (deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8, strategy) != Z_OK) {
+        return false;
+    }
+
+    if (dictionaryLength > 0) {
+        deflateSetDictionary(&stream, dictionary, dictionaryLength);
+    }
+
+    // room for the marker of the sync flush
+    out.resize(deflateBound(&stream, in.size()) + 16);
+    stream.next_in = const_cast<Bytef*>(in.data());
+    stream.avail_in = in.size();
+    stream.next_out = out.data();
+    stream.avail_out = out.size();
+
+    const int res = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool ok = res == (last ? Z_STREAM_END : Z_OK) && stream.avail_in == 0 && stream.avail_out > 0;
+
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return ok;
+}
+
+// Appends a row filtered with the PNG filter giving the lowest sum of absolute values, the heuristic of
+// libpng, preceded by the filter type. prev is a row of zeros for the first row, candidates a scratch buffer.
+void filterPNGRow (const unsigned char* row, const unsigned char* prev, std::size_t rowlen, std::size_t bpp, std::vector<unsigned char>& candidates, std::vector<unsigned char>& out)
+{
+    candidates.resize(5 * rowlen);
+    unsigned char* const none = candidates.data();
+    unsigned char* const sub = none + rowlen;
+    unsigned char* const up = sub + rowlen;
+    unsigned char* const average = up + rowlen;
+    unsigned char* const paeth = average + rowlen;
+
+    for (std::size_t i = 0; i < rowlen; ++i) {
+        const int a = i >= bpp ? row[i - bpp] : 0;
+        const int b = prev[i];
+        const int c = i >= bpp ? prev[i - bpp] : 0;
+        const int p = a + b - c;
+        const int pa = std::abs(p - a);
+        const int pb = std::abs(p - b);
+        const int pc = std::abs(p - c);
+
+        none[i] = row[i];
+        sub[i] = row[i] - a;
+        up[i] = row[i] - b;
+        average[i] = row[i] - (a + b) / 2;
+        paeth[i] = row[i] - (pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+    }
+
+    int best = 0;
+    unsigned long bestSum = 0;
+
+    for (int filter = 0; filter < 5; ++filter) {
+        const unsigned char* const filtered = none + filter * rowlen;
+        unsigned long sum = 0;
+
+        for (std::size_t i = 0; i < rowlen; ++i) {
+            sum += std::abs(static_cast<signed char>(filtered[i]));
+        }
+
+        if (filter == 0 || sum < bestSum) {
+            best = filter;
+            bestSum = sum;
+        }
+    }
+
+    out.push_back(best);
+    out.insert(out.end(), none + best * rowlen, none + (best + 1) * rowlen);
+}
+
+// The floating point predictor of libtiff: the bytes of the samples of a row are split into planes, the most
+// significant first, then each byte is replaced by its difference with the one of the previous pixel. The
+// result does not depend on the byte order. planes is a scratch buffer.
+void predictFloatRow (unsigned char* row, std::size_t rowBytes, std::size_t sampleBytes, std::size_t pixelBytes, std::vector<unsigned char>& planes)
+{
+    const std::size_t samples = rowBytes / sampleBytes;
+    planes.resize(rowBytes);
+
+    for (std::size_t i = 0; i < samples; ++i) {
+        for (std::size_t byte = 0; byte < sampleBytes; ++byte) {
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+            planes[(sampleBytes - byte - 1) * samples + i] = row[sampleBytes * i + byte];
+#else
+            planes[byte * samples + i] = row[sampleBytes * i + byte];
+#endif
+        }
+    }
+
+    const std::size_t stride = pixelBytes / sampleBytes;
+    std::copy(planes.begin(), planes.begin() + std::min(stride, rowBytes), row);
+
+    for (std::size_t i = stride; i < rowBytes; ++i) {
+        row[i] = planes[i] - planes[i - stride];
+    }
+}
+
 }
 
 Glib::ustring ImageIO::errorMsg[6] = {"Success", "Cannot read file.", "Invalid header.", "Error while reading header.", "File reading error", "Image format not supported."};
@@ -280,6 +435,7 @@ int ImageIO::getPNGSampleFormat (Glib::ustring fname, IIOSampleFormat &sFormat,
 
 int ImageIO::loadPNG  (Glib::ustring fname)
 {
+    BENCHFUN
 
     FILE *file = g_fopen (fname.c_str (), "rb");
 
@@ -439,8 +595,10 @@ void my_error_exit (j_common_ptr cinfo)
 }
 
 
-int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
+int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize, int minSize)
 {
+    loadedScale = 1;
+
     jpeg_decompress_struct cinfo;
     jpeg_create_decompress(&cinfo);
     jpeg_memory_src (&cinfo, (const JOCTET*)buffer, bufsize);
@@ -490,7 +648,9 @@ int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
         embProfile = nullptr;
     }
 
+    setJPEGReduction (cinfo, minSize);
     jpeg_start_decompress(&cinfo);
+    loadedScale = cinfo.scale_denom / cinfo.scale_num;
 
     unsigned int width = cinfo.output_width;
     unsigned int height = cinfo.output_height;
@@ -527,8 +687,10 @@ int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
     return IMIO_SUCCESS;
 }
 
-int ImageIO::loadJPEG (Glib::ustring fname)
+int ImageIO::loadJPEG (Glib::ustring fname, int minSize)
 {
+    BENCHFUN
+    loadedScale = 1;
     FILE *file = g_fopen(fname.c_str (), "rb");
 
     if (!file) {
@@ -571,7 +733,9 @@ int ImageIO::loadJPEG (Glib::ustring fname)
             embProfile = nullptr;
         }
 
+        setJPEGReduction (cinfo, minSize);
         jpeg_start_decompress(&cinfo);
+        loadedScale = cinfo.scale_denom / cinfo.scale_num;
 
         unsigned int width = cinfo.output_width;
         unsigned int height = cinfo.output_height;
@@ -716,6 +880,7 @@ int ImageIO::getTIFFSampleFormat (Glib::ustring fname, IIOSampleFormat &sFormat,
 
 int ImageIO::loadTIFF (Glib::ustring fname)
 {
+    BENCHFUN
 
     static MyMutex thumbMutex;
     MyMutex::MyLock lock(thumbMutex);
@@ -907,6 +1072,7 @@ int ImageIO::loadPPMFromMemory(const char* buffer, int width, int height, bool s
 
 int ImageIO::savePNG  (Glib::ustring fname, int compression, volatile int bps)
 {
+    BENCHFUN
     if (getWidth() < 1 || getHeight() < 1) {
         return IMIO_HEADERERROR;
     }
@@ -958,12 +1124,12 @@ int ImageIO::savePNG  (Glib::ustring fname, int compression, volatile int bps)
                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_BASE);
 
 
-    int rowlen = width * 3 * bps / 8;
-    unsigned char *row = new unsigned char [rowlen];
+    const std::size_t rowlen = width * 3 * bps / 8;
+    const std::size_t bpp = 3 * bps / 8;
 
     png_write_info(png, info);
 
-    for (int i = 0; i < height; i++) {
+    const auto getRow = [this, width, bps](int i, unsigned char* row) {
         getScanline (i, row, bps);
 
         if (bps == 16) {
@@ -977,20 +1143,122 @@ int ImageIO::savePNG  (Glib::ustring fname, int compression, volatile int bps)
 
 #endif
         }
+    };
+
+    // Instead of png_write_row(), which deflates on a single thread, the rows are filtered and deflated by blocks
+    // in parallel, as pigz does: each block is a raw deflate stream primed with the end of the previous one. They
+    // are written as the IDAT chunks of one zlib stream, whose check value combines the ones of the blocks.
+    constexpr std::size_t window = 32768;
+    const int blockRows = getBlockRows (rowlen + 1);
+    const int blockCount = (height + blockRows - 1) / blockRows;
+    const int batchSize = 2 * getThreadCount ();
+
+    std::vector<std::vector<unsigned char>> filtered (batchSize);
+    std::vector<std::vector<unsigned char>> deflated (batchSize);
+    std::vector<uLong> checks (batchSize);
+    std::vector<char> failed (batchSize);
+    std::vector<unsigned char> dictionary;
+    uLong check = adler32 (0, nullptr, 0);
+    bool writeOk = true;
 
-        png_write_row (png, (png_byte*)row);
+    for (int first = 0; first < blockCount && writeOk; first += batchSize) {
+        const int last = std::min (first + batchSize, blockCount);
 
-        if (pl && !(i % 100)) {
-            pl->setProgress ((double)(i + 1) / height);
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        {
+            std::vector<unsigned char> rows (2 * rowlen);
+            std::vector<unsigned char> candidates;
+
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
+#endif
+
+            for (int block = first; block < last; ++block) {
+                const int rowStart = block * blockRows;
+                const int rowEnd = std::min (rowStart + blockRows, height);
+                unsigned char* row = rows.data();
+                unsigned char* prev = row + rowlen;
+
+                if (rowStart > 0) {
+                    getRow (rowStart - 1, prev);
+                } else {
+                    std::fill (prev, prev + rowlen, 0);
+                }
+
+                std::vector<unsigned char>& out = filtered[block - first];
+                out.clear();
+                out.reserve ((rowEnd - rowStart) * (rowlen + 1));
+
+                for (int i = rowStart; i < rowEnd; ++i) {
+                    getRow (i, row);
+                    filterPNGRow (row, prev, rowlen, bpp, candidates, out);
+                    std::swap (row, prev);
+                }
+
+                checks[block - first] = adler32 (adler32 (0, nullptr, 0), out.data(), out.size());
+            }
+
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
+#endif
+
+            for (int block = first; block < last; ++block) {
+                const std::vector<unsigned char>& previous = block == first ? dictionary : filtered[block - first - 1];
+                const std::size_t length = std::min (window, previous.size());
+                failed[block - first] = !deflateBlock (filtered[block - first], previous.data() + previous.size() - length, length, compression, -15, Z_FILTERED, block == blockCount - 1, deflated[block - first]);
+            }
         }
+
+        for (int block = first; block < last; ++block) {
+            if (failed[block - first]) {
+                writeOk = false;
+                break;
+            }
+
+            std::vector<unsigned char>& out = deflated[block - first];
+
+            if (block == 0) {
+                // zlib header: deflate with a 32 KiB window, and the compression level
+                const unsigned int cmf = 0x78;
+                unsigned int flg = (compression < 2 ? 0 : compression < 6 ? 1 : compression == 6 ? 2 : 3) << 6;
+                flg += 31 - (cmf * 256 + flg) % 31;
+                out.insert (out.begin(), {static_cast<unsigned char>(cmf), static_cast<unsigned char>(flg)});
+            }
+
+            check = adler32_combine (check, checks[block - first], filtered[block - first].size());
+
+            if (block == blockCount - 1) {
+                for (int shift = 24; shift >= 0; shift -= 8) {
+                    out.push_back ((check >> shift) & 0xff);
+                }
+            }
+
+            png_write_chunk (png, reinterpret_cast<png_bytep>(const_cast<char*>("IDAT")), out.data(), out.size());
+        }
+
+        const std::vector<unsigned char>& tail = filtered[last - 1 - first];
+        dictionary.assign (tail.end() - std::min (window, tail.size()), tail.end());
+
+        if (pl) {
+            pl->setProgress ((double)std::min (last * blockRows, height) / height);
+        }
+    }
+
+    // png_write_end() would complain that no IDAT has been written, there is no chunk to write after them
+    if (writeOk) {
+        png_write_chunk (png, reinterpret_cast<png_bytep>(const_cast<char*>("IEND")), nullptr, 0);
     }
 
-    png_write_end(png, info);
     png_destroy_write_struct(&png, &info);
 
-    delete [] row;
     fclose (file);
 
+    if (!writeOk) {
+        return IMIO_CANNOTWRITEFILE;
+    }
+
     if (pl) {
         pl->setProgressStr ("PROGRESSBAR_READY");
         pl->setProgress (1.0);
@@ -1004,6 +1272,7 @@ int ImageIO::savePNG  (Glib::ustring fname, int compression, volatile int bps)
 // Quality 0..100, subsampling: 1=low quality, 2=medium, 3=high
 int ImageIO::saveJPEG (Glib::ustring fname, int quality, int subSamp)
 {
+    BENCHFUN
     if (getWidth() < 1 || getHeight() < 1) {
         return IMIO_HEADERERROR;
     }
@@ -1192,13 +1461,13 @@ int ImageIO::saveJPEG (Glib::ustring fname, int quality, int subSamp)
     return IMIO_SUCCESS;
 }
 
-int ImageIO::saveTIFF (Glib::ustring fname, int bps, bool uncompressed)
+int ImageIO::saveTIFF (Glib::ustring fname, int bps, bool uncompressed, bool isFloat)
 {
+    BENCHFUN
     if (getWidth() < 1 || getHeight() < 1) {
         return IMIO_HEADERERROR;
     }
 
-    //TODO: Handling 32 bits floating point output images!
     bool writeOk = true;
     int width = getWidth ();
     int height = getHeight ();
@@ -1211,7 +1480,8 @@ int ImageIO::saveTIFF (Glib::ustring fname, int bps, bool uncompressed)
     unsigned char* linebuffer = new unsigned char[lineWidth];
 
 // TODO the following needs to be looked into - do we really need two ways to write a Tiff file ?
-    if (exifRoot && uncompressed) {
+    // (the header written by rtexif has no SampleFormat tag, the floating point images go through libtiff)
+    if (exifRoot && uncompressed && !isFloat) {
         FILE *file = g_fopen_withBinaryAndLock (fname);
 
         if (!file) {
@@ -1354,32 +1624,87 @@ int ImageIO::saveTIFF (Glib::ustring fname, int bps, bool uncompressed)
         TIFFSetField (out, TIFFTAG_IMAGELENGTH, height);
         TIFFSetField (out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
         TIFFSetField (out, TIFFTAG_SAMPLESPERPIXEL, 3);
-        TIFFSetField (out, TIFFTAG_ROWSPERSTRIP, height);
+        TIFFSetField (out, TIFFTAG_ROWSPERSTRIP, uncompressed ? height : getBlockRows (lineWidth));
         TIFFSetField (out, TIFFTAG_BITSPERSAMPLE, bps);
         TIFFSetField (out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-        TIFFSetField (out, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+        TIFFSetField (out, TIFFTAG_SAMPLEFORMAT, isFloat ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
         TIFFSetField (out, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
         TIFFSetField (out, TIFFTAG_COMPRESSION, uncompressed ? COMPRESSION_NONE : COMPRESSION_DEFLATE);
 
         if (!uncompressed) {
-            TIFFSetField (out, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
+            TIFFSetField (out, TIFFTAG_PREDICTOR, isFloat ? PREDICTOR_FLOATINGPOINT : PREDICTOR_NONE);
         }
 
         if (profileData) {
             TIFFSetField (out, TIFFTAG_ICCPROFILE, profileLength, profileData);
         }
 
-        for (int row = 0; row < height; row++) {
-            getScanline (row, linebuffer, bps);
+        if (uncompressed) {
+            for (int row = 0; row < height; row++) {
+                getScanline (row, linebuffer, bps, isFloat);
+
+                if (TIFFWriteScanline (out, linebuffer, row, 0) < 0) {
+                    TIFFClose (out);
+                    delete [] linebuffer;
+                    return IMIO_CANNOTWRITEFILE;
+                }
 
-            if (TIFFWriteScanline (out, linebuffer, row, 0) < 0) {
-                TIFFClose (out);
-                delete [] linebuffer;
-                return IMIO_CANNOTWRITEFILE;
+                if (pl && !(row % 100)) {
+                    pl->setProgress ((double)(row + 1) / height);
+                }
             }
+        } else {
+            // Instead of TIFFWriteScanline(), which deflates on a single thread, the strips are deflated
+            // in parallel, then written in order by TIFFWriteRawStrip()
+            const int stripRows = getBlockRows (lineWidth);
+            const int stripCount = (height + stripRows - 1) / stripRows;
+            const int batchSize = 2 * getThreadCount ();
+            // TIFFWriteRawStrip() writes the data as is, the output of the floating point predictor is in no byte order
+            const bool swapBytes = bps == 16 && !isFloat && TIFFIsByteSwapped (out);
+
+            std::vector<std::vector<unsigned char>> deflated (batchSize);
+            std::vector<char> failed (batchSize);
+
+            for (int first = 0; first < stripCount && writeOk; first += batchSize) {
+                const int last = std::min (first + batchSize, stripCount);
+
+#ifdef _OPENMP
+                #pragma omp parallel for schedule(dynamic)
+#endif
 
-            if (pl && !(row % 100)) {
-                pl->setProgress ((double)(row + 1) / height);
+                for (int strip = first; strip < last; ++strip) {
+                    const int rowStart = strip * stripRows;
+                    const int rowEnd = std::min (rowStart + stripRows, height);
+                    std::vector<unsigned char> data (std::size_t (rowEnd - rowStart) * lineWidth);
+                    std::vector<unsigned char> planes;
+
+                    for (int row = rowStart; row < rowEnd; ++row) {
+                        unsigned char* const line = data.data() + std::size_t (row - rowStart) * lineWidth;
+                        getScanline (row, line, bps, isFloat);
+
+                        if (isFloat) {
+                            predictFloatRow (line, lineWidth, bps / 8, 3 * bps / 8, planes);
+                        } else if (swapBytes) {
+                            for (int i = 0; i < lineWidth; i += 2) {
+                                std::swap (line[i], line[i + 1]);
+                            }
+                        }
+                    }
+
+                    // the zlib default level, as used by libtiff
+                    failed[strip - first] = !deflateBlock (data, nullptr, 0, Z_DEFAULT_COMPRESSION, 15, Z_DEFAULT_STRATEGY, true, deflated[strip - first]);
+                }
+
+                for (int strip = first; strip < last; ++strip) {
+                    if (failed[strip - first] || TIFFWriteRawStrip (out, strip, deflated[strip - first].data(), deflated[strip - first].size()) < 0) {
+                        writeOk = false;
+                        break;
+                    }
+                }
+
+                if (pl) {
+                    pl->setProgress ((double)std::min (last * stripRows, height) / height);
+                }
             }
         }
 
@@ -1445,13 +1770,15 @@ void png_flush(png_structp png_ptr)
     }
 }
 
-int ImageIO::load (Glib::ustring fname)
+int ImageIO::load (Glib::ustring fname, int minSize)
 {
 
+    loadedScale = 1;
+
     if (hasPngExtension(fname)) {
         return loadPNG (fname);
     } else if (hasJpegExtension(fname)) {
-        return loadJPEG (fname);
+        return loadJPEG (fname, minSize);
     } else if (hasTiffExtension(fname)) {
         return loadTIFF (fname);
     } else {
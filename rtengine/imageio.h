@@ -85,6 +85,7 @@ protected:
     MyMutex imutex;
     IIOSampleFormat sampleFormat;
     IIOSampleArrangement sampleArrangement;
+    int loadedScale;
 
 private:
     void deleteLoadedProfileData( )
@@ -104,7 +105,7 @@ public:
 
     ImageIO () : pl (nullptr), embProfile(nullptr), profileData(nullptr), profileLength(0), loadedProfileData(nullptr), loadedProfileDataJpg(false),
         loadedProfileLength(0), iptc(nullptr), exifRoot (nullptr), sampleFormat(IIOSF_UNKNOWN),
-        sampleArrangement(IIOSA_UNKNOWN) {}
+        sampleArrangement(IIOSA_UNKNOWN), loadedScale(1) {}
 
     virtual ~ImageIO ();
 
@@ -129,6 +130,11 @@ public:
     {
         return sampleArrangement;
     }
+    // size of the image in the file divided by the size of the loaded image
+    int                  getLoadedScale() const
+    {
+        return loadedScale;
+    }
 
     virtual void    getStdImage (ColorTemp ctemp, int tran, Imagefloat* image, PreviewProps pp, bool first, procparams::ToneCurveParams hrp)
     {
@@ -136,7 +142,7 @@ public:
     }
 
     virtual int     getBPS      () = 0;
-    virtual void    getScanline (int row, unsigned char* buffer, int bps) {}
+    virtual void    getScanline (int row, unsigned char* buffer, int bps, bool isFloat = false) {}
     virtual void    setScanline (int row, unsigned char* buffer, int bps, float minValue[3] = nullptr, float  maxValue[3] = nullptr) {}
 
     virtual bool    readImage   (Glib::ustring &fname, FILE *fh)
@@ -148,21 +154,23 @@ public:
         return false;
     };
 
-    int load (Glib::ustring fname);
+    // minSize > 0 lets a JPEG file be decoded at 1/2, 1/4 or 1/8 of its size, if both sides of
+    // the image stay at least minSize pixels: see getLoadedScale()
+    int load (Glib::ustring fname, int minSize = 0);
     int save (Glib::ustring fname);
 
     int loadPNG  (Glib::ustring fname);
-    int loadJPEG (Glib::ustring fname);
+    int loadJPEG (Glib::ustring fname, int minSize = 0);
     int loadTIFF (Glib::ustring fname);
     static int getPNGSampleFormat  (Glib::ustring fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
     static int getTIFFSampleFormat (Glib::ustring fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
 
-    int loadJPEGFromMemory (const char* buffer, int bufsize);
+    int loadJPEGFromMemory (const char* buffer, int bufsize, int minSize = 0);
     int loadPPMFromMemory(const char* buffer, int width, int height, bool swap, int bps);
 
     int savePNG  (Glib::ustring fname, int compression = -1, volatile int bps = -1);
     int saveJPEG (Glib::ustring fname, int quality = 100, int subSamp = 3);
-    int saveTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false);
+    int saveTIFF (Glib::ustring fname, int bps = -1, bool uncompressed = false, bool isFloat = false);
 
     cmsHPROFILE getEmbeddedProfile ()
     {
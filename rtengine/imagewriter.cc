@@ -0,0 +1,113 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "imagewriter.h"
+#include "iimage.h"
+
+rtengine::ImageWriter::ImageWriter (std::size_t capacity, unsigned int threadCount) :
+    capacity(std::max<std::size_t>(capacity, 1)),
+    encoderThreadCount(1),
+    writing(0),
+    stopping(false)
+{
+    threadCount = std::max(threadCount, 1u);
+
+#ifdef _OPENMP
+    encoderThreadCount = std::max<int>(omp_get_num_procs() / threadCount, 1);
+#endif
+
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        threads.push_back(Glib::Threads::Thread::create(sigc::mem_fun(*this, &ImageWriter::work)));
+    }
+}
+
+rtengine::ImageWriter::~ImageWriter ()
+{
+    {
+        Glib::Threads::Mutex::Lock lock(mutex);
+
+        while (!entries.empty() || writing > 0) {
+            written.wait(mutex);
+        }
+
+        stopping = true;
+        queued.broadcast();
+    }
+
+    for (auto thread : threads) {
+        thread->join();
+    }
+}
+
+void rtengine::ImageWriter::push (IImage* img, Job job)
+{
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    while (entries.size() + writing >= capacity) {
+        written.wait(mutex);
+    }
+
+    entries.push_back({img, std::move(job)});
+    queued.signal();
+}
+
+void rtengine::ImageWriter::wait ()
+{
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    while (!entries.empty() || writing > 0) {
+        written.wait(mutex);
+    }
+}
+
+void rtengine::ImageWriter::work ()
+{
+#ifdef _OPENMP
+    // the writer threads share the cores when they compress in parallel
+    omp_set_num_threads(encoderThreadCount);
+#endif
+
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    while (true) {
+        if (entries.empty()) {
+            if (stopping) {
+                return;
+            }
+
+            queued.wait(mutex);
+            continue;
+        }
+
+        Entry entry = std::move(entries.front());
+        entries.pop_front();
+        ++writing;
+
+        lock.release();
+        entry.job(entry.img);
+        entry.img->free();
+        lock.acquire();
+
+        --writing;
+        written.broadcast();
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <glibmm.h>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+class IImage;
+
+/**
+ * Encodes and writes processed images on threads of their own, so that the
+ * processing threads go on with the next images meanwhile.
+ *
+ * push() takes the ownership of the image and returns at once, unless the
+ * writer holds capacity images already (queued or being written): it then
+ * waits for one of them to be written, which bounds the memory held.
+ */
+class ImageWriter final :
+    public NonCopyable
+{
+public:
+    /** Saves the image and reports the errors. Runs on a writer thread, the image is freed afterwards. */
+    using Job = std::function<void (IImage* img)>;
+
+    ImageWriter (std::size_t capacity, unsigned int threadCount);
+    /** Waits for the pushed images to be written */
+    ~ImageWriter ();
+
+    void push (IImage* img, Job job);
+
+    /** Waits for the pushed images to be written */
+    void wait ();
+
+private:
+    struct Entry {
+        IImage* img;
+        Job job;
+    };
+
+    void work ();
+
+    const std::size_t capacity;
+    int encoderThreadCount;   // of the OpenMP regions of each writer thread
+    std::vector<Glib::Threads::Thread*> threads;
+
+    // Glib::Threads::Mutex rather than MyMutex, because it is used with Glib::Threads::Cond
+    Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond queued;
+    Glib::Threads::Cond written;
+    std::deque<Entry> entries;
+    std::size_t writing;
+    bool stopping;
+};
+
+}
@@ -24,6 +24,7 @@
 #include "colortemp.h"
 #include "improcfun.h"
 #include "iccstore.h"
+#include "taskscheduler.h"
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -36,7 +37,7 @@ ImProcCoordinator::ImProcCoordinator ()
     : orig_prev(nullptr), oprevi(nullptr), oprevl(nullptr), nprevl(nullptr), previmg(nullptr), workimg(nullptr),
       ncie(nullptr), imgsrc(nullptr), shmap(nullptr), lastAwbEqual(0.), lastAwbTempBias(0.0), ipf(&params, true), monitorIntent(RI_RELATIVE),
       softProof(false), gamutCheck(false), scale(10), highDetailPreprocessComputed(false), highDetailRawComputed(false),
-      allocated(false), bwAutoR(-9000.f), bwAutoG(-9000.f), bwAutoB(-9000.f), CAMMean(NAN),
+      binnedRawComputed(false), allocated(false), bwAutoR(-9000.f), bwAutoG(-9000.f), bwAutoB(-9000.f), CAMMean(NAN),
 
       hltonecurve(65536),
       shtonecurve(65536),
@@ -182,6 +183,22 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
         //rp.deadPixelFilter = rp.hotPixelFilter = false;
     }
 
+    // If neither the preview nor a detail crop shows more than every second (Bayer) or third (X-Trans)
+    // pixel, binning the cells of the CFA is enough. The full demosaic is done when a crop needs it.
+    bool binned = false;
+
+    if (!highDetailNeeded && imgsrc->isRAW()
+            && ((imgsrc->getSensorType() == ST_BAYER && rp.bayersensor.method == RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::fast])
+                || (imgsrc->getSensorType() == ST_FUJI_XTRANS && rp.xtranssensor.method == RAWParams::XTransSensor::methodstring[RAWParams::XTransSensor::fast]))) {
+        const int cell = imgsrc->getSensorType() == ST_FUJI_XTRANS ? 3 : 2;
+        int nW, nH;
+        binned = getPreviewScale (scale, nW, nH) >= cell;
+
+        for (size_t i = 0; i < crops.size() && binned; i++) {
+            binned = crops[i]->get_skip() >= cell;
+        }
+    }
+
     progress ("Applying white balance, color correction & sRGB conversion...", 100 * readyphase / numofphases);
 
     if(frameCountListener) {
@@ -220,6 +237,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
 
     if (   (todo & M_RAW)
             || (!highDetailRawComputed && highDetailNeeded)
+            || (binnedRawComputed && !binned)
             || ( params.toneCurve.hrenabled && params.toneCurve.method != "Color" && imgsrc->IsrgbSourceModified())
             || (!params.toneCurve.hrenabled && params.toneCurve.method == "Color" && imgsrc->IsrgbSourceModified())) {
 
@@ -231,7 +249,7 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             }
         }
 
-        imgsrc->demosaic( rp);//enabled demosaic
+        imgsrc->demosaic( rp, binned);//enabled demosaic
         // if a demosaic happened we should also call getimage later, so we need to set the M_INIT flag
         todo |= M_INIT;
 
@@ -241,6 +259,8 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
             highDetailRawComputed = false;
         }
 
+        binnedRawComputed = binned;
+
         if (params.retinex.enabled) {
             lhist16RETI(32768);
             lhist16RETI.clear();
@@ -623,14 +643,18 @@ void ImProcCoordinator::updatePreviewImage (int todo, Crop* cropCall)
     }
 
     if (todo & (M_LUMINANCE + M_COLOR) ) {
-        nprevl->CopyFrom(oprevl);
-
         progress ("Applying Color Boost...", 100 * readyphase / numofphases);
         //   ipf.MSR(nprevl, nprevl->W, nprevl->H, 1);
         histCCurve.clear();
         histLCurve.clear();
-        ipf.chromiLuminanceCurve (nullptr, pW, nprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
-        ipf.vibrance(nprevl);
+
+        if (settings->fusedCurves) {
+            ipf.chromiLuminanceCurveVibrance (pW, oprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
+        } else {
+            nprevl->CopyFrom(oprevl);
+            ipf.chromiLuminanceCurve (nullptr, pW, nprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
+            ipf.vibrance(nprevl);
+        }
 
         if((params.colorappearance.enabled && !params.colorappearance.tonecie) ||  (!params.colorappearance.enabled)) {
             ipf.EPDToneMap(nprevl, 5, 1);
@@ -896,6 +920,36 @@ void ImProcCoordinator::freeAll ()
     allocated = false;
 }
 
+/** @brief Computes the scale of the preview, the largest one up to prevscale giving a preview big enough
+ *
+ * @param prevscale Requested scale.
+ * @param nW, nH Size of the preview at the returned scale.
+ */
+int ImProcCoordinator::getPreviewScale (int prevscale, int& nW, int& nH)
+{
+    int fullW, fullH;
+    imgsrc->getFullSize (fullW, fullH, getCoarseBitMask(params.coarse));
+
+    prevscale++;
+
+    do {
+        prevscale--;
+        PreviewProps pp (0, 0, fullW, fullH, prevscale);
+        imgsrc->getSize (pp, nW, nH);
+    } while(nH < 400 && prevscale > 1 && (nW * nH < 1000000) ); // sctually hardcoded values, perhaps a better choice is possible
+
+    return prevscale;
+}
+
+int ImProcCoordinator::getBinnedCell ()
+{
+    if (!binnedRawComputed) {
+        return 1;
+    }
+
+    return imgsrc->getSensorType() == ST_FUJI_XTRANS ? 3 : 2;
+}
+
 /** @brief Handles image buffer (re)allocation and trigger sizeChanged of SizeListener[s]
  * If the scale change, this method will free all buffers and reallocate ones of the new size.
  * It will then tell to the SizeListener that size has changed (sizeChanged)
@@ -913,14 +967,7 @@ void ImProcCoordinator::setScale (int prevscale)
 
     int nW, nH;
     imgsrc->getFullSize (fw, fh, tr);
-
-    prevscale++;
-
-    do {
-        prevscale--;
-        PreviewProps pp (0, 0, fw, fh, prevscale);
-        imgsrc->getSize (pp, nW, nH);
-    } while(nH < 400 && prevscale > 1 && (nW * nH < 1000000) ); // sctually hardcoded values, perhaps a better choice is possible
+    prevscale = getPreviewScale (prevscale, nW, nH);
 
     if (settings->verbose) {
         printf ("setscale starts (%d, %d)\n", nW, nH);
@@ -1315,6 +1362,8 @@ void ImProcCoordinator::startProcessing(int changeCode)
 
 void ImProcCoordinator::process ()
 {
+    TaskScheduler::Scope scope(TaskScheduler::Priority::PREVIEW);
+
     if (plistener) {
         plistener->setProgressState (true);
     }
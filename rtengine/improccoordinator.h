@@ -28,6 +28,7 @@
 #include "dcrop.h"
 #include "LUT.h"
 #include "../rtgui/threadutils.h"
+#include <atomic>
 
 namespace rtengine
 {
@@ -81,6 +82,7 @@ protected:
     int scale;
     bool highDetailPreprocessComputed;
     bool highDetailRawComputed;
+    std::atomic<bool> binnedRawComputed; // read by the GUI in getBinnedCell
     bool allocated;
 
     void freeAll ();
@@ -178,6 +180,7 @@ protected:
     void progress (Glib::ustring str, int pr);
     void reallocAll ();
     void updateLRGBHistograms ();
+    int getPreviewScale (int prevscale, int& nW, int& nH);
     void setScale (int prevscale);
     void updatePreviewImage (int todo, Crop* cropCall = nullptr);
 
@@ -238,6 +241,7 @@ public:
     {
         return scale;
     }
+    int  getBinnedCell      ();
 
     //void fullUpdatePreviewImage  ();
 
@@ -17,6 +17,7 @@
  *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <cmath>
+#include <cstring>
 #include <glib.h>
 #include <glibmm.h>
 #ifdef _OPENMP
@@ -136,6 +137,7 @@ void ImProcFunctions::updateColorProfiles (const Glib::ustring& monitorProfile,
 
 void ImProcFunctions::firstAnalysis (const Imagefloat* const original, const ProcParams &params, LUTu & histogram)
 {
+    BENCHFUN
 
     TMatrix wprof = ICCStore::getInstance()->workingSpaceMatrix (params.icm.working);
 
@@ -204,6 +206,7 @@ void ImProcFunctions::ciecam_02 (CieImage* ncie, double adap, int begh, int endh
                                  const ColorAppearance & customColCurve1, const ColorAppearance & customColCurve2, const ColorAppearance & customColCurve3,
                                  LUTu & histLCAM, LUTu & histCCAM, LUTf & CAMBrightCurveJ, LUTf & CAMBrightCurveQ, float &mean, int Iterates, int scale, bool execsharp, double &d, int scalecd, int rtt)
 {
+    BENCHFUN
     if(params->colorappearance.enabled) {
 //int lastskip;
 //if(rtt==1) {lastskip=scalecd;} //not for Rtthumbnail
@@ -1449,6 +1452,7 @@ void ImProcFunctions::ciecam_02float (CieImage* ncie, float adap, int begh, int
                                       const ColorAppearance & customColCurve1, const ColorAppearance & customColCurve2, const ColorAppearance & customColCurve3,
                                       LUTu & histLCAM, LUTu & histCCAM, LUTf & CAMBrightCurveJ, LUTf & CAMBrightCurveQ, float &mean, int Iterates, int scale, bool execsharp, float &d, int scalecd, int rtt)
 {
+    BENCHFUN
     if(params->colorappearance.enabled) {
 
 #ifdef _DEBUG
@@ -3399,7 +3403,25 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                 }
 
                 for (int i = istart, ti = 0; i < tH; i++, ti++) {
-                    for (int j = jstart, tj = 0; j < tW; j++, tj++) {
+                    int j = jstart, tj = 0;
+#if defined( __SSE2__ ) && defined( __x86_64__ ) // vectorized LUT access is restricted to __x86_64__
+
+                    for (; j < tW - 3; j += 4, tj += 4) {
+                        const vfloat rv = LVFU(rtemp[ti * TS + tj]);
+                        const vfloat gv = LVFU(gtemp[ti * TS + tj]);
+                        const vfloat bv = LVFU(btemp[ti * TS + tj]);
+
+                        //shadow tone curve
+                        const vfloat Yv = F2V(0.299f) * rv + F2V(0.587f) * gv + F2V(0.114f) * bv;
+                        const vfloat tonefactorv = shtonecurve[Yv];
+                        STVFU(rtemp[ti * TS + tj], rv * tonefactorv);
+                        STVFU(gtemp[ti * TS + tj], gv * tonefactorv);
+                        STVFU(btemp[ti * TS + tj], bv * tonefactorv);
+                    }
+
+#endif
+
+                    for (; j < tW; j++, tj++) {
 
                         float r = rtemp[ti * TS + tj];
                         float g = gtemp[ti * TS + tj];
@@ -3448,7 +3470,21 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                 }
 
                 for (int i = istart, ti = 0; i < tH; i++, ti++) {
-                    for (int j = jstart, tj = 0; j < tW; j++, tj++) {
+                    int j = jstart, tj = 0;
+#if defined( __SSE2__ ) && defined( __x86_64__ )
+
+                    if (!histToneCurveThr) {
+                        for (; j < tW - 3; j += 4, tj += 4) {
+                            //brightness/contrast
+                            STVFU(rtemp[ti * TS + tj], tonecurve[LVFU(rtemp[ti * TS + tj])]);
+                            STVFU(gtemp[ti * TS + tj], tonecurve[LVFU(gtemp[ti * TS + tj])]);
+                            STVFU(btemp[ti * TS + tj], tonecurve[LVFU(btemp[ti * TS + tj])]);
+                        }
+                    }
+
+#endif
+
+                    for (; j < tW; j++, tj++) {
 
                         //brightness/contrast
                         rtemp[ti * TS + tj] = tonecurve[ rtemp[ti * TS + tj] ];
@@ -3473,9 +3509,25 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
 
                 if (hasToneCurve1) {
                     if (curveMode == ToneCurveParams::TC_MODE_STD) { // Standard
+                        const StandardToneCurve& userToneCurve = static_cast<const StandardToneCurve&>(customToneCurve1);
+
                         for (int i = istart, ti = 0; i < tH; i++, ti++) {
-                            for (int j = jstart, tj = 0; j < tW; j++, tj++) {
-                                const StandardToneCurve& userToneCurve = static_cast<const StandardToneCurve&>(customToneCurve1);
+                            int j = jstart, tj = 0;
+#if defined( __SSE2__ ) && defined( __x86_64__ )
+
+                            for (; j < tW - 3; j += 4, tj += 4) {
+                                vfloat rv = LVFU(rtemp[ti * TS + tj]);
+                                vfloat gv = LVFU(gtemp[ti * TS + tj]);
+                                vfloat bv = LVFU(btemp[ti * TS + tj]);
+                                userToneCurve.Apply(rv, gv, bv);
+                                STVFU(rtemp[ti * TS + tj], rv);
+                                STVFU(gtemp[ti * TS + tj], gv);
+                                STVFU(btemp[ti * TS + tj], bv);
+                            }
+
+#endif
+
+                            for (; j < tW; j++, tj++) {
                                 userToneCurve.Apply(rtemp[ti * TS + tj], gtemp[ti * TS + tj], btemp[ti * TS + tj]);
                             }
                         }
@@ -3544,9 +3596,25 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
 
                 if (hasToneCurve2) {
                     if (curveMode2 == ToneCurveParams::TC_MODE_STD) { // Standard
+                        const StandardToneCurve& userToneCurve = static_cast<const StandardToneCurve&>(customToneCurve2);
+
                         for (int i = istart, ti = 0; i < tH; i++, ti++) {
-                            for (int j = jstart, tj = 0; j < tW; j++, tj++) {
-                                const StandardToneCurve& userToneCurve = static_cast<const StandardToneCurve&>(customToneCurve2);
+                            int j = jstart, tj = 0;
+#if defined( __SSE2__ ) && defined( __x86_64__ )
+
+                            for (; j < tW - 3; j += 4, tj += 4) {
+                                vfloat rv = LVFU(rtemp[ti * TS + tj]);
+                                vfloat gv = LVFU(gtemp[ti * TS + tj]);
+                                vfloat bv = LVFU(btemp[ti * TS + tj]);
+                                userToneCurve.Apply(rv, gv, bv);
+                                STVFU(rtemp[ti * TS + tj], rv);
+                                STVFU(gtemp[ti * TS + tj], gv);
+                                STVFU(btemp[ti * TS + tj], bv);
+                            }
+
+#endif
+
+                            for (; j < tW; j++, tj++) {
                                 userToneCurve.Apply(rtemp[ti * TS + tj], gtemp[ti * TS + tj], btemp[ti * TS + tj]);
                             }
                         }
@@ -5421,12 +5489,67 @@ void ImProcFunctions::luminanceCurve (LabImage* lold, LabImage* lnew, LUTf & cur
 
 
 
-SSEFUNCTION void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW, LabImage* lold, LabImage* lnew, LUTf & acurve, LUTf & bcurve, LUTf & satcurve, LUTf & lhskcurve, LUTf & clcurve, LUTf & curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &histCCurve, LUTu &histLCurve)
+namespace
+{
+
+// C=f(H), L=f(H) or H=f(H), null when it is the identity
+FlatCurve* makeHueCurve (const std::vector<double>& points)
+{
+    FlatCurve* const curve = new FlatCurve(points);
+
+    if (curve->isIdentity()) {
+        delete curve;
+        return nullptr;
+    }
+
+    return curve;
+}
+
+}
+
+ImProcFunctions::LabHueCurves::LabHueCurves (const LCurveParams &labCurve)
+{
+    //do not use "Munsell" if the curves are not used
+    if (labCurve.chromaticity > -100) {
+        ch.reset(makeHueCurve(labCurve.chcurve));
+        lh.reset(makeHueCurve(labCurve.lhcurve));
+        hh.reset(makeHueCurve(labCurve.hhcurve));
+    }
+}
+
+void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW, LabImage* lold, LabImage* lnew, LUTf & acurve, LUTf & bcurve, LUTf & satcurve, LUTf & lhskcurve, LUTf & clcurve, LUTf & curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &histCCurve, LUTu &histLCurve)
+{
+    BENCHFUN
+    //init Flatcurve for C=f(H)
+    const LabHueCurves hueCurves (params->labCurve);
+
+    LUTu hist16Clad;
+    LUTu hist16Llad;
+
+    //preparate for histograms CIECAM
+    if(pW != 1) { //only with improccoordinator
+        hist16Clad(65536);
+        hist16Clad.clear();
+        hist16Llad(65536);
+        hist16Llad.clear();
+
+    }
+
+    chromiLuminanceCurve (pipetteBuffer, pW, lold, lnew, hueCurves, acurve, bcurve, satcurve, lhskcurve, clcurve, curve, utili, autili, butili, ccutili, cclutili, clcutili, hist16Clad, hist16Llad);
+
+    if(pW != 1) { //only with improccoordinator
+        //update histogram C  with data chromaticity and not with CC curve
+        hist16Clad.compressTo(histCCurve);
+        //update histogram L with data luminance
+        hist16Llad.compressTo(histLCurve);
+    }
+}
+
+SSEFUNCTION void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW, LabImage* lold, LabImage* lnew, const LabHueCurves &hueCurves, LUTf & acurve, LUTf & bcurve, LUTf & satcurve, LUTf & lhskcurve, LUTf & clcurve, LUTf & curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &hist16Clad, LUTu &hist16Llad)
 {
     int W = lold->W;
     int H = lold->H;
     // lhskcurve.dump("lh_curve");
-    //init Flatcurve for C=f(H)
 
     PlanarWhateverData<float>* editWhatever = nullptr;
     EditUniqueID editID = EUID_None;
@@ -5452,69 +5575,12 @@ SSEFUNCTION void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBu
         }
     }
 
-    FlatCurve* chCurve = nullptr;// curve C=f(H)
-    bool chutili = false;
-
-    if (params->labCurve.chromaticity > -100) {
-        chCurve = new FlatCurve(params->labCurve.chcurve);
-
-        if (!chCurve || chCurve->isIdentity()) {
-            if (chCurve) {
-                delete chCurve;
-                chCurve = nullptr;
-            }
-        }//do not use "Munsell" if Chcurve not used
-        else {
-            chutili = true;
-        }
-    }
-
-    FlatCurve* lhCurve = nullptr;//curve L=f(H)
-    bool lhutili = false;
-
-    if (params->labCurve.chromaticity > -100) {
-        lhCurve = new FlatCurve(params->labCurve.lhcurve);
-
-        if (!lhCurve || lhCurve->isIdentity()) {
-            if (lhCurve) {
-                delete lhCurve;
-                lhCurve = nullptr;
-            }
-        }//do not use "Munsell" if Chcurve not used
-        else {
-            lhutili = true;
-        }
-    }
-
-    FlatCurve* hhCurve = nullptr;//curve H=f(H)
-    bool hhutili = false;
-
-    if (params->labCurve.chromaticity > -100) {
-        hhCurve = new FlatCurve(params->labCurve.hhcurve);
-
-        if (!hhCurve || hhCurve->isIdentity()) {
-            if (hhCurve) {
-                delete hhCurve;
-                hhCurve = nullptr;
-            }
-        }//do not use "Munsell" if Chcurve not used
-        else {
-            hhutili = true;
-        }
-    }
-
-
-    LUTu hist16Clad;
-    LUTu hist16Llad;
-
-    //preparate for histograms CIECAM
-    if(pW != 1) { //only with improccoordinator
-        hist16Clad(65536);
-        hist16Clad.clear();
-        hist16Llad(65536);
-        hist16Llad.clear();
-
-    }
+    const FlatCurve* const chCurve = hueCurves.ch.get();// curve C=f(H)
+    const bool chutili = chCurve;
+    const FlatCurve* const lhCurve = hueCurves.lh.get();//curve L=f(H)
+    const bool lhutili = lhCurve;
+    const FlatCurve* const hhCurve = hueCurves.hh.get();//curve H=f(H)
+    const bool hhutili = hhCurve;
 
 #ifdef _DEBUG
     MyTime t1e, t2e;
@@ -6154,13 +6220,6 @@ SSEFUNCTION void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBu
         }
     } // end of parallelization
 
-    if(pW != 1) { //only with improccoordinator
-        //update histogram C  with data chromaticity and not with CC curve
-        hist16Clad.compressTo(histCCurve);
-        //update histogram L with data luminance
-        hist16Llad.compressTo(histLCurve);
-    }
-
 #ifdef _DEBUG
 
     if (settings->verbose) {
@@ -6173,20 +6232,71 @@ SSEFUNCTION void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBu
     delete MunsDebugInfo;
 #endif
 
-    if (chCurve) {
-        delete chCurve;
-    }
+    //  t2e.set();
+    //  printf("Chromil took %d nsec\n",t2e.etime(t1e));
+}
 
-    if (lhCurve) {
-        delete lhCurve;
-    }
+void ImProcFunctions::chromiLuminanceCurveVibrance (int pW, LabImage* lold, LabImage* lnew, LUTf & acurve, LUTf & bcurve, LUTf & satcurve, LUTf & lhskcurve, LUTf & clcurve, LUTf & curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &histCCurve, LUTu &histLCurve)
+{
+    BENCHFUN
+    const int W = lnew->W;
+    const int H = lnew->H;
+    // bands of about 1 MiB of L*a*b* data stay in the cache from the copy to the end of vibrance
+    const int bandHeight = std::max((1 << 20) / (3 * int(sizeof(float)) * W), 4);
 
-    if (hhCurve) {
-        delete hhCurve;
+    // the curves are built once, the bands only run the per pixel part
+    const LabHueCurves hueCurves (params->labCurve);
+    LUTf skin_curve;
+
+    if (params->vibrance.enabled) {
+        vibranceSkinCurve (skin_curve);
     }
 
-    //  t2e.set();
-    //  printf("Chromil took %d nsec\n",t2e.etime(t1e));
+#ifdef _OPENMP
+    #pragma omp parallel if (multiThread)
+#endif
+    {
+        // both steps only depend on the pixel itself, so each band goes through them on a single thread
+        ImProcFunctions bandIpf(params, false);
+        LUTu hist16Clad, hist16Llad;
+
+        if (pW != 1) {
+            hist16Clad(65536);
+            hist16Clad.clear();
+            hist16Llad(65536);
+            hist16Llad.clear();
+        }
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+
+        for (int y = 0; y < H; y += bandHeight) {
+            const int rows = std::min(bandHeight, H - y);
+            LabImage band(lnew, y, rows);
+
+            if (lold != lnew) {
+                for (int i = 0; i < rows; i++) {
+                    memcpy(band.L[i], lold->L[y + i], W * sizeof(float));
+                    memcpy(band.a[i], lold->a[y + i], W * sizeof(float));
+                    memcpy(band.b[i], lold->b[y + i], W * sizeof(float));
+                }
+            }
+
+            bandIpf.chromiLuminanceCurve (nullptr, pW, &band, &band, hueCurves, acurve, bcurve, satcurve, lhskcurve, clcurve, curve, utili, autili, butili, ccutili, cclutili, clcutili, hist16Clad, hist16Llad);
+            bandIpf.vibrance (&band, skin_curve);
+        }
+
+        if (pW != 1) {
+#ifdef _OPENMP
+            #pragma omp critical
+#endif
+            {
+                hist16Clad.compressTo(histCCurve);
+                hist16Llad.compressTo(histLCurve);
+            }
+        }
+    }
 }
 
 
@@ -6274,6 +6384,7 @@ void ImProcFunctions::colorCurve (LabImage* lold, LabImage* lnew)
 
 void ImProcFunctions::impulsedenoise (LabImage* lab)
 {
+    BENCHFUN
 
     if (params->impulseDenoise.enabled && lab->W >= 8 && lab->H >= 8)
 
@@ -6294,6 +6405,7 @@ void ImProcFunctions::impulsedenoisecam (CieImage* ncie, float **buffers[3])
 
 void ImProcFunctions::defringe (LabImage* lab)
 {
+    BENCHFUN
 
     if (params->defringe.enabled && lab->W >= 8 && lab->H >= 8)
 
@@ -6325,6 +6437,7 @@ void ImProcFunctions::badpixlab(LabImage* lab, double rad, int thr, int mode, fl
 
 void ImProcFunctions::dirpyrequalizer (LabImage* lab, int scale)
 {
+    BENCHFUN
     if (params->dirpyrequalizer.enabled && lab->W >= 8 && lab->H >= 8) {
         float b_l = static_cast<float>(params->dirpyrequalizer.hueskin.value[0]) / 100.0f;
         float t_l = static_cast<float>(params->dirpyrequalizer.hueskin.value[1]) / 100.0f;
@@ -6461,6 +6574,7 @@ void ImProcFunctions::EPDToneMapCIE(CieImage *ncie, float a_w, float c_, float w
 //#include "EdgePreservingDecomposition.cc"
 void ImProcFunctions::EPDToneMap(LabImage *lab, unsigned int Iterates, int skip)
 {
+    BENCHFUN
     //Hasten access to the parameters.
 //  EPDParams *p = (EPDParams *)(&params->epd);
 
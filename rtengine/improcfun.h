@@ -19,6 +19,8 @@
 #ifndef _IMPROCFUN_H_
 #define _IMPROCFUN_H_
 
+#include <memory>
+
 #include "imagefloat.h"
 #include "image16.h"
 #include "image8.h"
@@ -231,7 +233,22 @@ public:
                            const ColorAppearance & customColCurve1, const ColorAppearance & customColCurve, const ColorAppearance & customColCurve3,
                            LUTu &histLCAM, LUTu &histCCAM, LUTf & CAMBrightCurveJ, LUTf & CAMBrightCurveQ, float &mean, int Iterates, int scale, bool execsharp, double &d, int scalecd, int rtt);
     void chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW, LabImage* lold, LabImage* lnew, LUTf &acurve, LUTf &bcurve, LUTf & satcurve, LUTf & satclcurve, LUTf &clcurve, LUTf &curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &histCCurve, LUTu &histLurve);
+    // The hue curves of chromiLuminanceCurve(), null when not used
+    struct LabHueCurves {
+        explicit LabHueCurves (const LCurveParams &labCurve);
+
+        std::unique_ptr<FlatCurve> ch; // C=f(H)
+        std::unique_ptr<FlatCurve> lh; // L=f(H)
+        std::unique_ptr<FlatCurve> hh; // H=f(H)
+    };
+    // chromiLuminanceCurve with the curves built beforehand, the histograms at full resolution (65536 entries) are only added to
+    void chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW, LabImage* lold, LabImage* lnew, const LabHueCurves &hueCurves, LUTf &acurve, LUTf &bcurve, LUTf & satcurve, LUTf & satclcurve, LUTf &clcurve, LUTf &curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &hist16Clad, LUTu &hist16Llad);
+    // chromiLuminanceCurve followed by vibrance in one cache-blocked pass, lold is copied to lnew on the way (see Settings::fusedCurves)
+    void chromiLuminanceCurveVibrance (int pW, LabImage* lold, LabImage* lnew, LUTf &acurve, LUTf &bcurve, LUTf & satcurve, LUTf & satclcurve, LUTf &clcurve, LUTf &curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &histCCurve, LUTu &histLCurve);
     void vibrance         (LabImage* lab);//Jacques' vibrance
+    // vibrance with the skin tones curve built beforehand by vibranceSkinCurve, empty when not used
+    void vibrance         (LabImage* lab, const LUTf &skin_curve);
+    void vibranceSkinCurve (LUTf &skin_curve) const;
     void colorCurve       (LabImage* lold, LabImage* lnew);
     void sharpening       (LabImage* lab, float** buffer, SharpeningParams &sharpenParam);
     void sharpeningcam    (CieImage* ncie, float** buffer);
@@ -240,6 +257,7 @@ public:
     float resizeScale     (const ProcParams* params, int fw, int fh, int &imw, int &imh);
     void lab2monitorRgb   (LabImage* lab, Image8* image);
     void resize           (Image16* src, Image16* dst, float dScale);
+    void resize           (Imagefloat* src, Imagefloat* dst, float dScale);
     void Lanczos (const LabImage* src, LabImage* dst, float scale);
     void Lanczos (const Image16* src, Image16* dst, float scale);
 
@@ -345,6 +363,14 @@ public:
 
     Image8*     lab2rgb   (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm);
     Image16*    lab2rgb16 (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga=nullptr);
+    Imagefloat* lab2rgbFloat (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga=nullptr);
+#ifdef RT_CPU_DISPATCH
+    // variants of the kernels built for AVX2, see cpudispatch.h
+    void        lab2monitorRgb_avx2 (LabImage* lab, Image8* image);
+    Image8*     lab2rgb_avx2   (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm);
+    Image16*    lab2rgb16_avx2 (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga);
+    Imagefloat* lab2rgbFloat_avx2 (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga);
+#endif
     // CieImage *ciec;
 
     bool transCoord       (int W, int H, int x, int y, int w, int h, int& xv, int& yv, int& wv, int& hv, double ascaleDef = -1, const LCPMapper *pLCPMap = nullptr);
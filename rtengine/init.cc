@@ -16,16 +16,22 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+
 #include "rtengine.h"
 #include "iccstore.h"
 #include "dcp.h"
 #include "camconst.h"
+#include "cpudispatch.h"
 #include "curves.h"
 #include "rawimagesource.h"
 #include "improcfun.h"
 #include "improccoordinator.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
+#include "demosaiccache.h"
+#include "fftwplancache.h"
+#include "profiler.h"
 #include "rtthumbnail.h"
 #include "../rtgui/profilestore.h"
 #include "../rtgui/threadutils.h"
@@ -40,6 +46,7 @@ MyMutex* lcmsMutex = nullptr;
 int init (const Settings* s, Glib::ustring baseDir, Glib::ustring userSettingsDir, bool loadAll)
 {
     settings = s;
+    initCpuTarget (s->cpuTarget);
     ICCStore::getInstance()->init (s->iccDirectory, Glib::build_filename (baseDir, "iccprofiles"), loadAll);
     DCPStore::getInstance()->init (Glib::build_filename (baseDir, "dcpprofiles"), loadAll);
 
@@ -52,11 +59,20 @@ int init (const Settings* s, Glib::ustring baseDir, Glib::ustring userSettingsDi
     lcmsMutex = new MyMutex;
     dfm.init( s->darkFramesPath );
     ffm.init( s->flatFieldsPath );
+    DemosaicCache::getInstance().init(Glib::build_filename(s->cacheDirectory, "demosaic"), s->demosaicCache, std::max(s->demosaicCacheSize, 0));
+    FFTWPlanCache::getInstance().init(Glib::build_filename(s->cacheDirectory, "fftw3f.wisdom"));
+
+    if (const char* profileFile = g_getenv("RT_PROFILE")) {
+        Profiler::getInstance().enable(Glib::filename_to_utf8(profileFile));
+    }
+
     return 0;
 }
 
 void cleanup ()
 {
+    Profiler::getInstance().write();
+    FFTWPlanCache::getInstance().saveWisdom();
 
     ProcParams::cleanup ();
     Color::cleanup ();
@@ -26,6 +26,10 @@
 #include "curves.h"
 #include "alignedbuffer.h"
 #include "color.h"
+#include "StopWatch.h"
+#include "cpudispatch.h"
+
+RT_TARGET_BEGIN
 
 namespace rtengine
 {
@@ -38,8 +42,10 @@ extern const Settings* settings;
 //
 // If monitorTransform, divide by 327.68 then apply monitorTransform (which can integrate soft-proofing)
 // otherwise divide by 327.68, convert to xyz and apply the sRGB transform, before converting with gamma2curve
-void ImProcFunctions::lab2monitorRgb (LabImage* lab, Image8* image)
+void ImProcFunctions::RT_KERNEL(lab2monitorRgb) (LabImage* lab, Image8* image)
 {
+    RT_DISPATCH(lab2monitorRgb, lab, image)
+
     if (monitorTransform) {
 
         int W = lab->W;
@@ -122,8 +128,11 @@ void ImProcFunctions::lab2monitorRgb (LabImage* lab, Image8* image)
 //
 // If output profile used, divide by 327.68 then apply the "profile" profile (eventually with a standard gamma)
 // otherwise divide by 327.68, convert to xyz and apply the RGB transform, before converting with gamma2curve
-Image8* ImProcFunctions::lab2rgb (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm)
+Image8* ImProcFunctions::RT_KERNEL(lab2rgb) (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm)
 {
+    RT_DISPATCH(lab2rgb, lab, cx, cy, cw, ch, icm)
+
+    BENCHFUN
     //gamutmap(lab);
 
     if (cx < 0) {
@@ -247,24 +256,13 @@ Image8* ImProcFunctions::lab2rgb (LabImage* lab, int cx, int cy, int cw, int ch,
 }
 
 
-/** @brief Convert the final Lab image to the output RGB color space
- *
- * Used in processImage   (rtengine/simpleprocess.cc)
- *
- * Provide a pointer to a 7 floats array for "ga" (uninitialized ; this array will be filled with the gamma values) if you want
- * to use the custom gamma scenario. Thoses gamma values will correspond to the ones of the chosen standard output profile
- * (Prophoto if non standard output profile given)
- *
- * If "ga" is NULL, then we're considering standard gamma with the chosen output profile.
- *
- * Generate an Image16
- *
- * If a custom gamma profile can be created, divide by 327.68, convert to xyz and apply the custom gamma transform
- * otherwise divide by 327.68, convert to xyz and apply the sRGB transform, before converting with gamma2curve
- */
-Image16* ImProcFunctions::lab2rgb16 (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga)
+namespace
 {
 
+// The conversion of lab2rgb16 and lab2rgbFloat, for their output image type and its LittleCMS sample format
+template<typename ImageType>
+ImageType* lab2rgbImage (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, GammaValues *ga, cmsUInt32Number outputFormat, bool multiThread)
+{
     if (cx < 0) {
         cx = 0;
     }
@@ -281,7 +279,7 @@ Image16* ImProcFunctions::lab2rgb16 (LabImage* lab, int cx, int cy, int cw, int
         ch = lab->H - cy;
     }
 
-    Image16* image = new Image16 (cw, ch);
+    ImageType* image = new ImageType (cw, ch);
 
     cmsHPROFILE oprof = nullptr;
     if (ga) {
@@ -300,7 +298,7 @@ Image16* ImProcFunctions::lab2rgb16 (LabImage* lab, int cx, int cy, int cw, int
         }
         lcmsMutex->lock ();
         cmsHPROFILE iprof = cmsCreateLab4Profile(nullptr);
-        cmsHTRANSFORM hTransform = cmsCreateTransform (iprof, TYPE_Lab_FLT, oprof, TYPE_RGB_16, icm.outputIntent, flags);
+        cmsHTRANSFORM hTransform = cmsCreateTransform (iprof, TYPE_Lab_FLT, oprof, outputFormat, icm.outputIntent, flags);
         lcmsMutex->unlock ();
 
         image->ExecCMSTransform(hTransform, *lab, cx, cy);
@@ -329,9 +327,10 @@ Image16* ImProcFunctions::lab2rgb16 (LabImage* lab, int cx, int cy, int cw, int
 
                 Color::xyz2srgb(x_, y_, z_, R, G, B);
 
-                image->r(i - cy, j - cx) = (int)Color::gamma2curve[CLIP(R)];
-                image->g(i - cy, j - cx) = (int)Color::gamma2curve[CLIP(G)];
-                image->b(i - cy, j - cx) = (int)Color::gamma2curve[CLIP(B)];
+                // truncated for the 16 bit output
+                image->r(i - cy, j - cx) = Color::gamma2curve[CLIP(R)];
+                image->g(i - cy, j - cx) = Color::gamma2curve[CLIP(G)];
+                image->b(i - cy, j - cx) = Color::gamma2curve[CLIP(B)];
             }
         }
     }
@@ -340,3 +339,42 @@ Image16* ImProcFunctions::lab2rgb16 (LabImage* lab, int cx, int cy, int cw, int
 }
 
 }
+
+/** @brief Convert the final Lab image to the output RGB color space
+ *
+ * Used in processImage   (rtengine/simpleprocess.cc)
+ *
+ * Provide a pointer to a 7 floats array for "ga" (uninitialized ; this array will be filled with the gamma values) if you want
+ * to use the custom gamma scenario. Thoses gamma values will correspond to the ones of the chosen standard output profile
+ * (Prophoto if non standard output profile given)
+ *
+ * If "ga" is NULL, then we're considering standard gamma with the chosen output profile.
+ *
+ * Generate an Image16
+ *
+ * If a custom gamma profile can be created, divide by 327.68, convert to xyz and apply the custom gamma transform
+ * otherwise divide by 327.68, convert to xyz and apply the sRGB transform, before converting with gamma2curve
+ */
+Image16* ImProcFunctions::RT_KERNEL(lab2rgb16) (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga)
+{
+    RT_DISPATCH(lab2rgb16, lab, cx, cy, cw, ch, icm, bw, ga)
+
+    BENCHFUN
+
+    return lab2rgbImage<Image16> (lab, cx, cy, cw, ch, icm, ga, TYPE_RGB_16, multiThread);
+}
+
+// Same as lab2rgb16, without the quantization of the output: used for the floating point TIFF output, the values are
+// in [0;65535] but not clipped when the output profile is applied
+Imagefloat* ImProcFunctions::RT_KERNEL(lab2rgbFloat) (LabImage* lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga)
+{
+    RT_DISPATCH(lab2rgbFloat, lab, cx, cy, cw, ch, icm, bw, ga)
+
+    BENCHFUN
+
+    return lab2rgbImage<Imagefloat> (lab, cx, cy, cw, ch, icm, ga, TYPE_RGB_FLT, multiThread);
+}
+
+}
+
+RT_TARGET_END
@@ -21,6 +21,7 @@
 #include "rt_math.h"
 #include "sleef.c"
 #include "opthelper.h"
+#include "StopWatch.h"
 //#define PROFILE
 
 #ifdef PROFILE
@@ -43,8 +44,30 @@ static inline float Lanc (float x, float a)
     }
 }
 
+template<class Image>
+void resizeNearest (const Image* src, Image* dst, float dScale, bool multiThread)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for if (multiThread)
+#endif
+
+    for (int i = 0; i < dst->getHeight(); i++) {
+        int sy = i / dScale;
+        sy = LIM (sy, 0, src->getHeight() - 1);
+
+        for (int j = 0; j < dst->getWidth(); j++) {
+            int sx = j / dScale;
+            sx = LIM (sx, 0, src->getWidth() - 1);
+            dst->r (i, j) = src->r (sy, sx);
+            dst->g (i, j) = src->g (sy, sx);
+            dst->b (i, j) = src->b (sy, sx);
+        }
+    }
+}
+
 void ImProcFunctions::Lanczos (const Image16* src, Image16* dst, float scale)
 {
+    BENCHFUN
 
     const float delta = 1.0f / scale;
     const float a = 3.0f;
@@ -174,6 +197,7 @@ void ImProcFunctions::Lanczos (const Image16* src, Image16* dst, float scale)
 
 SSEFUNCTION void ImProcFunctions::Lanczos (const LabImage* src, LabImage* dst, float scale)
 {
+    BENCHFUN
     const float delta = 1.0f / scale;
     const float a = 3.0f;
     const float sc = min (scale, 1.0f);
@@ -403,23 +427,7 @@ void ImProcFunctions::resize (Image16* src, Image16* dst, float dScale)
     if (params->resize.method != "Nearest" ) {
         Lanczos (src, dst, dScale);
     } else {
-        // Nearest neighbour algorithm
-#ifdef _OPENMP
-        #pragma omp parallel for if (multiThread)
-#endif
-
-        for (int i = 0; i < dst->getHeight(); i++) {
-            int sy = i / dScale;
-            sy = LIM (sy, 0, src->getHeight() - 1);
-
-            for (int j = 0; j < dst->getWidth(); j++) {
-                int sx = j / dScale;
-                sx = LIM (sx, 0, src->getWidth() - 1);
-                dst->r (i, j) = src->r (sy, sx);
-                dst->g (i, j) = src->g (sy, sx);
-                dst->b (i, j) = src->b (sy, sx);
-            }
-        }
+        resizeNearest (src, dst, dScale, multiThread);
     }
 
 #ifdef PROFILE
@@ -429,4 +437,10 @@ void ImProcFunctions::resize (Image16* src, Image16* dst, float dScale)
 #endif
 }
 
+// Only the nearest neighbour is applied to the RGB output, the other methods resize the L*a*b* data
+void ImProcFunctions::resize (Imagefloat* src, Imagefloat* dst, float dScale)
+{
+    resizeNearest (src, dst, dScale, multiThread);
+}
+
 }
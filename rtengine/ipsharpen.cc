@@ -23,6 +23,7 @@
 #include "rt_math.h"
 #include "sleef.c"
 #include "opthelper.h"
+#include "StopWatch.h"
 using namespace std;
 
 namespace rtengine
@@ -152,6 +153,7 @@ void ImProcFunctions::deconvsharpening (float** luminance, float** tmp, int W, i
 
 void ImProcFunctions::sharpening (LabImage* lab, float** b2, SharpeningParams &sharpenParam)
 {
+    BENCHFUN
 
     if (!sharpenParam.enabled) {
         return;
@@ -325,6 +327,7 @@ void ImProcFunctions::sharpenHaloCtrl (float** luminance, float** blurmap, float
 // Thanks to Manuel for this excellent job (Jacques Desmis JDC or frej83)
 void ImProcFunctions::MLsharpen (LabImage* lab)
 {
+    BENCHFUN
     // JD: this algorithm maximize clarity of images; it does not play on accutance. It can remove (partialy) the effects of the AA filter)
     // I think we can use this algorithm alone in most cases, or first to clarify image and if you want a very little USM (unsharp mask sharpening) after...
     if (!params->sharpenEdge.enabled) {
@@ -912,6 +915,7 @@ void ImProcFunctions::MLmicrocontrast(float** luminance, int W, int H)
 
 void ImProcFunctions::MLmicrocontrast(LabImage* lab)
 {
+    BENCHFUN
     MLmicrocontrast(lab->L, lab->W, lab->H);
 }
 
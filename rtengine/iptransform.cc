@@ -24,6 +24,7 @@
 #include "mytime.h"
 #include "rt_math.h"
 #include "sleef.c"
+#include "StopWatch.h"
 
 
 using namespace std;
@@ -309,6 +310,7 @@ bool ImProcFunctions::transCoord (int W, int H, int x, int y, int w, int h, int&
 void ImProcFunctions::transform (Imagefloat* original, Imagefloat* transformed, int cx, int cy, int sx, int sy, int oW, int oH, int fW, int fH,
                                  double focalLen, double focalLen35mm, float focusDist, int rawRotationDeg, bool fullImage)
 {
+    BENCHFUN
 
     LCPMapper *pLCPMap = nullptr;
 
@@ -28,6 +28,7 @@
 #include "../rtgui/thresholdselector.h"
 #include "curves.h"
 #include "color.h"
+#include "StopWatch.h"
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -45,7 +46,7 @@ using namespace procparams;
 
 extern const Settings* settings;
 
-void fillCurveArrayVib (DiagonalCurve* diagCurve, LUTf &outCurve)
+void fillCurveArrayVib (const DiagonalCurve* diagCurve, LUTf &outCurve)
 {
 
     if (diagCurve) {
@@ -65,6 +66,18 @@ void fillCurveArrayVib (DiagonalCurve* diagCurve, LUTf &outCurve)
 }
 
 
+void ImProcFunctions::vibranceSkinCurve (LUTf &skin_curve) const
+{
+    const DiagonalCurve dcurve (params->vibrance.skintonescurve, CURVES_MIN_POLY_POINTS);
+
+    if (!dcurve.isIdentity()) {
+        // skin hue curve
+        // I use diagonal because I think it's better
+        skin_curve (65536, 0);
+        fillCurveArrayVib (&dcurve, skin_curve);
+    }
+}
+
 /*
  * Vibrance correction
  * copyright (c)2011  Jacques Desmis <jdesmis@gmail.com> and Jean-Christophe Frisch <natureh@free.fr>
@@ -72,30 +85,21 @@ void fillCurveArrayVib (DiagonalCurve* diagCurve, LUTf &outCurve)
  */
 void ImProcFunctions::vibrance (LabImage* lab)
 {
+    BENCHFUN
     if (!params->vibrance.enabled) {
         return;
     }
 
-//  int skip=1; //scale==1 ? 1 : 16;
-    bool skinCurveIsSet = false;
-    DiagonalCurve* dcurve = nullptr;
-    dcurve = new DiagonalCurve (params->vibrance.skintonescurve, CURVES_MIN_POLY_POINTS);
-
-    if (dcurve) {
-        if (!dcurve->isIdentity()) {
-            skinCurveIsSet = true;
-        } else {
-            delete dcurve;
-            dcurve = nullptr;
-        }
-    }
+    LUTf skin_curve;
+    vibranceSkinCurve (skin_curve);
+    vibrance (lab, skin_curve);
+}
 
-    if (!skinCurveIsSet && !params->vibrance.pastels && !params->vibrance.saturated) {
-        if (dcurve) {
-            delete dcurve;
-            dcurve = nullptr;
-        }
+void ImProcFunctions::vibrance (LabImage* lab, const LUTf &skin_curve)
+{
+    const bool skinCurveIsSet = skin_curve;
 
+    if (!params->vibrance.enabled || (!skinCurveIsSet && !params->vibrance.pastels && !params->vibrance.saturated)) {
         return;
     }
 
@@ -108,20 +112,6 @@ void ImProcFunctions::vibrance (LabImage* lab)
     int negat = 0, moreRGB = 0, negsat = 0, moresat = 0;
 #endif
 
-    // skin hue curve
-    // I use diagonal because I think it's better
-    LUTf skin_curve (65536, 0);
-
-    if (skinCurveIsSet) {
-        fillCurveArrayVib (dcurve, skin_curve);
-    }
-
-    if (dcurve) {
-        delete dcurve;
-        dcurve = nullptr;
-    }
-
-
 // skin_curve.dump("skin_curve");
 
     const float chromaPastel = float (params->vibrance.pastels)   / 100.0f;
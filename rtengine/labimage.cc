@@ -8,6 +8,10 @@ LabImage::LabImage (int w, int h) : fromImage(false), W(w), H(h)
     allocLab(w, h);
 }
 
+LabImage::LabImage (LabImage* source, int y, int h) : fromImage(true), W(source->W), H(h), data(nullptr), L(source->L + y), a(source->a + y), b(source->b + y)
+{
+}
+
 LabImage::~LabImage ()
 {
     deleteLab();
@@ -59,6 +59,8 @@ public:
     float** b;
 
     LabImage (int w, int h);
+    // Rows y to y + h - 1 of source, sharing its data. CopyFrom() can not be used on such a band.
+    LabImage (LabImage* source, int y, int h);
     ~LabImage ();
 
     //Copies image data in Img into this instance.
@@ -18,10 +18,18 @@
  */
 #include "myfile.h"
 #include <cstdarg>
+#include <deque>
+#include <vector>
 #include <glibmm.h>
 #ifdef BZIP_SUPPORT
 #include <bzlib.h>
 #endif
+#include "settings.h"
+
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
 
 // get mmap() sorted out
 #ifdef MYFILE_MMAP
@@ -43,7 +51,7 @@ void* mmap(void *start, size_t length, int prot, int flags, int fd, off_t offset
     if (handle != NULL) {
         start = MapViewOfFile(handle, FILE_MAP_COPY, 0, offset, length);
         CloseHandle(handle);
-        return start;
+        return start ? start : MAP_FAILED;
     }
 
     return MAP_FAILED;
@@ -57,16 +65,83 @@ int munmap(void *start, size_t length)
 
 #else // WIN32
 
-#include <unistd.h>
-#include <fcntl.h>
 #include <sys/mman.h>
 
+#ifdef __linux__
+#include <sys/vfs.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+
 #endif // WIN32
 #endif // MYFILE_MMAP
 
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+}
+
+namespace
+{
+
 #ifdef MYFILE_MMAP
 
-IMFILE* fopen (const char* fname)
+// A mapped file which becomes unreachable or is truncated by another client raises SIGBUS
+// on the next access, and page faults are served by small synchronous network requests.
+// Files on network file systems are therefore read in one go instead.
+#ifdef __linux__
+bool isNetworkFile (int fd, const char* fname)
+{
+    struct statfs buf;
+
+    if (fstatfs (fd, &buf) != 0) {
+        return false;
+    }
+
+    switch (static_cast<unsigned long>(buf.f_type) & 0xffffffffUL) {
+        case 0x6969UL:     // NFS
+        case 0x517bUL:     // SMB
+        case 0xff534d42UL: // CIFS
+        case 0xfe534d42UL: // SMB2
+        case 0x65735546UL: // FUSE (sshfs, gvfs, ...)
+        case 0x5346414fUL: // AFS
+        case 0x73757245UL: // Coda
+        case 0x01021997UL: // 9P
+        case 0x00c36400UL: // Ceph
+            return true;
+
+        default:
+            return false;
+    }
+}
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+bool isNetworkFile (int fd, const char* fname)
+{
+    struct statfs buf;
+    return fstatfs (fd, &buf) == 0 && !(buf.f_flags & MNT_LOCAL);
+}
+#elif defined(WIN32)
+bool isNetworkFile (int fd, const char* fname)
+{
+    if (fname[0] && fname[1] == ':') {
+        const wchar_t root[] = {static_cast<wchar_t>(fname[0]), L':', L'\\', 0};
+        return GetDriveTypeW (root) == DRIVE_REMOTE;
+    }
+
+    // UNC path
+    return (fname[0] == '\\' || fname[0] == '/') && (fname[1] == '\\' || fname[1] == '/');
+}
+#else
+bool isNetworkFile (int fd, const char* fname)
+{
+    return false;
+}
+#endif
+
+IMFILE* mapFile (const char* fname)
 {
     int fd;
 
@@ -83,7 +158,7 @@ IMFILE* fopen (const char* fname)
 
 #else
 
-    fd = ::g_open (fname, O_RDONLY);
+    fd = ::g_open (fname, O_RDONLY, 0);
 
 #endif
 
@@ -93,8 +168,7 @@ IMFILE* fopen (const char* fname)
 
     struct stat stat_buffer;
 
-    if ( fstat(fd, &stat_buffer) < 0 ) {
-        printf("no stat\n");
+    if ( fstat(fd, &stat_buffer) < 0 || stat_buffer.st_size <= 0 || isNetworkFile (fd, fname) ) {
         close (fd);
         return nullptr;
     }
@@ -102,7 +176,6 @@ IMFILE* fopen (const char* fname)
     void* data = mmap(nullptr, stat_buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
     if ( data == MAP_FAILED ) {
-        printf("no mmap\n");
         close(fd);
         return nullptr;
     }
@@ -116,213 +189,258 @@ IMFILE* fopen (const char* fname)
     mf->data = (char*)data;
     mf->eof = false;
 
-#ifdef BZIP_SUPPORT
-    {
-        bool bzip = false;
-        Glib::ustring bname = Glib::path_get_basename(fname);
-        size_t lastdot = bname.find_last_of ('.');
+    return mf;
+}
 
-        if (lastdot != bname.npos) {
-            bzip = bname.substr (lastdot).casefold() == Glib::ustring(".bz2").casefold();
-        }
+#endif // MYFILE_MMAP
+
+IMFILE* readFile (const char* fname)
+{
+
+    FILE* f = g_fopen (fname, "rb");
+
+    if (!f) {
+        return nullptr;
+    }
 
-        if (bzip) {
-            int ret;
+    IMFILE* mf = new IMFILE;
+    memset(mf, 0, sizeof(*mf));
+    mf->fd = -1;
+    fseek (f, 0, SEEK_END);
+    mf->size = ftell (f);
+    mf->data = new char [mf->size];
+    fseek (f, 0, SEEK_SET);
+    mf->size = fread (mf->data, 1, mf->size, f);
+    fclose (f);
+    mf->pos = 0;
+    mf->eof = false;
 
-            // initialize bzip stream structure
-            bz_stream stream;
-            stream.bzalloc = nullptr;
-            stream.bzfree = nullptr;
-            stream.opaque = nullptr;
-            ret = BZ2_bzDecompressInit(&stream, 0, 0);
+    return mf;
+}
 
-            if (ret != BZ_OK) {
-                printf("bzip initialization failed with error %d\n", ret);
-            } else {
-                // allocate initial buffer for decompressed data
-                unsigned int buffer_out_count = 0; // bytes of decompressed data
-                unsigned int buffer_size = 10 * 1024 * 1024; // 10 MB, extended dynamically if needed
-                char* buffer = nullptr;
+void releaseData (IMFILE* f)
+{
+#ifdef MYFILE_MMAP
 
-                stream.next_in = mf->data; // input data address
-                stream.avail_in = mf->size;
+    if ( f->fd != -1 ) {
+        munmap((void*)f->data, f->size);
+        close(f->fd);
+        f->fd = -1;
+        return;
+    }
 
-                while (ret == BZ_OK) {
-                    buffer = static_cast<char*>( realloc(buffer, buffer_size)); // allocate/resize buffer
+#endif
+    delete [] f->data;
+}
 
-                    if (!buffer) {
-                        free(buffer);
-                    }
+#ifdef BZIP_SUPPORT
+void decompressBzip (IMFILE* mf, const char* fname)
+{
+    bool bzip = false;
+    Glib::ustring bname = Glib::path_get_basename(fname);
+    size_t lastdot = bname.find_last_of ('.');
 
-                    stream.next_out = buffer + buffer_out_count; // output data adress
-                    stream.avail_out = buffer_size - buffer_out_count;
+    if (lastdot != bname.npos) {
+        bzip = bname.substr (lastdot).casefold() == Glib::ustring(".bz2").casefold();
+    }
 
-                    ret = BZ2_bzDecompress(&stream);
+    if (!bzip) {
+        return;
+    }
 
-                    buffer_size *= 2; // increase buffer size for next iteration
-                    buffer_out_count = stream.total_out_lo32;
+    int ret;
 
-                    if (stream.total_out_hi32 > 0) {
-                        printf("bzip decompressed data byte count high byte is nonzero: %d\n", stream.total_out_hi32);
-                    }
-                }
+    // initialize bzip stream structure
+    bz_stream stream;
+    stream.bzalloc = nullptr;
+    stream.bzfree = nullptr;
+    stream.opaque = nullptr;
+    ret = BZ2_bzDecompressInit(&stream, 0, 0);
 
-                if (ret == BZ_STREAM_END) {
-                    //delete [] mf->data;
-                    // close memory mapping, setting fd -1 will ensure deletion of mf->data upon fclose()
-                    mf->fd = -1;
-                    munmap((void*)mf->data, mf->size);
-                    close(mf->fd);
+    if (ret != BZ_OK) {
+        printf("bzip initialization failed with error %d\n", ret);
+    } else {
+        // allocate initial buffer for decompressed data
+        unsigned int buffer_out_count = 0; // bytes of decompressed data
+        unsigned int buffer_size = 10 * 1024 * 1024; // 10 MB, extended dynamically if needed
+        char* buffer = nullptr;
 
-                    char* realData = new char [buffer_out_count];
-                    memcpy(realData, buffer, buffer_out_count);
+        stream.next_in = mf->data; // input data address
+        stream.avail_in = mf->size;
 
-                    mf->data = realData;
-                    mf->size = buffer_out_count;
-                } else {
-                    printf("bzip decompression failed with error %d\n", ret);
-                }
+        while (ret == BZ_OK) {
+            buffer = static_cast<char*>( realloc(buffer, buffer_size)); // allocate/resize buffer
 
-                // cleanup
+            if (!buffer) {
                 free(buffer);
-                ret = BZ2_bzDecompressEnd(&stream);
+            }
+
+            stream.next_out = buffer + buffer_out_count; // output data adress
+            stream.avail_out = buffer_size - buffer_out_count;
+
+            ret = BZ2_bzDecompress(&stream);
 
-                if (ret != BZ_OK) {
-                    printf("bzip cleanup failed with error %d\n", ret);
-                }
+            buffer_size *= 2; // increase buffer size for next iteration
+            buffer_out_count = stream.total_out_lo32;
+
+            if (stream.total_out_hi32 > 0) {
+                printf("bzip decompressed data byte count high byte is nonzero: %d\n", stream.total_out_hi32);
             }
         }
-    }
-#endif // BZIP_SUPPORT
 
-    return mf;
+        if (ret == BZ_STREAM_END) {
+            // the compressed data is released (unmapped) here, the decompressed data is deleted by fclose()
+            releaseData(mf);
+
+            char* realData = new char [buffer_out_count];
+            memcpy(realData, buffer, buffer_out_count);
+
+            mf->data = realData;
+            mf->size = buffer_out_count;
+        } else {
+            printf("bzip decompression failed with error %d\n", ret);
+        }
+
+        // cleanup
+        free(buffer);
+        ret = BZ2_bzDecompressEnd(&stream);
+
+        if (ret != BZ_OK) {
+            printf("bzip cleanup failed with error %d\n", ret);
+        }
+    }
 }
+#endif // BZIP_SUPPORT
 
-IMFILE* gfopen (const char* fname)
+void prefetchFile (const Glib::ustring& fname)
 {
-    return fopen(fname);
-}
+#ifdef POSIX_FADV_WILLNEED
+    // starts the readahead of the whole file and returns without waiting for the data
+    const int fd = ::g_open (fname.c_str(), O_RDONLY, 0);
+
+    if (fd >= 0) {
+        posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+        close (fd);
+    }
+
 #else
+    // no readahead hint available, so read the file once to get it into the system cache
+    FILE* f = g_fopen (fname.c_str(), "rb");
 
-IMFILE* fopen (const char* fname)
-{
+    if (f) {
+        std::vector<char> buffer(1 << 20);
 
-    FILE* f = g_fopen (fname, "rb");
+        while (::fread (buffer.data(), 1, buffer.size(), f) == buffer.size()) {
+        }
 
-    if (!f) {
-        return NULL;
+        ::fclose (f);
     }
 
-    IMFILE* mf = new IMFILE;
-    memset(mf, 0, sizeof(*mf));
-    fseek (f, 0, SEEK_END);
-    mf->size = ftell (f);
-    mf->data = new char [mf->size];
-    fseek (f, 0, SEEK_SET);
-    fread (mf->data, 1, mf->size, f);
-    fclose (f);
-    mf->pos = 0;
-    mf->eof = false;
-
-    return mf;
+#endif
 }
 
-IMFILE* gfopen (const char* fname)
+// Reads the files one after the other on a single long-lived thread
+class Prefetcher final
 {
+public:
+    Prefetcher () :
+        thread(nullptr),
+        stopping(false)
+    {
+    }
 
-    FILE* f = g_fopen (fname, "rb");
+    ~Prefetcher ()
+    {
+        if (thread) {
+            {
+                Glib::Threads::Mutex::Lock lock(mutex);
+                pending.clear();
+                stopping = true;
+                queued.signal();
+            }
 
-    if (!f) {
-        return NULL;
+            thread->join();
+        }
     }
 
-    IMFILE* mf = new IMFILE;
-    memset(mf, 0, sizeof(*mf));
-    fseek (f, 0, SEEK_END);
-    mf->size = ftell (f);
-    mf->data = new char [mf->size];
-    fseek (f, 0, SEEK_SET);
-    fread (mf->data, 1, mf->size, f);
-    fclose (f);
-    mf->pos = 0;
-    mf->eof = false;
-
-#ifdef BZIP_SUPPORT
+    // The files not read yet are replaced, the latest request lists the files needed next
+    void prefetch (const std::vector<Glib::ustring>& fnames)
     {
-        bool bzip = false;
-        Glib::ustring bname = Glib::path_get_basename(fname);
-        size_t lastdot = bname.find_last_of ('.');
+        Glib::Threads::Mutex::Lock lock(mutex);
+        pending.assign(fnames.begin(), fnames.end());
 
-        if (lastdot != bname.npos) {
-            bzip = bname.substr (lastdot).casefold() == Glib::ustring(".bz2").casefold();
+        if (!thread) {
+            thread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &Prefetcher::work));
         }
 
-        if (bzip) {
-            int ret;
+        queued.signal();
+    }
 
-            // initialize bzip stream structure
-            bz_stream stream;
-            stream.bzalloc = 0;
-            stream.bzfree = 0;
-            stream.opaque = 0;
-            ret = BZ2_bzDecompressInit(&stream, 0, 0);
+private:
+    void work ()
+    {
+        Glib::Threads::Mutex::Lock lock(mutex);
 
-            if (ret != BZ_OK) {
-                printf("bzip initialization failed with error %d\n", ret);
-            } else {
-                // allocate initial buffer for decompressed data
-                unsigned int buffer_out_count = 0; // bytes of decompressed data
-                unsigned int buffer_size = 10 * 1024 * 1024; // 10 MB, extended dynamically if needed
-                char* buffer = 0;
+        while (!stopping) {
+            if (pending.empty()) {
+                queued.wait(mutex);
+                continue;
+            }
 
-                stream.next_in = mf->data; // input data address
-                stream.avail_in = mf->size;
+            const Glib::ustring fname = pending.front();
+            pending.pop_front();
 
-                while (ret == BZ_OK) {
-                    buffer = static_cast<char*>( realloc(buffer, buffer_size)); // allocate/resize buffer
+            lock.release();
+            prefetchFile(fname);
+            lock.acquire();
+        }
+    }
 
-                    if (!buffer) {
-                        free(buffer);
-                    }
+    Glib::Threads::Thread* thread;
+    // Glib::Threads::Mutex rather than MyMutex, because it is used with Glib::Threads::Cond
+    Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond queued;
+    std::deque<Glib::ustring> pending;
+    bool stopping;
+};
 
-                    stream.next_out = buffer + buffer_out_count; // output data adress
-                    stream.avail_out = buffer_size - buffer_out_count;
+}
 
-                    ret = BZ2_bzDecompress(&stream);
+IMFILE* fopen (const char* fname)
+{
+    IMFILE* mf = nullptr;
 
-                    buffer_size *= 2; // increase buffer size for next iteration
-                    buffer_out_count = stream.total_out_lo32;
+#ifdef MYFILE_MMAP
 
-                    if (stream.total_out_hi32 > 0) {
-                        printf("bzip decompressed data byte count high byte is nonzero: %d\n", stream.total_out_hi32);
-                    }
-                }
+    if (!rtengine::settings || rtengine::settings->mmapInput) {
+        mf = mapFile (fname);
+
+        if (!mf && rtengine::settings && rtengine::settings->verbose) {
+            printf ("%s is not memory mapped, reading it\n", fname);
+        }
+    }
 
-                if (ret == BZ_STREAM_END) {
-                    delete [] mf->data;
-                    char* realData = new char [buffer_out_count];
-                    memcpy(realData, buffer, buffer_out_count);
+#endif
 
-                    mf->data = realData;
-                    mf->size = buffer_out_count;
-                } else {
-                    printf("bzip decompression failed with error %d\n", ret);
-                }
+    if (!mf) {
+        mf = readFile (fname);
+    }
 
-                // cleanup
-                free(buffer);
-                ret = BZ2_bzDecompressEnd(&stream);
+#ifdef BZIP_SUPPORT
 
-                if (ret != BZ_OK) {
-                    printf("bzip cleanup failed with error %d\n", ret);
-                }
-            }
-        }
+    if (mf) {
+        decompressBzip (mf, fname);
     }
-#endif // BZIP_SUPPORT
+
+#endif
+
     return mf;
 }
-#endif //MYFILE_MMAP
+
+IMFILE* gfopen (const char* fname)
+{
+    return fopen(fname);
+}
 
 IMFILE* fopen (unsigned* buf, int size)
 {
@@ -340,19 +458,31 @@ IMFILE* fopen (unsigned* buf, int size)
 
 void fclose (IMFILE* f)
 {
-#ifdef MYFILE_MMAP
+    releaseData(f);
+    delete f;
+}
 
-    if ( f->fd == -1 ) {
-        delete [] f->data;
-    } else {
-        munmap((void*)f->data, f->size);
-        close(f->fd);
+void imfile_advise_sequential (IMFILE* f, ssize_t offset)
+{
+#if defined(MYFILE_MMAP) && !defined(WIN32)
+
+    if (f->fd != -1 && offset >= 0 && offset < f->size) {
+        const ssize_t pageSize = sysconf(_SC_PAGESIZE);
+        const ssize_t start = offset - offset % pageSize;
+        posix_madvise(f->data + start, f->size - start, POSIX_MADV_SEQUENTIAL);
+        posix_madvise(f->data + start, f->size - start, POSIX_MADV_WILLNEED);
     }
 
-#else
-    delete [] f->data;
 #endif
-    delete f;
+}
+
+void rtengine::prefetchFiles (const std::vector<Glib::ustring>& fnames)
+{
+    static Prefetcher prefetcher;
+
+    if (!fnames.empty()) {
+        prefetcher.prefetch(fnames);
+    }
 }
 
 int fscanf (IMFILE* f, const char* s ...)
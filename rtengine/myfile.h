@@ -43,6 +43,12 @@ struct IMFILE {
 void imfile_set_plistener(IMFILE *f, rtengine::ProgressListener *plistener, double progress_range);
 void imfile_update_progress(IMFILE *f);
 
+/*
+  Tells the system that the data from offset to the end of the file is going to be read soon, in order,
+  so that it is read ahead while the caller decodes. Only has an effect on memory mapped files.
+ */
+void imfile_advise_sequential(IMFILE *f, ssize_t offset);
+
 IMFILE* fopen (const char* fname);
 IMFILE* gfopen (const char* fname);
 IMFILE* fopen (unsigned* buf, int size);
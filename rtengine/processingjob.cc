@@ -39,5 +39,19 @@ void ProcessingJob::destroy (ProcessingJob* job)
     delete static_cast<ProcessingJobImpl*>(job);
 }
 
+bool loadProcessingJobImage (ProcessingJob* pjob, int& errorCode)
+{
+    ProcessingJobImpl* job = static_cast<ProcessingJobImpl*>(pjob);
+
+    errorCode = 0;
+
+    if (!job->initialImage) {
+        // the reference of the loaded image is the one released by the job
+        job->initialImage = InitialImage::load (job->fname, job->isRaw, &errorCode);
+    }
+
+    return job->initialImage != nullptr;
+}
+
 }
 
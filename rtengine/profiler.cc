@@ -0,0 +1,213 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+#include <glib/gstdio.h>
+
+#include "profiler.h"
+
+namespace
+{
+
+std::string escape(const std::string& str)
+{
+    std::string res;
+    res.reserve(str.size());
+
+    for (const char c : str) {
+        switch (c) {
+            case '"':
+                res += "\\\"";
+                break;
+
+            case '\\':
+                res += "\\\\";
+                break;
+
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    res += buf;
+                } else {
+                    res += c;
+                }
+        }
+    }
+
+    return res;
+}
+
+struct Total {
+    unsigned long calls = 0;
+    std::int64_t duration = 0;
+};
+
+}
+
+std::atomic<bool> rtengine::Profiler::enabled(false);
+thread_local rtengine::Profiler::ThreadBuffer* rtengine::Profiler::threadBuffer = nullptr;
+thread_local int rtengine::Profiler::threadDepth = 0;
+
+rtengine::Profiler& rtengine::Profiler::getInstance()
+{
+    static Profiler instance;
+    return instance;
+}
+
+void rtengine::Profiler::enable(const Glib::ustring& outputFile)
+{
+    MyMutex::MyLock lock(mutex);
+
+    this->outputFile = outputFile;
+    origin = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    enabled = true;
+}
+
+bool rtengine::Profiler::write()
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    MyMutex::MyLock lock(mutex);
+
+    FILE* const f = g_fopen(outputFile.c_str(), "wb");
+
+    if (!f) {
+        fprintf(stderr, "Profiler: could not write \"%s\"\n", outputFile.c_str());
+        return false;
+    }
+
+    std::map<std::string, Total> totals;
+    std::map<std::string, std::map<unsigned int, Total>> threadTotals;
+    bool first = true;
+
+    fprintf(f, "{\"traceEvents\":[");
+
+    for (const auto& buffer : threadBuffers) {
+        std::vector<Event> events;
+
+        {
+            MyMutex::MyLock bufferLock(buffer->mutex);
+            events = buffer->events;
+        }
+
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}", first ? "" : ",", buffer->id, buffer->id);
+        first = false;
+
+        // Parents start no later than their children, so after sorting the
+        // call path of an event is the path of the last event one level up
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.start < b.start || (a.start == b.start && a.depth < b.depth);
+        });
+
+        std::vector<std::string> paths;
+
+        for (const auto& event : events) {
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"rtengine\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld",
+                    escape(event.name).c_str(), buffer->id, static_cast<long long>(event.start), static_cast<long long>(event.duration));
+
+            if (!event.detail.empty()) {
+                fprintf(f, ",\"args\":{\"detail\":\"%s\"}", escape(event.detail).c_str());
+            }
+
+            fprintf(f, "}");
+
+            paths.resize(event.depth + 1);
+            paths[event.depth] = event.depth > 0 ? paths[event.depth - 1] + '/' + event.name : std::string(event.name);
+
+            Total& total = totals[paths[event.depth]];
+            ++total.calls;
+            total.duration += event.duration;
+
+            Total& threadTotal = threadTotals[paths[event.depth]][buffer->id];
+            ++threadTotal.calls;
+            threadTotal.duration += event.duration;
+        }
+    }
+
+    fprintf(f, "\n],\n\"displayTimeUnit\":\"ms\",\n\"summary\":[");
+
+    first = true;
+
+    for (const auto& total : totals) {
+        fprintf(f, "%s\n{\"path\":\"%s\",\"calls\":%lu,\"total_us\":%lld,\"threads\":[",
+                first ? "" : ",", escape(total.first).c_str(), total.second.calls, static_cast<long long>(total.second.duration));
+        first = false;
+
+        bool firstThread = true;
+
+        for (const auto& threadTotal : threadTotals[total.first]) {
+            fprintf(f, "%s{\"tid\":%u,\"calls\":%lu,\"total_us\":%lld}",
+                    firstThread ? "" : ",", threadTotal.first, threadTotal.second.calls, static_cast<long long>(threadTotal.second.duration));
+            firstThread = false;
+        }
+
+        fprintf(f, "]}");
+    }
+
+    fprintf(f, "\n]}\n");
+
+    return fclose(f) == 0;
+}
+
+rtengine::Profiler::Profiler() :
+    origin(0)
+{
+}
+
+std::int64_t rtengine::Profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - origin;
+}
+
+rtengine::Profiler::ThreadBuffer& rtengine::Profiler::getThreadBuffer()
+{
+    if (!threadBuffer) {
+        MyMutex::MyLock lock(mutex);
+        threadBuffers.emplace_back(new ThreadBuffer);
+        threadBuffer = threadBuffers.back().get();
+        threadBuffer->id = threadBuffers.size() - 1;
+    }
+
+    return *threadBuffer;
+}
+
+void rtengine::Profiler::record(const char* name, std::string&& detail, std::int64_t start, int depth)
+{
+    const std::int64_t end = now();
+    ThreadBuffer& buffer = getThreadBuffer();
+
+    MyMutex::MyLock lock(buffer.mutex);
+    buffer.events.push_back({name, std::move(detail), start, end - start, depth});
+}
+
+void rtengine::ProfileScope::begin()
+{
+    depth = Profiler::threadDepth++;
+    start = Profiler::getInstance().now();
+}
+
+void rtengine::ProfileScope::end()
+{
+    --Profiler::threadDepth;
+    Profiler::getInstance().record(name, std::move(detail), start, depth);
+}
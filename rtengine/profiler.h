@@ -0,0 +1,142 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glibmm.h>
+
+#include "noncopyable.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/**
+ * Hierarchical profiler for the processing stages.
+ *
+ * The instrumentation is always compiled in. While the profiler is disabled
+ * a scope costs one relaxed atomic load. Once enabled (RT_PROFILE environment
+ * variable, or --profile for rawtherapee-cli), every ProfileScope records its
+ * start and duration in a buffer owned by the calling thread, together with
+ * its nesting depth. write() emits a Chrome trace file (open it in
+ * chrome://tracing or Perfetto) whose "summary" member holds the totals per
+ * call path, overall and per thread.
+ */
+class Profiler final :
+    public NonCopyable
+{
+public:
+    static Profiler& getInstance();
+
+    static bool isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /** Starts recording. The trace is written to outputFile by write(). */
+    void enable(const Glib::ustring& outputFile);
+
+    /** Writes the recorded trace. Must be called once the processing threads are idle.
+      * @return false if the profiler is disabled or the file could not be written */
+    bool write();
+
+private:
+    friend class ProfileScope;
+
+    struct Event {
+        const char* name;
+        std::string detail;
+        std::int64_t start; // us since enable()
+        std::int64_t duration; // us
+        int depth;
+    };
+
+    struct ThreadBuffer {
+        MyMutex mutex;
+        unsigned int id;
+        std::vector<Event> events;
+    };
+
+    Profiler();
+
+    std::int64_t now() const;
+    ThreadBuffer& getThreadBuffer();
+    void record(const char* name, std::string&& detail, std::int64_t start, int depth);
+
+    static std::atomic<bool> enabled;
+    static thread_local ThreadBuffer* threadBuffer;
+    static thread_local int threadDepth;
+
+    MyMutex mutex;
+    Glib::ustring outputFile;
+    std::int64_t origin;
+    std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+};
+
+/**
+ * Records the time spent in the enclosing scope. name must outlive the
+ * profiler, e.g. a string literal or __func__. detail is written to the
+ * "args" of the trace event (file name, camera, ...).
+ */
+class ProfileScope final :
+    public NonCopyable
+{
+public:
+    explicit ProfileScope(const char* name) :
+        name(Profiler::isEnabled() ? name : nullptr)
+    {
+        if (this->name) {
+            begin();
+        }
+    }
+
+    ProfileScope(const char* name, const std::string& detail) :
+        name(Profiler::isEnabled() ? name : nullptr)
+    {
+        if (this->name) {
+            this->detail = detail;
+            begin();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (name) {
+            end();
+        }
+    }
+
+private:
+    void begin();
+    void end();
+
+    const char* name;
+    std::string detail;
+    std::int64_t start;
+    int depth;
+};
+
+}
+
+#define RT_PROFILE_CONCAT_(a, b) a##b
+#define RT_PROFILE_CONCAT(a, b) RT_PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(...) rtengine::ProfileScope RT_PROFILE_CONCAT(profileScope, __LINE__)(__VA_ARGS__)
@@ -496,6 +496,7 @@ int RawImage::loadRaw (bool loadData, unsigned int imageNum, bool closeFile, Pro
         */
         // Load raw pixels data
         fseek (ifp, data_offset, SEEK_SET);
+        imfile_advise_sequential (ifp, data_offset);
         (this->*load_raw)();
 
         if (plistener) {
@@ -31,6 +31,7 @@
 #include "dfmanager.h"
 #include "ffmanager.h"
 #include "dcp.h"
+#include "demosaiccache.h"
 #include "rt_math.h"
 #include "improcfun.h"
 #ifdef _OPENMP
@@ -1724,7 +1725,7 @@ int RawImageSource::load (const Glib::ustring &fname, int imageNum, bool batch)
 
 void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &lensProf, const CoarseTransformParams& coarse, bool prepareDenoise)
 {
-//    BENCHFUN
+    BENCHFUN
     MyTime t1, t2;
     t1.set();
 
@@ -1784,6 +1785,11 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         printf( "Flat Field Correction:%s\n", rif->get_filename().c_str());
     }
 
+    preprocDarkFrame = rid ? rid->get_filename() : Glib::ustring();
+    preprocFlatField = rif ? rif->get_filename() : Glib::ustring();
+    preprocLensProf = lensProf;
+    preprocCoarse = coarse;
+
     if(numFrames == 4) {
         int bufferNumber = 0;
         for(unsigned int i=0; i<4; ++i) {
@@ -2035,11 +2041,38 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
 }
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
-void RawImageSource::demosaic(const RAWParams &raw)
+void RawImageSource::demosaic(const RAWParams &raw, bool binned)
 {
+    PROFILE_SCOPE("demosaic", binned ? "binned" : getSensorType() == ST_FUJI_XTRANS ? raw.xtranssensor.method : raw.bayersensor.method);
     MyTime t1, t2;
     t1.set();
 
+    // not cached, as it is about as fast as reading the planes back
+    if (binned && binned_demosaic()) {
+        rgbSourceModified = false;
+
+        if (settings->verbose) {
+            t2.set();
+            printf("Demosaicing %s data: binned - %d usec\n", getSensorType() == ST_FUJI_XTRANS ? "X-Trans" : "Bayer", t2.etime(t1));
+        }
+
+        return;
+    }
+
+    DemosaicCache& demosaicCache = DemosaicCache::getInstance();
+    const std::string demosaicCacheKey = demosaicCache.isEnabled() ? DemosaicCache::getKey(ri->get_filename(), currFrame, raw, preprocLensProf, preprocCoarse, preprocDarkFrame, preprocFlatField) : std::string();
+
+    if (demosaicCache.load(demosaicCacheKey, W, H, red, green, blue)) {
+        rgbSourceModified = false;
+
+        if (settings->verbose) {
+            t2.set();
+            printf("Demosaiced data loaded from cache - %d usec\n", t2.etime(t1));
+        }
+
+        return;
+    }
+
     if (ri->getSensorType() == ST_BAYER) {
         if ( raw.bayersensor.method == RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::hphd] ) {
             hphd_demosaic ();
@@ -2088,6 +2121,8 @@ void RawImageSource::demosaic(const RAWParams &raw)
 
     t2.set();
 
+    demosaicCache.store(demosaicCacheKey, W, H, red, green, blue);
+
 
     rgbSourceModified = false;
 
@@ -2811,7 +2846,7 @@ void RawImageSource::HLRecovery_Global(ToneCurveParams hrp)
 
 void RawImageSource::processFlatField(const RAWParams &raw, RawImage *riFlatFile, unsigned short black[4])
 {
-//    BENCHFUN
+    BENCHFUN
     float *cfablur = (float (*)) malloc (H * W * sizeof * cfablur);
     int BS = raw.ff_BlurRadius;
     BS += BS & 1;
@@ -4554,7 +4589,7 @@ void RawImageSource::hlRecovery (const std::string &method, float* red, float* g
 
 void RawImageSource::getAutoExpHistogram (LUTu & histogram, int& histcompr)
 {
-//    BENCHFUN
+    BENCHFUN
     histcompr = 3;
 
     histogram(65536 >> histcompr);
@@ -4636,7 +4671,7 @@ void RawImageSource::getAutoExpHistogram (LUTu & histogram, int& histcompr)
 // Histogram MUST be 256 in size; gamma is applied, blackpoint and gain also
 void RawImageSource::getRAWHistogram (LUTu & histRedRaw, LUTu & histGreenRaw, LUTu & histBlueRaw)
 {
-//    BENCHFUN
+    BENCHFUN
     histRedRaw.clear();
     histGreenRaw.clear();
     histBlueRaw.clear();
@@ -4800,7 +4835,7 @@ void RawImageSource::getRowStartEnd (int x, int &start, int &end)
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 void RawImageSource::getAutoWBMultipliers (double &rm, double &gm, double &bm)
 {
-//    BENCHFUN
+    BENCHFUN
     constexpr double clipHigh = 64000.0;
 
     if (ri->get_colors() == 1) {
@@ -0,0 +1,267 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <random>
+#include <vector>
+
+#if defined(__SSSE3__) || defined(__SSE4_1__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "rawunpack.h"
+
+namespace
+{
+
+// 8 values of bits bits take exactly bits bytes. The scalar kernels decode
+// them as two groups of 4 values, each one read as a big endian 64 bit word.
+template<int bits>
+void unpackScalar(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count, int col = 0, std::size_t pos = 0)
+{
+    constexpr std::size_t groupBytes = bits / 2;
+    constexpr std::uint64_t mask = (1 << bits) - 1;
+
+    for (; col + 4 <= count && pos + 8 <= srcSize; col += 4, pos += groupBytes) {
+        std::uint64_t v = 0;
+
+        for (int i = 0; i < 8; ++i) {
+            v = v << 8 | src[pos + i];
+        }
+
+        dst[col]     = v >> (64 - bits) & mask;
+        dst[col + 1] = v >> (64 - 2 * bits) & mask;
+        dst[col + 2] = v >> (64 - 3 * bits) & mask;
+        dst[col + 3] = v >> (64 - 4 * bits) & mask;
+    }
+
+    // groups start at byte boundaries, so the reference can take over here
+    rtengine::unpackPackedRowReference(src + pos, pos < srcSize ? srcSize - pos : 0, dst + col, count - col, bits, 1);
+}
+
+#ifdef __SSSE3__
+// 10, 12 and 16 bits: each value is taken from a 16 bit lane holding the two bytes it
+// spans, shifted to the top of the lane by a multiplication and back down by a shift
+template<int bits>
+struct Lanes16;
+
+template<>
+struct Lanes16<10> {
+    static __m128i shuffle() { return _mm_setr_epi8(1, 0, 2, 1, 3, 2, 4, 3, 6, 5, 7, 6, 8, 7, 9, 8); }
+    static __m128i factors() { return _mm_setr_epi16(1, 4, 16, 64, 1, 4, 16, 64); }
+    static constexpr int shift = 6;
+};
+
+template<>
+struct Lanes16<12> {
+    static __m128i shuffle() { return _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10); }
+    static __m128i factors() { return _mm_setr_epi16(1, 16, 1, 16, 1, 16, 1, 16); }
+    static constexpr int shift = 4;
+};
+
+template<>
+struct Lanes16<16> {
+    static __m128i shuffle() { return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14); }
+    static __m128i factors() { return _mm_set1_epi16(1); }
+    static constexpr int shift = 0;
+};
+
+#ifdef __AVX2__
+template<int bits>
+void unpackLanes16(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count)
+{
+    const __m256i shuffle = _mm256_broadcastsi128_si256(Lanes16<bits>::shuffle());
+    const __m256i factors = _mm256_broadcastsi128_si256(Lanes16<bits>::factors());
+    int col = 0;
+    std::size_t pos = 0;
+
+    for (; col + 16 <= count && pos + bits + 16 <= srcSize; col += 16, pos += 2 * bits) {
+        const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos))),
+                                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + bits)), 1);
+        const __m256i v = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_shuffle_epi8(in, shuffle), factors), Lanes16<bits>::shift);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + col), v);
+    }
+
+    unpackScalar<bits>(src, srcSize, dst, count, col, pos);
+}
+#else
+template<int bits>
+void unpackLanes16(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count)
+{
+    const __m128i shuffle = Lanes16<bits>::shuffle();
+    const __m128i factors = Lanes16<bits>::factors();
+    int col = 0;
+    std::size_t pos = 0;
+
+    for (; col + 8 <= count && pos + 16 <= srcSize; col += 8, pos += bits) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+        const __m128i v = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(in, shuffle), factors), Lanes16<bits>::shift);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col), v);
+    }
+
+    unpackScalar<bits>(src, srcSize, dst, count, col, pos);
+}
+#endif
+#endif
+
+#ifdef __SSE4_1__
+// 14 bits: a value can span three bytes, so 32 bit lanes are used and packed afterwards.
+// shuffleA gathers the first 4 values of 7 bytes, shuffleB the next 4.
+inline __m128i shuffle14A() { return _mm_setr_epi8(3, 2, 1, 0, 4, 3, 2, 1, 6, 5, 4, 3, 8, 7, 6, 5); }
+inline __m128i shuffle14B() { return _mm_setr_epi8(10, 9, 8, 7, 11, 10, 9, 8, 13, 12, 11, 10, 15, 14, 13, 12); }
+inline __m128i factors14() { return _mm_setr_epi32(1, 64, 16, 4); }
+
+#ifdef __AVX2__
+void unpack14(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count)
+{
+    const __m256i shuffleA = _mm256_broadcastsi128_si256(shuffle14A());
+    const __m256i shuffleB = _mm256_broadcastsi128_si256(shuffle14B());
+    const __m256i factors = _mm256_broadcastsi128_si256(factors14());
+    int col = 0;
+    std::size_t pos = 0;
+
+    for (; col + 16 <= count && pos + 14 + 16 <= srcSize; col += 16, pos += 28) {
+        const __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos))),
+                                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + 14)), 1);
+        const __m256i a = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_shuffle_epi8(in, shuffleA), factors), 18);
+        const __m256i b = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_shuffle_epi8(in, shuffleB), factors), 18);
+        // packing is done per 128 bit lane, which keeps the values in order here
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + col), _mm256_packus_epi32(a, b));
+    }
+
+    unpackScalar<14>(src, srcSize, dst, count, col, pos);
+}
+#else
+void unpack14(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count)
+{
+    const __m128i shuffleA = shuffle14A();
+    const __m128i shuffleB = shuffle14B();
+    const __m128i factors = factors14();
+    int col = 0;
+    std::size_t pos = 0;
+
+    for (; col + 8 <= count && pos + 16 <= srcSize; col += 8, pos += 14) {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+        const __m128i a = _mm_srli_epi32(_mm_mullo_epi32(_mm_shuffle_epi8(in, shuffleA), factors), 18);
+        const __m128i b = _mm_srli_epi32(_mm_mullo_epi32(_mm_shuffle_epi8(in, shuffleB), factors), 18);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col), _mm_packus_epi32(a, b));
+    }
+
+    unpackScalar<14>(src, srcSize, dst, count, col, pos);
+}
+#endif
+#endif
+
+}
+
+void rtengine::unpackPackedRowReference(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count, int bits, int wordBytes)
+{
+    // same steps as the bit reader of DCraw::packed_load_raw()
+    const int bite = wordBytes * 8;
+    std::uint64_t bitbuf = 0;
+    int vbits = 0;
+    std::size_t pos = 0;
+
+    for (int col = 0; col < count; ++col) {
+        for (vbits -= bits; vbits < 0; vbits += bite) {
+            bitbuf <<= bite;
+
+            for (int i = 0; i < bite; i += 8, ++pos) {
+                bitbuf |= static_cast<std::uint64_t>(pos < srcSize ? src[pos] : 0) << i;
+            }
+        }
+
+        dst[col] = bitbuf << (64 - bits - vbits) >> (64 - bits);
+    }
+}
+
+rtengine::PackedRowUnpacker rtengine::getPackedRowUnpacker(int bits, int wordBytes)
+{
+    if (wordBytes != 1) {
+        return nullptr;
+    }
+
+    switch (bits) {
+#ifdef __SSSE3__
+
+        case 10:
+            return unpackLanes16<10>;
+
+        case 12:
+            return unpackLanes16<12>;
+
+        case 16:
+            return unpackLanes16<16>;
+#else
+
+        case 10:
+            return [](const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count) {
+                unpackScalar<10>(src, srcSize, dst, count);
+            };
+
+        case 12:
+            return [](const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count) {
+                unpackScalar<12>(src, srcSize, dst, count);
+            };
+
+        case 16:
+            return [](const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count) {
+                unpackScalar<16>(src, srcSize, dst, count);
+            };
+#endif
+
+        case 14:
+#ifdef __SSE4_1__
+            return unpack14;
+#else
+            return [](const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count) {
+                unpackScalar<14>(src, srcSize, dst, count);
+            };
+#endif
+
+        default:
+            return nullptr;
+    }
+}
+
+bool rtengine::checkPackedRowUnpackers()
+{
+    std::mt19937 rng(42);
+    bool ok = true;
+
+    for (const int bits : {10, 12, 14, 16}) {
+        const PackedRowUnpacker unpack = getPackedRowUnpacker(bits, 1);
+
+        // odd lengths and rows with missing bytes exercise the tails
+        for (const int count : {1, 7, 33, 1001, 6034}) {
+            for (const std::size_t missing : {std::size_t(0), std::size_t(5)}) {
+                const std::size_t size = (static_cast<std::size_t>(count) * bits + 7) / 8;
+                const std::size_t srcSize = size > missing ? size - missing : 0;
+                std::vector<std::uint8_t> src(size);
+
+                for (auto& byte : src) {
+                    byte = rng();
+                }
+
+                std::vector<std::uint16_t> expected(count), actual(count);
+                unpackPackedRowReference(src.data(), srcSize, expected.data(), count, bits, 1);
+                unpack(src.data(), srcSize, actual.data(), count);
+                ok = ok && expected == actual;
+            }
+        }
+    }
+
+    return ok;
+}
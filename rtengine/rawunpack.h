@@ -0,0 +1,49 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rtengine
+{
+
+/**
+ * Kernels unpacking one row of raw values of a fixed bit depth, as stored in
+ * the files read by DCraw::packed_load_raw(): the bit stream is a sequence of
+ * little endian words of wordBytes (1, 2 or 4) bytes, and the values are
+ * taken from the most significant bits of the words first.
+ *
+ * A kernel reads at most srcSize bytes from src and writes count values to
+ * dst. The row has to start at a word boundary.
+ */
+using PackedRowUnpacker = void (*)(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count);
+
+/** Bit by bit implementation for any bits (1 to 16) and wordBytes. It is the
+  * reference the kernels are validated against, and handles the layouts without a kernel.
+  * Missing input bytes are read as 0. */
+void unpackPackedRowReference(const std::uint8_t* src, std::size_t srcSize, std::uint16_t* dst, int count, int bits, int wordBytes);
+
+/** Returns the fastest kernel compiled in for the layout (AVX2, SSE4.1/SSSE3 or
+  * scalar, for 10, 12, 14 and 16 bits in single bytes), or nullptr if there is none */
+PackedRowUnpacker getPackedRowUnpacker(int bits, int wordBytes);
+
+/** Compares the kernel of each supported layout with the reference on random rows.
+  * @return true if all kernels give the same values */
+bool checkPackedRowUnpackers();
+
+}
@@ -24,6 +24,7 @@
 #include "procevents.h"
 #include <lcms2.h>
 #include <string>
+#include <vector>
 #include <glibmm.h>
 #include <ctime>
 #include "../rtexif/rtexif.h"
@@ -395,6 +396,10 @@ public:
     /** Returns the scale of the preview image.
       * @return the current scale of the preview image */
     virtual int         getPreviewScale () = 0;
+    /** Returns the size of the CFA cells that were binned instead of demosaiced for the current preview.
+      * Detail crops showing more than every n-th pixel need a full demosaic first.
+      * @return 2 (Bayer) or 3 (X-Trans) if the raw data is binned, 1 otherwise */
+    virtual int         getBinnedCell () = 0;
     /** Returns the full width of the resulting image (in 1:1 scale).
       * @return the width of the final image */
     virtual int         getFullWidth () = 0;
@@ -507,6 +512,24 @@ public:
    * @return the resulting image, with the output profile applied, exif and iptc data set. You have to save it or you can access the pixel data directly.  */
 IImage16* processImage (ProcessingJob* job, int& errorCode, ProgressListener* pl = nullptr, bool tunnelMetaData = false, bool flush = false);
 
+/** Same as processImage, but the resulting image has floating point samples, in [0;65535] and not clipped by the output profile: it is not
+   * quantized to 16 bits, for the output of floating point TIFF files (see IImage::saveAsTIFF). */
+IImagefloat* processImageFloat (ProcessingJob* job, int& errorCode, ProgressListener* pl = nullptr, bool tunnelMetaData = false, bool flush = false);
+
+/** Loads the image of a ProcessingJob created from a file name, so that it can be decoded ahead while other jobs are processed. The image is
+   * released with the job, by processImage or ProcessingJob::destroy. Jobs holding an image already are left unchanged.
+   * @param job the ProcessingJob to load the image of
+   * @param errorCode is set to nonzero if the image could not be loaded
+   * @return true if the job holds a loaded image */
+bool loadProcessingJobImage (ProcessingJob* job, int& errorCode);
+
+/** Returns a conservative estimate of the peak amount of memory (in bytes) needed to process the given ProcessingJob, including the
+   * data held by its already loaded initial image. The estimate is based on the full image size and on the tools enabled in the job's
+   * procparams. It can be used to decide how many jobs can be processed concurrently.
+   * @param job the ProcessingJob to examine. It must have been created from an InitialImage, otherwise 0 is returned.
+   * @return the estimated peak memory footprint of the job, in bytes */
+std::size_t estimateProcessingMemory (const ProcessingJob* job);
+
 /** This class is used to control the batch processing. The class implementing this interface will be called when the full processing of an
    * image is ready and the next job to process is needed. */
 class BatchProcessingListener : public ProgressListener
@@ -528,6 +551,11 @@ public:
    * @param tunnelMetaData tunnels IPTC and XMP to output without change */
 void startBatchProcessing (ProcessingJob* job, BatchProcessingListener* bpl, bool tunnelMetaData);
 
+/** Starts reading the given files into the system cache in the background and returns immediately, so that
+   * loading them later does not wait for the disk. Used to read the next files of a batch while the current one is processed.
+   * @param fnames the names of the files to read ahead */
+void prefetchFiles (const std::vector<Glib::ustring>& fnames);
+
 
 extern MyMutex* lcmsMutex;
 }
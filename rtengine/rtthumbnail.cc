@@ -36,6 +36,7 @@
 #include "jpeg.h"
 #include "../rtgui/ppversion.h"
 #include "improccoordinator.h"
+#include "taskscheduler.h"
 #include <locale.h>
 
 
@@ -137,7 +138,9 @@ Thumbnail* Thumbnail::loadFromImage (const Glib::ustring& fname, int &w, int &h,
 
     StdImageSource imgSrc;
 
-    if (imgSrc.load(fname)) {
+    // a JPEG file is decoded at a fraction of its size if both sides stay larger than the
+    // fixed side of the thumbnail, so that the image can still be rotated afterwards
+    if (imgSrc.loadReduced(fname, inspectorMode ? 0 : (fixwh == 1 ? h : w))) {
         return nullptr;
     }
 
@@ -168,12 +171,13 @@ Thumbnail* Thumbnail::loadFromImage (const Glib::ustring& fname, int &w, int &h,
         h = img->getHeight();
         tpp->scale = 1.;
     } else {
+        // relative to the size of the image in the file
         if (fixwh == 1) {
             w = h * img->getWidth() / img->getHeight();
-            tpp->scale = (double)img->getHeight() / h;
+            tpp->scale = (double)img->getHeight() * img->getLoadedScale() / h;
         } else {
             h = w * img->getHeight() / img->getWidth();
-            tpp->scale = (double)img->getWidth() / w;
+            tpp->scale = (double)img->getWidth() * img->getLoadedScale() / w;
         }
     }
 
@@ -267,7 +271,7 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
         const char* data((const char*)fdata(ri->get_thumbOffset(), ri->get_file()));
 
         if ( (unsigned char)data[1] == 0xd8 ) {
-            err = img->loadJPEGFromMemory(data, ri->get_thumbLength());
+            err = img->loadJPEGFromMemory(data, ri->get_thumbLength(), inspectorMode ? 0 : (fixwh == 1 ? h : w));
         } else if (ri->is_ppmThumb()) {
             err = img->loadPPMFromMemory(data, ri->get_thumbWidth(), ri->get_thumbHeight(), ri->get_thumbSwap(), ri->get_thumbBPS());
         }
@@ -295,12 +299,13 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
         h = img->getHeight();
         tpp->scale = 1.;
     } else {
+        // relative to the size of the image in the file
         if (fixwh == 1) {
             w = h * img->getWidth() / img->getHeight();
-            tpp->scale = (double)img->getHeight() / h;
+            tpp->scale = (double)img->getHeight() * img->getLoadedScale() / h;
         } else {
             h = w * img->getHeight() / img->getWidth();
-            tpp->scale = (double)img->getWidth() / w;
+            tpp->scale = (double)img->getWidth() * img->getLoadedScale() / w;
         }
     }
 
@@ -1188,6 +1193,8 @@ IImage8* Thumbnail::processImage (const procparams::ProcParams& params, int rhei
         }
     }
 
+    TaskScheduler::checkpoint();
+
     LUTu histToneCurve;
     ipf.rgbProc (baseImg, labView, nullptr, curve1, curve2, curve, shmap, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit , satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve);
 
@@ -1227,6 +1234,8 @@ IImage8* Thumbnail::processImage (const procparams::ProcParams& params, int rhei
     CurveFactory::complexsgnCurve (autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
                                    params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 16);
 
+    TaskScheduler::checkpoint();
+
     ipf.chromiLuminanceCurve (nullptr, 1, labView, labView, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
 
     ipf.vibrance(labView);
@@ -1288,6 +1297,8 @@ IImage8* Thumbnail::processImage (const procparams::ProcParams& params, int rhei
         delete cieView;
     }
 
+    TaskScheduler::checkpoint();
+
     // color processing
     //ipf.colorCurve (labView, labView);
 
@@ -1723,45 +1734,35 @@ unsigned char* Thumbnail::getGrayscaleHistEQ (int trim_width)
     return tmpdata;
 }
 
-bool Thumbnail::writeImage (const Glib::ustring& fname, int format)
+bool Thumbnail::writeImage (std::string& data)
 {
 
     if (!thumbImg) {
         return false;
     }
 
-    Glib::ustring fullFName = fname + ".rtti";
-
-    FILE* f = g_fopen (fullFName.c_str (), "wb");
-
-    if (!f) {
-        return false;
-    }
-
-    fwrite (thumbImg->getType(), sizeof (char), strlen(thumbImg->getType()), f);
-    fputc ('\n', f);
+    data = thumbImg->getType();
+    data += '\n';
     guint32 w = guint32(thumbImg->getWidth());
     guint32 h = guint32(thumbImg->getHeight());
-    fwrite (&w, sizeof (guint32), 1, f);
-    fwrite (&h, sizeof (guint32), 1, f);
+    data.append (reinterpret_cast<const char*>(&w), sizeof (guint32));
+    data.append (reinterpret_cast<const char*>(&h), sizeof (guint32));
 
     if (thumbImg->getType() == sImage8) {
         Image8 *image = static_cast<Image8*>(thumbImg);
-        image->writeData(f);
+        image->writeData(data);
     } else if (thumbImg->getType() == sImage16) {
         Image16 *image = static_cast<Image16*>(thumbImg);
-        image->writeData(f);
+        image->writeData(data);
     } else if (thumbImg->getType() == sImagefloat) {
         Imagefloat *image = static_cast<Imagefloat*>(thumbImg);
-        image->writeData(f);
+        image->writeData(data);
     }
 
-    //thumbImg->writeData(f);
-    fclose (f);
     return true;
 }
 
-bool Thumbnail::readImage (const Glib::ustring& fname)
+bool Thumbnail::readImage (const char* data, std::size_t size)
 {
 
     if (thumbImg) {
@@ -1769,52 +1770,54 @@ bool Thumbnail::readImage (const Glib::ustring& fname)
         thumbImg = nullptr;
     }
 
-    Glib::ustring fullFName = fname + ".rtti";
+    const char* const typeEnd = static_cast<const char*>(memchr(data, '\n', std::min<std::size_t>(size, 31)));
 
-    if (!Glib::file_test (fullFName, Glib::FILE_TEST_EXISTS)) {
+    if (!typeEnd || std::size_t(typeEnd + 1 - data) + 2 * sizeof (guint32) > size) {
         return false;
     }
 
-    FILE* f = g_fopen (fullFName.c_str (), "rb");
-
-    if (!f) {
-        return false;
-    }
-
-    char imgType[31];  // 30 -> arbitrary size, but should be enough for all image type's name
-    fgets(imgType, 30, f);
-    imgType[strlen(imgType) - 1] = '\0'; // imgType has a \n trailing character, so we overwrite it by the \0 char
+    const std::string imgType(data, typeEnd);
+    const char* pixels = typeEnd + 1;
 
     guint32 width, height;
-    fread (&width, 1, sizeof (guint32), f);
-    fread (&height, 1, sizeof (guint32), f);
+    memcpy (&width, pixels, sizeof (guint32));
+    memcpy (&height, pixels + sizeof (guint32), sizeof (guint32));
+    pixels += 2 * sizeof (guint32);
+
+    const std::size_t pixelCount = std::size_t(width) * height * 3;
+    const std::size_t available = size - (pixels - data);
 
     bool success = false;
 
-    if (!strcmp(imgType, sImage8)) {
-        Image8 *image = new Image8(width, height);
-        image->readData(f);
-        thumbImg = image;
-        success = true;
-    } else if (!strcmp(imgType, sImage16)) {
-        Image16 *image = new Image16(width, height);
-        image->readData(f);
-        thumbImg = image;
-        success = true;
-    } else if (!strcmp(imgType, sImagefloat)) {
-        Imagefloat *image = new Imagefloat(width, height);
-        image->readData(f);
-        thumbImg = image;
-        success = true;
+    if (imgType == sImage8) {
+        if (pixelCount * sizeof(unsigned char) <= available) {
+            Image8 *image = new Image8(width, height);
+            image->readData(pixels);
+            thumbImg = image;
+            success = true;
+        }
+    } else if (imgType == sImage16) {
+        if (pixelCount * sizeof(unsigned short) <= available) {
+            Image16 *image = new Image16(width, height);
+            image->readData(pixels);
+            thumbImg = image;
+            success = true;
+        }
+    } else if (imgType == sImagefloat) {
+        if (pixelCount * sizeof(float) <= available) {
+            Imagefloat *image = new Imagefloat(width, height);
+            image->readData(pixels);
+            thumbImg = image;
+            success = true;
+        }
     } else {
-        printf("readImage: Unsupported image type \"%s\"!\n", imgType);
+        printf("readImage: Unsupported image type \"%s\"!\n", imgType.c_str());
     }
 
-    fclose(f);
     return success;
 }
 
-bool Thumbnail::readData  (const Glib::ustring& fname)
+bool Thumbnail::readData  (const char* data, std::size_t size)
 {
     setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
     Glib::KeyFile keyFile;
@@ -1823,7 +1826,7 @@ bool Thumbnail::readData  (const Glib::ustring& fname)
         MyMutex::MyLock thmbLock(thumbMutex);
 
         try {
-            keyFile.load_from_file (fname);
+            keyFile.load_from_data (std::string (data, size));
         } catch (Glib::Error&) {
             return false;
         }
@@ -1899,18 +1902,18 @@ bool Thumbnail::readData  (const Glib::ustring& fname)
         return true;
     } catch (Glib::Error &err) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::readData / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("Thumbnail::readData / Error code %d while reading values:\n%s\n", err.code(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::readData / Unknown exception while trying to load \"%s\"!\n", fname.c_str());
+            printf("Thumbnail::readData / Unknown exception while trying to load the data!\n");
         }
     }
 
     return false;
 }
 
-bool Thumbnail::writeData  (const Glib::ustring& fname)
+bool Thumbnail::writeData  (std::string& data)
 {
     MyMutex::MyLock thmbLock(thumbMutex);
 
@@ -1921,7 +1924,7 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
         Glib::KeyFile keyFile;
 
         try {
-            keyFile.load_from_file (fname);
+            keyFile.load_from_data (data);
         } catch (Glib::Error&) {}
 
         keyFile.set_double  ("LiveThumbData", "CamWBRed", camwbRed);
@@ -1945,11 +1948,11 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
 
     } catch (Glib::Error& err) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::writeData / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("Thumbnail::writeData / Error code %d while reading values:\n%s\n", err.code(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("Thumbnail::writeData / Unknown exception while trying to save \"%s\"!\n", fname.c_str());
+            printf("Thumbnail::writeData / Unknown exception while trying to save the data!\n");
         }
     }
 
@@ -1957,38 +1960,21 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
         return false;
     }
 
-    FILE *f = g_fopen (fname.c_str (), "wt");
-
-    if (!f) {
-        if (options.rtSettings.verbose) {
-            printf("Thumbnail::writeData / Error: unable to open file \"%s\" with write access!\n", fname.c_str());
-        }
-
-        return false;
-    } else {
-        fprintf (f, "%s", keyData.c_str ());
-        fclose (f);
-    }
-
+    data = keyData;
     return true;
 }
 
-bool Thumbnail::readEmbProfile  (const Glib::ustring& fname)
+bool Thumbnail::readEmbProfile  (const char* data, std::size_t size)
 {
 
-    FILE* f = g_fopen (fname.c_str (), "rb");
-
-    if (!f) {
+    if (!data || !size) {
         embProfileData = nullptr;
         embProfile = nullptr;
         embProfileLength = 0;
     } else {
-        fseek (f, 0, SEEK_END);
-        embProfileLength = ftell (f);
-        fseek (f, 0, SEEK_SET);
+        embProfileLength = size;
         embProfileData = new unsigned char[embProfileLength];
-        fread (embProfileData, 1, embProfileLength, f);
-        fclose (f);
+        memcpy (embProfileData, data, embProfileLength);
         embProfile = cmsOpenProfileFromMem (embProfileData, embProfileLength);
         return true;
     }
@@ -1996,50 +1982,39 @@ bool Thumbnail::readEmbProfile  (const Glib::ustring& fname)
     return false;
 }
 
-bool Thumbnail::writeEmbProfile (const Glib::ustring& fname)
+bool Thumbnail::writeEmbProfile (std::string& data)
 {
 
     if (embProfileData) {
-        FILE* f = g_fopen(fname.c_str (), "wb");
-
-        if (f) {
-            fwrite (embProfileData, 1, embProfileLength, f);
-            fclose (f);
-            return true;
-        }
+        data.assign (reinterpret_cast<const char*>(embProfileData), embProfileLength);
+        return true;
     }
 
     return false;
 }
 
-bool Thumbnail::readAEHistogram  (const Glib::ustring& fname)
+bool Thumbnail::readAEHistogram  (const char* data, std::size_t size)
 {
 
-    FILE* f = g_fopen (fname.c_str (), "rb");
+    const std::size_t length = (65536 >> aeHistCompression) * sizeof(aeHistogram[0]);
 
-    if (!f) {
+    if (!data || size < length) {
         aeHistogram(0);
     } else {
         aeHistogram(65536 >> aeHistCompression);
-        fread (&aeHistogram[0], 1, (65536 >> aeHistCompression)*sizeof(aeHistogram[0]), f);
-        fclose (f);
+        memcpy (&aeHistogram[0], data, length);
         return true;
     }
 
     return false;
 }
 
-bool Thumbnail::writeAEHistogram (const Glib::ustring& fname)
+bool Thumbnail::writeAEHistogram (std::string& data)
 {
 
     if (aeHistogram) {
-        FILE* f = g_fopen (fname.c_str (), "wb");
-
-        if (f) {
-            fwrite (&aeHistogram[0], 1, (65536 >> aeHistCompression)*sizeof(aeHistogram[0]), f);
-            fclose (f);
-            return true;
-        }
+        data.assign (reinterpret_cast<const char*>(&aeHistogram[0]), (65536 >> aeHistCompression) * sizeof(aeHistogram[0]));
+        return true;
     }
 
     return false;
@@ -89,17 +89,21 @@ public:
     void applyAutoExp (procparams::ProcParams& pparams);
 
     unsigned char* getGrayscaleHistEQ (int trim_width);
-    bool writeImage (const Glib::ustring& fname, int format);
-    bool readImage (const Glib::ustring& fname);
 
-    bool readData  (const Glib::ustring& fname);
-    bool writeData  (const Glib::ustring& fname);
+    // The records of the thumbnail cache: read from size bytes at data,
+    // written by replacing the content of data
+    bool writeImage (std::string& data);
+    bool readImage (const char* data, std::size_t size);
 
-    bool readEmbProfile  (const Glib::ustring& fname);
-    bool writeEmbProfile (const Glib::ustring& fname);
+    // the key file of the image data is shared with CacheImageData: data holds the current version
+    bool readData  (const char* data, std::size_t size);
+    bool writeData  (std::string& data);
 
-    bool readAEHistogram  (const Glib::ustring& fname);
-    bool writeAEHistogram (const Glib::ustring& fname);
+    bool readEmbProfile  (const char* data, std::size_t size);
+    bool writeEmbProfile (std::string& data);
+
+    bool readAEHistogram  (const char* data, std::size_t size);
+    bool writeAEHistogram (std::string& data);
 
     unsigned char* getImage8Data();  // accessor to the 8bit image if it is one, which should be the case for the "Inspector" mode.
 
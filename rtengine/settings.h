@@ -92,6 +92,17 @@ public:
     double          ed_low;
     double          ed_lipinfl;
     double          ed_lipampl;
+    bool            tiledExport;            ///< Run the post-demosaic chain of the export over strips when no enabled tool needs the whole image
+    int             tiledExportMemory;      ///< Amount of memory used by the buffers of a strip of the tiled export, in KiB
+    Glib::ustring   cacheDirectory;         ///< The directory of the disk caches of the engine (demosaiced data, FFTW wisdom)
+    bool            demosaicCache;          ///< Keep the demosaiced raw data on disk and reuse it when only later processing steps changed
+    int             demosaicCacheSize;      ///< Maximum size of the demosaic cache on disk, in MiB
+    bool            fusedCurves;            ///< Apply the RGB and L*a*b* curves and vibrance in one cache-blocked pass when no spatial tool sits in between
+    bool            resizeEarly;            ///< Downscale the export right after the transform, and run the later tools at the output scale with adjusted radii
+    double          resizeEarlyMaxScale;    ///< The early downscale is only done when the output is at most this fraction of the cropped image size
+    bool            mmapInput;              ///< Map the input files into memory instead of reading them into a buffer (except on network file systems)
+    int             inputPrefetch;          ///< Number of upcoming files of the batch queue and of rawtherapee-cli read ahead into the system cache, 0 disables it
+    Glib::ustring   cpuTarget;              ///< Instruction set of the kernels built for several ones: "auto" (best supported), "generic" or "avx2"
     /** Creates a new instance of Settings.
       * @return a pointer to the new Settings instance. */
     static Settings* create  ();
@@ -25,10 +25,14 @@
 #include "clutstore.h"
 #include "processingjob.h"
 #include <glibmm.h>
+#include <algorithm>
 #include "../rtgui/options.h"
 #include "rawimagesource.h"
 #include "../rtgui/multilangmgr.h"
 #include "mytime.h"
+#include "array2D.h"
+#include "StopWatch.h"
+#include "taskscheduler.h"
 #undef THREAD_PRIORITY_NORMAL
 
 namespace rtengine
@@ -43,17 +47,29 @@ void adjust_radius(const T &default_param, double scale_factor, T &param)
     const double delta = (param - default_param) * scale_factor;
     param = default_param + delta;
 }
+
+// The conversion of the L*a*b* data to the output profile, quantized to 16 bits or kept as floating point values
+void lab2output(ImProcFunctions &ipf, LabImage *lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga, Image16 *&image)
+{
+    image = ipf.lab2rgb16(lab, cx, cy, cw, ch, icm, bw, ga);
+}
+
+void lab2output(ImProcFunctions &ipf, LabImage *lab, int cx, int cy, int cw, int ch, const procparams::ColorManagementParams &icm, bool bw, GammaValues *ga, Imagefloat *&image)
+{
+    image = ipf.lab2rgbFloat(lab, cx, cy, cw, ch, icm, bw, ga);
+}
     
 
 class ImageProcessor {
 public:
     ImageProcessor(ProcessingJob* pjob, int& errorCode,
-                   ProgressListener* pl, bool tunnelMetaData, bool flush):
+                   ProgressListener* pl, bool tunnelMetaData, bool flush, bool floatOutput):
         job(static_cast<ProcessingJobImpl*>(pjob)),
         errorCode(errorCode),
         pl(pl),
         tunnelMetaData(tunnelMetaData),
         flush(flush),
+        floatOutput(floatOutput),
         // internal state
         ipf_p(nullptr),
         ii(nullptr),
@@ -64,7 +80,8 @@ public:
     {
     }
 
-    Image16 *operator()()
+    // an Image16, or an Imagefloat if floatOutput
+    IImage *operator()()
     {
         if (!job->fast) {
             return normal_pipeline();
@@ -74,17 +91,30 @@ public:
     }
 
 private:
-    Image16 *normal_pipeline()
+    IImage *normal_pipeline()
     {
         if (!stage_init()) {
             return nullptr;
         }
-        stage_denoise();
-        stage_transform();
+        TaskScheduler::checkpoint();
+
+        if (resize_early()) {
+            // same order as the fast pipeline, but the tools are kept
+            stage_transform();
+            stage_early_resize(true);
+            TaskScheduler::checkpoint();
+            stage_denoise();
+        } else {
+            stage_denoise();
+            TaskScheduler::checkpoint();
+            stage_transform();
+        }
+
+        TaskScheduler::checkpoint();
         return stage_finish();
     }
 
-    Image16 *fast_pipeline()
+    IImage *fast_pipeline()
     {
         if (!job->pparams.resize.enabled) {
             return normal_pipeline();
@@ -95,14 +125,18 @@ private:
         if (!stage_init()) {
             return nullptr;
         }
+        TaskScheduler::checkpoint();
         stage_transform();
-        stage_early_resize();
+        stage_early_resize(false);
+        TaskScheduler::checkpoint();
         stage_denoise();
+        TaskScheduler::checkpoint();
         return stage_finish();
     }
 
     bool stage_init()
     {
+        BENCHFUN
         errorCode = 0;
 
         if (pl) {
@@ -734,6 +768,7 @@ private:
 
     void stage_denoise()
     {
+        BENCHFUN
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = *(ipf_p.get());
@@ -799,6 +834,7 @@ private:
 
     void stage_transform()
     {
+        BENCHFUN
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = *(ipf_p.get());        
@@ -820,8 +856,9 @@ private:
         }
     }
 
-    Image16 *stage_finish()
+    IImage *stage_finish()
     {
+        BENCHFUN
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = *(ipf_p.get());        
@@ -855,6 +892,8 @@ private:
         curve1(65536);
         curve2(65536);
         curve(65536, 0);
+        acurve(65536);
+        bcurve(65536);
         satcurve(65536, 0);
         lhskcurve(65536, 0);
         lumacurve(32770, 0); // lumacurve[32768] and lumacurve[32769] will be set to 32768 and 32769 later to allow linear interpolation
@@ -893,8 +932,6 @@ private:
             CurveFactory::curveToning(params.colorToning.cl2curve, cl2Toningcurve, 1);
         }
 
-        labView = new LabImage (fw, fh);
-
         if(params.blackwhite.enabled) {
             CurveFactory::curveBW (params.blackwhite.beforeCurve, params.blackwhite.afterCurve, hist16, dummy, customToneCurvebw1, customToneCurvebw2, 1);
         }
@@ -927,12 +964,35 @@ private:
         DCPProfile::ApplyState as;
         DCPProfile *dcpProf = imgsrc->getDCP(params.icm, currWB, as);
 
-        LUTu histToneCurve;
+        // the tiled export uses buffers of the size of a strip instead of the full-frame labView
+        const int halo = tiled_halo();
 
-        ipf.rgbProc (baseImg, labView, nullptr, curve1, curve2, curve, shmap, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit , satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve);
+        if (halo >= 0) {
+            if (floatOutput) {
+                return stage_finish_tiled<Imagefloat>(halo, satLimit, satLimitOpacity, opautili, dcpProf, as);
+            } else {
+                return stage_finish_tiled<Image16>(halo, satLimit, satLimitOpacity, opautili, dcpProf, as);
+            }
+        }
 
-        if (settings->verbose) {
-            printf("Output image / Auto B&W coefs:   R=%.2f   G=%.2f   B=%.2f\n", autor, autog, autob);
+        labView = new LabImage (fw, fh);
+
+        // edge preserving decompression sits between the L*a*b* curves and vibrance
+        const bool epd = params.epd.enabled && (!params.colorappearance.enabled || !params.colorappearance.tonecie);
+        // from the RGB curves to vibrance every step is pointwise, unless one of these tools needs the whole image
+        const bool fused = settings->fusedCurves && !shmap && !(params.blackwhite.enabled && params.blackwhite.autoc) && params.labCurve.contrast == 0 && !epd;
+
+        if (fused) {
+            prepare_lab_curves();
+            stage_curves_fused(satLimit, satLimitOpacity, opautili, dcpProf, as);
+        } else {
+            LUTu histToneCurve;
+
+            ipf.rgbProc (baseImg, labView, nullptr, curve1, curve2, curve, shmap, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit , satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve);
+
+            if (settings->verbose) {
+                printf("Output image / Auto B&W coefs:   R=%.2f   G=%.2f   B=%.2f\n", autor, autog, autob);
+            }
         }
 
         // if clut was used and size of clut cache == 1 we free the memory used by the clutstore (default clut cache size = 1 for 32 bit OS)
@@ -969,7 +1029,7 @@ private:
         // start tile processing...???
 
 
-        if(params.labCurve.contrast != 0) { //only use hist16 for contrast
+        if(!fused && params.labCurve.contrast != 0) { //only use hist16 for contrast
             hist16.clear();
 
 #ifdef _OPENMP
@@ -994,25 +1054,22 @@ private:
             }
         }
 
-        bool utili;
-        CurveFactory::complexLCurve (params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
-
-        bool clcutili;
-        CurveFactory::curveCL(clcutili, params.labCurve.clcurve, clcurve, 1);
+        if (!fused) {
+            prepare_lab_curves();
 
-        bool ccutili, cclutili;
-        CurveFactory::complexsgnCurve (autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
-                                       params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 1);
+            if (settings->fusedCurves && !epd) {
+                ipf.chromiLuminanceCurveVibrance (1, labView, labView, acurve, bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+            } else {
+                ipf.chromiLuminanceCurve (nullptr, 1, labView, labView, acurve, bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
 
-        ipf.chromiLuminanceCurve (nullptr, 1, labView, labView, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+                if((params.colorappearance.enabled && !params.colorappearance.tonecie) || (!params.colorappearance.enabled)) {
+                    ipf.EPDToneMap(labView, 5, 1);
+                }
 
-        if((params.colorappearance.enabled && !params.colorappearance.tonecie) || (!params.colorappearance.enabled)) {
-            ipf.EPDToneMap(labView, 5, 1);
+                ipf.vibrance(labView);
+            }
         }
 
-
-        ipf.vibrance(labView);
-
         if((params.colorappearance.enabled && !settings->autocielab) || (!params.colorappearance.enabled)) {
             ipf.impulsedenoise (labView);
         }
@@ -1218,7 +1275,21 @@ private:
             }
         }
 
-        Image16* readyImg = nullptr;
+        if (floatOutput) {
+            return stage_convert<Imagefloat>(cx, cy, cw, ch, tmpScale, imw, imh);
+        } else {
+            return stage_convert<Image16>(cx, cy, cw, ch, tmpScale, imw, imh);
+        }
+    }
+
+    // converts labView, cropped, to the output
+    template<class Image>
+    Image *stage_convert(int cx, int cy, int cw, int ch, double tmpScale, int imw, int imh)
+    {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = *(ipf_p.get());
+
+        Image* readyImg = nullptr;
         cmsHPROFILE jprof = nullptr;
         bool customGamma = false;
         bool useLCMS = false;
@@ -1228,7 +1299,7 @@ private:
 
             GammaValues ga;
             //  if(params.blackwhite.enabled) params.toneCurve.hrenabled=false;
-            readyImg = ipf.lab2rgb16 (labView, cx, cy, cw, ch, params.icm, bwonly, &ga);
+            lab2output (ipf, labView, cx, cy, cw, ch, params.icm, bwonly, &ga, readyImg);
             customGamma = true;
 
             //or selected Free gamma
@@ -1242,7 +1313,7 @@ private:
             // if Default gamma mode: we use the profile selected in the "Output profile" combobox;
             // gamma come from the selected profile, otherwise it comes from "Free gamma" tool
 
-            readyImg = ipf.lab2rgb16 (labView, cx, cy, cw, ch, params.icm, bwonly);
+            lab2output (ipf, labView, cx, cy, cw, ch, params.icm, bwonly, nullptr, readyImg);
 
             if (settings->verbose) {
                 printf("Output profile_: \"%s\"\n", params.icm.output.c_str());
@@ -1252,7 +1323,263 @@ private:
         delete labView;
         labView = nullptr;
 
+        return stage_output<Image>(readyImg, cw, ch, bwonly, tmpScale, imw, imh, customGamma, useLCMS, jprof);
+    }
+
+    // rgbProc, chromiLuminanceCurve and vibrance applied band after band, each band going through all of them while it is in the cache
+    void stage_curves_fused(float satLimit, float satLimitOpacity, bool opautili, DCPProfile *dcpProf, const DCPProfile::ApplyState &as)
+    {
+        BENCHFUN
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = *(ipf_p.get());
+
+        // bands of about 1 MiB of RGB and L*a*b* data
+        const int bandHeight = std::max((1 << 20) / (6 * int(sizeof(float)) * fw), 4);
+
+        // the L*a*b* curves are built once, the bands only run the per pixel part
+        const ImProcFunctions::LabHueCurves hueCurves (params.labCurve);
+        LUTf skin_curve;
+
+        if (params.vibrance.enabled) {
+            ipf.vibranceSkinCurve (skin_curve);
+        }
+
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        {
+            // the steps only depend on the pixel itself, so each band goes through them on a single thread
+            ImProcFunctions bandIpf(&params, false);
+            std::copy(ipf.lumimul, ipf.lumimul + 3, bandIpf.lumimul);
+            std::unique_ptr<Imagefloat> bandImg;
+
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
+#endif
+
+            for (int y = 0; y < fh; y += bandHeight) {
+                const int rows = std::min(bandHeight, fh - y);
+
+                if (!bandImg || bandImg->getHeight() != rows) {
+                    bandImg.reset(new Imagefloat (fw, rows));
+                }
 
+                for (int i = 0; i < rows; i++) {
+                    memcpy(bandImg->r(i), baseImg->r(y + i), fw * sizeof(float));
+                    memcpy(bandImg->g(i), baseImg->g(y + i), fw * sizeof(float));
+                    memcpy(bandImg->b(i), baseImg->b(y + i), fw * sizeof(float));
+                }
+
+                LabImage bandLab (labView, y, rows);
+
+                double rrm, ggm, bbm;
+                float autor = -9000.f, autog, autob;
+                LUTu histToneCurve;
+                bandIpf.rgbProc (bandImg.get(), &bandLab, nullptr, curve1, curve2, curve, nullptr, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit , satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve);
+
+                bandIpf.chromiLuminanceCurve (nullptr, 1, &bandLab, &bandLab, hueCurves, acurve, bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+                bandIpf.vibrance(&bandLab, skin_curve);
+            }
+        }
+    }
+
+    template<class Image>
+    Image *stage_finish_tiled(int halo, float satLimit, float satLimitOpacity, bool opautili, DCPProfile *dcpProf, const DCPProfile::ApplyState &as)
+    {
+        BENCHFUN
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = *(ipf_p.get());
+
+        // the L histogram is not needed here, as a non-zero L*a*b* contrast forces the full-frame processing
+        prepare_lab_curves();
+
+        int imw, imh;
+        double tmpScale = ipf.resizeScale(&params, fw, fh, imw, imh);
+
+        int cx = 0, cy = 0, cw = fw, ch = fh;
+
+        if (params.crop.enabled) {
+            cx = params.crop.x;
+            cy = params.crop.y;
+            cw = params.crop.w;
+            ch = params.crop.h;
+        }
+
+        bool bwonly = params.blackwhite.enabled && !params.colorToning.enabled && !autili && !butili ;
+        bool customGamma = params.icm.gamma != "default" || params.icm.freegamma;
+        GammaValues ga;
+
+        Image* readyImg = new Image (cw, ch);
+
+        // the strips cover the crop area, extended on each side by the halo needed by the spatial tools
+        const int x0 = std::max(cx - halo, 0);
+        const int x1 = std::min(cx + cw + halo, fw);
+        const int sw = x1 - x0;
+        // about 48 bytes per pixel are used by the strip buffers (Imagefloat, LabImage, sharpening buffer and output)
+        const int stripHeight = std::max({int(std::size_t(settings->tiledExportMemory) * 1024 / (std::size_t(sw) * 48)), 4 * halo, 16});
+
+        if (settings->verbose) {
+            printf("Tiled export: strips of %d rows, halo of %d pixels\n", stripHeight, halo);
+        }
+
+        for (int y = cy; y < cy + ch; y += stripHeight) {
+            TaskScheduler::checkpoint();
+
+            const int rows = std::min(stripHeight, cy + ch - y);
+            const int y0 = std::max(y - halo, 0);
+            const int y1 = std::min(y + rows + halo, fh);
+            const int sh = y1 - y0;
+
+            Imagefloat stripImg (sw, sh);
+
+            for (int i = 0; i < sh; i++) {
+                memcpy(stripImg.r(i), baseImg->r(y0 + i) + x0, sw * sizeof(float));
+                memcpy(stripImg.g(i), baseImg->g(y0 + i) + x0, sw * sizeof(float));
+                memcpy(stripImg.b(i), baseImg->b(y0 + i) + x0, sw * sizeof(float));
+            }
+
+            LabImage stripLab (sw, sh);
+
+            double rrm, ggm, bbm;
+            float autor = -9000.f, autog, autob;
+            LUTu histToneCurve;
+            ipf.rgbProc (&stripImg, &stripLab, nullptr, curve1, curve2, curve, nullptr, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit , satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve);
+
+            ipf.chromiLuminanceCurve (nullptr, 1, &stripLab, &stripLab, acurve, bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+            ipf.vibrance(&stripLab);
+
+            if (params.sharpenEdge.enabled) {
+                ipf.MLsharpen(&stripLab);
+            }
+
+            if (params.sharpenMicro.enabled) {
+                ipf.MLmicrocontrast (&stripLab);
+            }
+
+            if (params.sharpening.enabled) {
+                array2D<float> buffer (sw, sh);
+                ipf.sharpening (&stripLab, buffer, params.sharpening);
+            }
+
+            // only the rows of the strip itself are converted, the halo is dropped
+            Image* stripOut = nullptr;
+            lab2output (ipf, &stripLab, cx - x0, y - y0, cw, rows, params.icm, bwonly, customGamma ? &ga : nullptr, stripOut);
+
+            for (int i = 0; i < rows; i++) {
+                memcpy(readyImg->r(y - cy + i), stripOut->r(i), cw * sizeof(*stripOut->r(i)));
+                memcpy(readyImg->g(y - cy + i), stripOut->g(i), cw * sizeof(*stripOut->g(i)));
+                memcpy(readyImg->b(y - cy + i), stripOut->b(i), cw * sizeof(*stripOut->b(i)));
+            }
+
+            delete stripOut;
+
+            if (pl) {
+                pl->setProgress (0.50 + 0.20 * (y + rows - cy) / ch);
+            }
+        }
+
+        // if clut was used and size of clut cache == 1 we free the memory used by the clutstore (default clut cache size = 1 for 32 bit OS)
+        if ( params.filmSimulation.enabled && !params.filmSimulation.clutFilename.empty() && options.clutCacheSize == 1) {
+            CLUTStore::getInstance().clearCache();
+        }
+
+        customToneCurve1.Reset();
+        customToneCurve2.Reset();
+        ctColorCurve.Reset();
+        ctOpacityCurve.Reset();
+        noiseLCurve.Reset();
+        noiseCCurve.Reset();
+        customToneCurvebw1.Reset();
+        customToneCurvebw2.Reset();
+
+        delete baseImg;
+        baseImg = nullptr;
+
+        cmsHPROFILE jprof = nullptr;
+        bool useLCMS = false;
+
+        if (customGamma) {
+            if ((jprof = ICCStore::getInstance()->createCustomGammaOutputProfile (params.icm, ga)) == nullptr) {
+                useLCMS = true;
+            }
+        } else if (settings->verbose) {
+            printf("Output profile_: \"%s\"\n", params.icm.output.c_str());
+        }
+
+        return stage_output<Image>(readyImg, cw, ch, bwonly, tmpScale, imw, imh, customGamma, useLCMS, jprof);
+    }
+
+    // Returns the halo (in pixels) needed by the spatial tools of the tiled export, or -1 if the image has to be processed full-frame
+    int tiled_halo()
+    {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = *(ipf_p.get());
+
+        if (!settings->tiledExport) {
+            return -1;
+        }
+
+        // these tools need whole-image statistics or large neighbourhoods
+        if (params.sh.enabled || params.labCurve.contrast != 0 || (params.blackwhite.enabled && params.blackwhite.autoc)
+                || params.epd.enabled || params.impulseDenoise.enabled || params.defringe.enabled
+                || (params.dirpyrequalizer.enabled && params.dirpyrequalizer.cbdlMethod == "aft") || params.wavelet.enabled
+                || params.colorappearance.enabled || params.colorappearance.tonecie) {
+            return -1;
+        }
+
+        // Lanczos resizing works on the whole image
+        int imw, imh;
+        double tmpScale = ipf.resizeScale(&params, fw, fh, imw, imh);
+
+        if (params.resize.enabled && params.resize.method != "Nearest" && tmpScale != 1.0) {
+            return -1;
+        }
+
+        // the spatial tools are applied one after the other, so their radii add up
+        int halo = 0;
+
+        if (params.sharpenEdge.enabled) {
+            halo += params.sharpenEdge.passes + 2;
+        }
+
+        if (params.sharpenMicro.enabled) {
+            halo += 3;
+        }
+
+        if (params.sharpening.enabled) {
+            if (params.sharpening.method == "rld") {
+                // the successive gaussian blurs of the deconvolution add up to a sigma of radius * sqrt(2 * iterations)
+                halo += int(std::ceil(4.0 * params.sharpening.deconvradius * std::sqrt(2.0 * params.sharpening.deconviter)));
+            } else {
+                halo += int(std::ceil(4.0 * params.sharpening.radius)) + 2;
+
+                if (params.sharpening.edgesonly) {
+                    halo += int(std::ceil(3.0 * params.sharpening.edges_radius));
+                }
+            }
+        }
+
+        return halo;
+    }
+
+    void prepare_lab_curves()
+    {
+        procparams::ProcParams& params = job->pparams;
+
+        CurveFactory::complexLCurve (params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
+
+        CurveFactory::curveCL(clcutili, params.labCurve.clcurve, clcurve, 1);
+
+        CurveFactory::complexsgnCurve (autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
+                                       params.labCurve.lccurve, acurve, bcurve, satcurve, lhskcurve, 1);
+    }
+
+    template<class Image>
+    Image *stage_output(Image *readyImg, int cw, int ch, bool bwonly, double tmpScale, int imw, int imh, bool customGamma, bool useLCMS, cmsHPROFILE jprof)
+    {
+        BENCHFUN
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = *(ipf_p.get());
 
         if(bwonly) { //force BW r=g=b
             if (settings->verbose) {
@@ -1272,7 +1599,7 @@ private:
         }
 
         if (tmpScale != 1.0 && params.resize.method == "Nearest") { // resize rgb data (gamma applied)
-            Image16* tempImage = new Image16 (imw, imh);
+            Image* tempImage = new Image (imw, imh);
             ipf.resize (readyImg, tempImage, tmpScale);
             delete readyImg;
             readyImg = tempImage;
@@ -1346,8 +1673,35 @@ private:
         return readyImg;
     }
 
-    void stage_early_resize()
+    // Whether the image is downscaled after the transform, the next tools running at the output scale (see Settings::resizeEarly)
+    bool resize_early()
     {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = *(ipf_p.get());
+
+        // the nearest neighbour resize applies to the RGB output, which the early Lanczos resize would not match
+        if (!settings->resizeEarly || !params.resize.enabled || params.resize.method == "Nearest") {
+            return false;
+        }
+
+        int imw, imh;
+        const double scale_factor = ipf.resizeScale(&params, fw, fh, imw, imh);
+
+        if (scale_factor > settings->resizeEarlyMaxScale) {
+            return false;
+        }
+
+        if (settings->verbose) {
+            printf("Resize early: the tools run at a scale of %.3f\n", scale_factor);
+        }
+
+        return true;
+    }
+
+    // keepTools: only the radii and strengths are scaled, the tools which fast export disables are kept
+    void stage_early_resize(bool keepTools)
+    {
+        BENCHFUN
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = *(ipf_p.get());        
@@ -1386,7 +1740,11 @@ private:
             tmplab = std::move(resized);
         }
 
-        adjust_procparams(scale_factor);
+        if (keepTools) {
+            scale_procparams(scale_factor);
+        } else {
+            adjust_procparams(scale_factor);
+        }
             
         fw = imw;
         fh = imh;
@@ -1396,31 +1754,16 @@ private:
         ipf.lab2rgb(*tmplab, *baseImg, params.icm.working);
     }
 
+    // The parameters of the fast export pipeline: the tools run at the output scale, and the slowest ones are simplified
     void adjust_procparams(double scale_factor)
     {
         procparams::ProcParams &params = job->pparams;
-        procparams::ProcParams defaultparams;
 
-        params.resize.enabled = false;
-        params.crop.enabled = false;
+        scale_procparams(scale_factor);
 
-        if (params.prsharpening.enabled) {
-            params.sharpening = params.prsharpening;
-        } else {
-            adjust_radius(defaultparams.sharpening.radius, scale_factor,
-                          params.sharpening.radius);
-        }
-        params.impulseDenoise.thresh *= scale_factor;
         if (scale_factor < 0.5) {
             params.impulseDenoise.enabled = false;
         }
-        params.wavelet.strength *= scale_factor;
-        params.dirpyrDenoise.luma *= scale_factor;
-        params.dirpyrDenoise.Ldetail += (100 - params.dirpyrDenoise.Ldetail) * scale_factor;
-        //params.dirpyrDenoise.smethod = "shal";
-        for (auto &p : params.dirpyrDenoise.lcurve) {
-            p *= scale_factor;
-        }
         const char *medmethods[] = { "soft", "33", "55soft", "55", "77", "99" };
         if (params.dirpyrDenoise.median) {
             auto &key = params.dirpyrDenoise.methodmed == "RGB" ? params.dirpyrDenoise.rgbmethod : params.dirpyrDenoise.medmethod;
@@ -1436,6 +1779,42 @@ private:
                 }
             }
         }
+
+        if (params.raw.xtranssensor.method ==
+            procparams::RAWParams::XTransSensor::methodstring[
+                procparams::RAWParams::XTransSensor::threePass]) {
+            params.raw.xtranssensor.method =
+                procparams::RAWParams::XTransSensor::methodstring[
+                    procparams::RAWParams::XTransSensor::onePass];
+        }
+        if (params.raw.bayersensor.method == procparams::RAWParams::BayerSensor::methodstring[procparams::RAWParams::BayerSensor::pixelshift]) {
+            params.raw.bayersensor.method = procparams::RAWParams::BayerSensor::methodstring[params.raw.bayersensor.pixelShiftLmmse ? procparams::RAWParams::BayerSensor::lmmse : procparams::RAWParams::BayerSensor::amaze];
+        }
+    }
+
+    // Scales the radii and strengths of the tools running after the resize, without disabling any of them
+    void scale_procparams(double scale_factor)
+    {
+        procparams::ProcParams &params = job->pparams;
+        procparams::ProcParams defaultparams;
+
+        params.resize.enabled = false;
+        params.crop.enabled = false;
+
+        if (params.prsharpening.enabled) {
+            params.sharpening = params.prsharpening;
+        } else {
+            adjust_radius(defaultparams.sharpening.radius, scale_factor,
+                          params.sharpening.radius);
+        }
+        params.impulseDenoise.thresh *= scale_factor;
+        params.wavelet.strength *= scale_factor;
+        params.dirpyrDenoise.luma *= scale_factor;
+        params.dirpyrDenoise.Ldetail += (100 - params.dirpyrDenoise.Ldetail) * scale_factor;
+        //params.dirpyrDenoise.smethod = "shal";
+        for (auto &p : params.dirpyrDenoise.lcurve) {
+            p *= scale_factor;
+        }
         
         params.epd.scale *= scale_factor;
         //params.epd.edgeStopping *= scale_factor;
@@ -1450,17 +1829,6 @@ private:
         adjust_radius(defaultparams.defringe.radius, scale_factor,
                       params.defringe.radius);
         adjust_radius(defaultparams.sh.radius, scale_factor, params.sh.radius);
-
-        if (params.raw.xtranssensor.method ==
-            procparams::RAWParams::XTransSensor::methodstring[
-                procparams::RAWParams::XTransSensor::threePass]) {
-            params.raw.xtranssensor.method =
-                procparams::RAWParams::XTransSensor::methodstring[
-                    procparams::RAWParams::XTransSensor::onePass];
-        }
-        if (params.raw.bayersensor.method == procparams::RAWParams::BayerSensor::methodstring[procparams::RAWParams::BayerSensor::pixelshift]) {
-            params.raw.bayersensor.method = procparams::RAWParams::BayerSensor::methodstring[params.raw.bayersensor.pixelShiftLmmse ? procparams::RAWParams::BayerSensor::lmmse : procparams::RAWParams::BayerSensor::amaze];
-        }
     }
 
 private:
@@ -1469,6 +1837,7 @@ private:
     ProgressListener* pl;
     bool tunnelMetaData;
     bool flush;
+    bool floatOutput;
 
     // internal state
     std::unique_ptr<ImProcFunctions> ipf_p;
@@ -1515,6 +1884,8 @@ private:
     LUTf curve1;
     LUTf curve2;
     LUTf curve;
+    LUTf acurve;
+    LUTf bcurve;
     LUTf satcurve;
     LUTf lhskcurve;
     LUTf lumacurve;
@@ -1536,6 +1907,7 @@ private:
     ToneCurve customToneCurvebw2;
 
     bool autili, butili;
+    bool utili, clcutili, ccutili, cclutili;
 };
 
 } // namespace
@@ -1543,12 +1915,99 @@ private:
 
 IImage16* processImage (ProcessingJob* pjob, int& errorCode, ProgressListener* pl, bool tunnelMetaData, bool flush)
 {
-    ImageProcessor proc(pjob, errorCode, pl, tunnelMetaData, flush);
-    return proc();
+    PROFILE_SCOPE("processImage", static_cast<ProcessingJobImpl*>(pjob)->fname);
+    ImageProcessor proc(pjob, errorCode, pl, tunnelMetaData, flush, false);
+    return static_cast<Image16*>(proc());
+}
+
+IImagefloat* processImageFloat (ProcessingJob* pjob, int& errorCode, ProgressListener* pl, bool tunnelMetaData, bool flush)
+{
+    PROFILE_SCOPE("processImage", static_cast<ProcessingJobImpl*>(pjob)->fname);
+    ImageProcessor proc(pjob, errorCode, pl, tunnelMetaData, flush, true);
+    return static_cast<Imagefloat*>(proc());
+}
+
+std::size_t estimateProcessingMemory (const ProcessingJob* pjob)
+{
+    const ProcessingJobImpl* job = static_cast<const ProcessingJobImpl*>(pjob);
+
+    if (!job->initialImage) {
+        return 0;
+    }
+
+    const procparams::ProcParams& params = job->pparams;
+    ImageSource* imgsrc = job->initialImage->getImageSource();
+
+    int fw = 0, fh = 0;
+    imgsrc->getFullSize (fw, fh, getCoarseBitMask(params.coarse));
+
+    const std::size_t pixels = std::size_t(std::max(fw, 0)) * std::size_t(std::max(fh, 0));
+
+    // bytes per pixel of the buffers allocated by ImageProcessor
+    constexpr std::size_t rgbfloat = 3 * sizeof(float); // Imagefloat
+    constexpr std::size_t lab = 3 * sizeof(float);      // LabImage
+    constexpr std::size_t cie = 6 * sizeof(float);      // CieImage
+
+    // raw data, demosaiced planes and the working copies kept by the image source
+    const std::size_t source = imgsrc->isRAW() ? sizeof(unsigned short) + sizeof(float) + rgbfloat : 3 * sizeof(unsigned short);
+
+    // stage_init + stage_denoise + stage_transform: baseImg, the denoise working buffers and the transformed copy
+    std::size_t early = rgbfloat;
+
+    if (params.dirpyrDenoise.enabled) {
+        early += 2 * rgbfloat;
+    }
+
+    if (params.retinex.enabled) {
+        early += 4 * sizeof(float);
+    }
+
+    ImProcFunctions ipf (&params, true);
+
+    if (ipf.needsTransform()) {
+        early += rgbfloat;
+    }
+
+    // rgbProc: baseImg and labView (and the shadows/highlights map) coexist
+    const std::size_t rgbproc = rgbfloat + lab + (params.sh.enabled ? sizeof(float) : 0);
+
+    // Lab stage: labView plus the largest temporary buffer of the enabled tools
+    std::size_t labtemp = 0;
+
+    if (params.sharpening.enabled) {
+        labtemp = std::max(labtemp, sizeof(float));
+    }
+
+    if (params.epd.enabled || params.dirpyrequalizer.enabled) {
+        labtemp = std::max(labtemp, lab);
+    }
+
+    if (params.wavelet.enabled) {
+        labtemp = std::max(labtemp, 2 * lab);
+    }
+
+    if (params.colorappearance.enabled || params.colorappearance.tonecie) {
+        labtemp = std::max(labtemp, cie);
+    }
+
+    const std::size_t peak = std::max({early, rgbproc, lab + labtemp});
+
+    // output: labView, the resized copy (if any) and the Image16 result
+    int imw = fw, imh = fh;
+
+    if (params.resize.enabled) {
+        ipf.resizeScale (&params, fw, fh, imw, imh);
+    }
+
+    const std::size_t outpixels = std::size_t(std::max(imw, 0)) * std::size_t(std::max(imh, 0));
+    const std::size_t output = lab * pixels + (lab + 3 * sizeof(unsigned short)) * outpixels;
+
+    return std::max(peak * pixels, output) + source * pixels;
 }
 
 void batchProcessingThread (ProcessingJob* job, BatchProcessingListener* bpl, bool tunnelMetaData)
 {
+    TaskScheduler::Scope scope(TaskScheduler::Priority::BATCH);
 
     ProcessingJob* currentJob = job;
 
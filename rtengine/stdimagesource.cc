@@ -103,6 +103,12 @@ void StdImageSource::getSampleFormat (const Glib::ustring &fname, IIOSampleForma
  * load the image into it
  */
 int StdImageSource::load (const Glib::ustring &fname, int imageNum, bool batch)
+{
+
+    return loadReduced (fname, 0);
+}
+
+int StdImageSource::loadReduced (const Glib::ustring &fname, int minSize)
 {
 
     fileName = fname;
@@ -148,7 +154,7 @@ int StdImageSource::load (const Glib::ustring &fname, int imageNum, bool batch)
 
     // And load the image!
 
-    int error = img->load (fname);
+    int error = img->load (fname, minSize);
 
     if (error) {
         delete img;
@@ -43,6 +43,8 @@ public:
     ~StdImageSource ();
 
     int         load        (const Glib::ustring &fname, int imageNum = 0, bool batch = false);
+    // for thumbnails: a JPEG file may be decoded at a reduced size, see ImageIO::load()
+    int         loadReduced (const Glib::ustring &fname, int minSize);
     void        getImage    (const ColorTemp &ctemp, int tran, Imagefloat* image, const PreviewProps &pp, const ToneCurveParams &hrp, const ColorManagementParams &cmp, const RAWParams &raw);
     ColorTemp   getWB       () const
     {
@@ -0,0 +1,165 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "taskscheduler.h"
+
+namespace
+{
+
+int getThreadCount()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+void setThreadCount(int count)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(count);
+#endif
+}
+
+}
+
+thread_local rtengine::TaskScheduler::Scope* rtengine::TaskScheduler::current = nullptr;
+
+rtengine::TaskScheduler::Scope::Scope(Priority priority) :
+    outer(current),
+    priority(outer ? outer->priority : priority),
+    threadCount(outer ? outer->threadCount : getThreadCount())
+{
+    TaskScheduler::getInstance().enter(*this);
+    current = this;
+}
+
+rtengine::TaskScheduler::Scope::~Scope()
+{
+    current = outer;
+    TaskScheduler::getInstance().leave(*this);
+}
+
+rtengine::TaskScheduler& rtengine::TaskScheduler::getInstance()
+{
+    static TaskScheduler instance;
+    return instance;
+}
+
+void rtengine::TaskScheduler::checkpoint()
+{
+    if (current) {
+        getInstance().apply(*current);
+    }
+}
+
+rtengine::TaskScheduler::TaskScheduler() :
+    lowPriorityLimit(1)
+{
+    running.fill(0);
+
+#ifdef _OPENMP
+    lowPriorityLimit = std::max(1, omp_get_num_procs() / 4);
+#endif
+}
+
+void rtengine::TaskScheduler::enter(const Scope& scope)
+{
+    if (scope.outer) {
+        apply(scope);
+        return;
+    }
+
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    while (!isAdmitted(scope.priority)) {
+        left.wait(mutex);
+    }
+
+    ++running[static_cast<std::size_t>(scope.priority)];
+    lock.release();
+
+    apply(scope);
+}
+
+void rtengine::TaskScheduler::leave(const Scope& scope)
+{
+    if (scope.outer) {
+        apply(*scope.outer);
+        return;
+    }
+
+    setThreadCount(scope.threadCount);
+
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    --running[static_cast<std::size_t>(scope.priority)];
+    left.broadcast();
+}
+
+void rtengine::TaskScheduler::apply(const Scope& scope) const
+{
+    bool lowered;
+
+    {
+        Glib::Threads::Mutex::Lock lock(mutex);
+        lowered = getHighest() < static_cast<std::size_t>(scope.priority);
+    }
+
+    setThreadCount(lowered ? 1 : scope.threadCount);
+}
+
+std::size_t rtengine::TaskScheduler::getHighest() const
+{
+    std::size_t highest = 0;
+
+    while (highest < priorities && running[highest] == 0) {
+        ++highest;
+    }
+
+    return highest;
+}
+
+bool rtengine::TaskScheduler::isAdmitted(Priority priority) const
+{
+    const std::size_t background = static_cast<std::size_t>(firstBackground);
+
+    // the interactive work never waits, it is only lowered while higher priority work runs
+    if (static_cast<std::size_t>(priority) < background) {
+        return true;
+    }
+
+    const std::size_t highest = getHighest();
+
+    if (highest >= static_cast<std::size_t>(priority)) {
+        return true;
+    }
+
+    unsigned int lower = 0;
+
+    for (std::size_t i = std::max(highest + 1, background); i < priorities; ++i) {
+        lower += running[i];
+    }
+
+    return lower < lowPriorityLimit;
+}
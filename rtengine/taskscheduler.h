@@ -0,0 +1,103 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+
+#include <glibmm.h>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/**
+ * Process wide sharing of the cores between the threads running engine work.
+ *
+ * The preview, the detail crops, the batch queue and the thumbnails are
+ * processed by threads of their own, and each of their OpenMP regions would
+ * use all the cores. A thread running such work opens a TaskScheduler::Scope
+ * with the priority of the work. As long as work of a higher priority runs,
+ * the OpenMP regions started by the thread use a single thread. The
+ * interactive work (preview and detail crops) is always admitted, while at
+ * most a quarter of the cores run background work (batch and thumbnails)
+ * started during higher priority work, the other background scopes waiting to
+ * be admitted. Without higher priority work, a scope keeps the thread count
+ * the thread had before (see omp_set_num_threads()).
+ *
+ * The thread count of a running scope is updated when it opens a nested scope
+ * and by checkpoint(), which long work calls between its stages.
+ */
+class TaskScheduler final :
+    public NonCopyable
+{
+public:
+    // in decreasing priority
+    enum class Priority {
+        PREVIEW,    // ImProcCoordinator::process
+        DETAIL,     // Crop::fullUpdate
+        BATCH,      // batch queue processing
+        THUMBNAIL   // thumbnail and batch queue entry images
+    };
+
+    // the priorities from here on are background work, limited by lowPriorityLimit
+    static constexpr Priority firstBackground = Priority::BATCH;
+
+    class Scope final :
+        public NonCopyable
+    {
+    public:
+        /** Background scopes may wait until they are admitted. A nested scope is part
+          * of the work of the outer one, it keeps its priority and never waits. */
+        explicit Scope(Priority priority);
+        ~Scope();
+
+    private:
+        friend class TaskScheduler;
+
+        Scope* const outer;
+        const Priority priority;
+        const int threadCount;  // of the thread before the scope, restored at its end
+    };
+
+    static TaskScheduler& getInstance();
+
+    /** Updates the thread count of the calling thread if it runs in a scope */
+    static void checkpoint();
+
+private:
+    static constexpr std::size_t priorities = 4;
+
+    TaskScheduler();
+
+    void enter(const Scope& scope);
+    void leave(const Scope& scope);
+    void apply(const Scope& scope) const;
+
+    std::size_t getHighest() const;
+    bool isAdmitted(Priority priority) const;
+
+    static thread_local Scope* current;
+
+    // Glib::Threads::Mutex rather than MyMutex, because it is used with Glib::Threads::Cond
+    mutable Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond left;
+    std::array<unsigned int, priorities> running;
+    unsigned int lowPriorityLimit;
+};
+
+}
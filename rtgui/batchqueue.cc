@@ -33,12 +33,25 @@
 #include "batchqueuebuttonset.h"
 #include "guiutils.h"
 #include "rtimage.h"
+#include "../rtengine/imagewriter.h"
+#include "../rtengine/taskscheduler.h"
 #include <sys/time.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 using namespace rtengine;
 
-BatchQueue::BatchQueue (FileCatalog* aFileCatalog) : processing(nullptr), fileCatalog(aFileCatalog), sequence(0), listener(nullptr)
+BatchQueue::BatchQueue (FileCatalog* aFileCatalog) :
+    fileCatalog(aFileCatalog),
+    sequence(0),
+    listener(nullptr),
+    jobsRunning(0),
+    memoryUsed(0),
+    writer(new rtengine::ImageWriter (std::max (options.batchQueueJobs, 1), std::max (options.batchQueueJobs, 1))),
+    stopping(false)
 {
 
     location = THLOC_BATCHQUEUE;
@@ -85,6 +98,29 @@ BatchQueue::BatchQueue (FileCatalog* aFileCatalog) : processing(nullptr), fileCa
 
 BatchQueue::~BatchQueue ()
 {
+    // the entries finishing from now on do not start the next ones, nor call the listener which may be gone
+    stopping = true;
+
+    // waits for the entries being processed
+    for (;;) {
+        {
+            Glib::Threads::Mutex::Lock lock (slotMutex);
+
+            if (workers.empty ()) {
+                break;
+            }
+
+            while (finishedWorkers.empty ()) {
+                workerFinished.wait (slotMutex);
+            }
+        }
+
+        joinFinishedWorkers ();
+    }
+
+    // writes the images processed already
+    writer.reset ();
+
     idle_register.destroy();
 
     MYWRITERLOCK(l, entryRW);
@@ -227,7 +263,7 @@ bool BatchQueue::saveBatchQueue ()
 
         // The column's header is mandatory (the first line will be skipped when loaded)
         file << "input image full path|param file full path|output image full path|file format|jpeg quality|jpeg subsampling|"
-             << "png bit depth|png compression|tiff bit depth|uncompressed tiff|save output params|force format options|fast export|<end of line>"
+             << "png bit depth|png compression|tiff bit depth|uncompressed tiff|save output params|force format options|fast export|float tiff|<end of line>"
              << std::endl;
 
         // method is already running with entryLock, so no need to lock again
@@ -242,7 +278,7 @@ bool BatchQueue::saveBatchQueue ()
                  << saveFormat.pngBits << '|' << saveFormat.pngCompression << '|'
                  << saveFormat.tiffBits << '|'  << saveFormat.tiffUncompressed << '|'
                  << saveFormat.saveParams << '|' << entry->forceFormatOpts << '|'
-                 << entry->job->fastPipeline() << '|'
+                 << entry->job->fastPipeline() << '|' << saveFormat.tiffFloat << '|'
                  << std::endl;
         }
     }
@@ -310,6 +346,7 @@ bool BatchQueue::loadBatchQueue ()
             const auto saveParams = nextIntOr (options.saveFormat.saveParams);
             const auto forceFormatOpts = nextIntOr (options.forceFormatOpts);
             const auto fast = nextIntOr(false);
+            const auto tiffFloat = nextIntOr (options.saveFormat.tiffFloat);
 
             rtengine::procparams::ProcParams pparams;
 
@@ -349,6 +386,8 @@ bool BatchQueue::loadBatchQueue ()
                 saveFormat.pngCompression = pngCompression;
                 saveFormat.tiffBits = tiffBits;
                 saveFormat.tiffUncompressed = tiffUncompressed != 0;
+                saveFormat.tiffFloat = tiffFloat != 0;
+                saveFormat.checkTiffFloat ();
                 saveFormat.saveParams = saveParams != 0;
                 entry->forceFormatOpts = forceFormatOpts != 0;
             } else {
@@ -536,147 +575,328 @@ void BatchQueue::openItemInEditor(ThumbBrowserEntryBase* item)
 }
 
 
-void BatchQueue::startProcessing ()
+class BatchQueue::JobProgress :
+    public rtengine::ProgressListener
+{
+public:
+    JobProgress (BatchQueue* queue, BatchQueueEntry* entry) : queue(queue), entry(entry) {}
+
+    void setProgress (double p)
+    {
+        queue->setProgress (entry, p);
+    }
+
+private:
+    BatchQueue* const queue;
+    BatchQueueEntry* const entry;
+};
+
+void BatchQueue::startProcessing (bool restart)
 {
+    std::vector<StartedEntry> started;
+    std::vector<Glib::ustring> prefetch;
 
-    if (!processing) {
+    {
         MYWRITERLOCK(l, entryRW);
 
-        if (!fd.empty()) {
-            BatchQueueEntry* next;
+        if (processing.empty()) {
+            sequence = 0;
+        }
 
-            next = static_cast<BatchQueueEntry*>(fd[0]);
-            // tag it as processing and set sequence
-            next->processing = true;
-            next->sequence = sequence = 1;
-            processing = next;
+        if (restart) {
+            for (const auto entry : fd) {
+                static_cast<BatchQueueEntry*>(entry)->failed = false;
+            }
+        }
 
-            // remove from selection
-            if (processing->selected) {
-                std::vector<ThumbBrowserEntryBase*>::iterator pos = std::find (selected.begin(), selected.end(), processing);
+        startEntries (started, prefetch);
+    }
 
-                if (pos != selected.end()) {
-                    selected.erase (pos);
-                }
+    rtengine::prefetchFiles (prefetch);
+
+    for (const auto& entry : started) {
+        // remove button set
+        entry.first->removeButtonSet ();
+    }
+
+    runEntries (started);
+
+    if (!started.empty()) {
+        queue_draw ();
+    }
+}
+
+void BatchQueue::startEntries (std::vector<StartedEntry>& started, std::vector<Glib::ustring>& prefetch)
+{
+    // one more entry than the number of jobs, to be loaded ahead
+    const std::size_t slots = std::max (options.batchQueueJobs, 1) + 1;
+    const bool wasIdle = processing.empty();
+    std::size_t last = 0;
+
+    for (std::size_t i = 0; i < fd.size() && processing.size() < slots; ++i) {
+        BatchQueueEntry* next = static_cast<BatchQueueEntry*>(fd[i]);
+
+        if (next->processing || next->failed) {
+            continue;
+        }
+
+        // tag it as processing and set sequence
+        next->processing = true;
+        next->sequence = ++sequence;
+        processing.push_back (next);
 
-                processing->selected = false;
+        // the entry keeps a job of its own, to be saved with the queue and to be started again after an error
+        rtengine::ProcessingJob* job = next->job;
+        next->job = rtengine::ProcessingJob::create (next->filename, next->thumbnail->getType () == FT_Raw, next->params, job->fastPipeline ());
+        started.emplace_back (next, job);
+
+        // remove from selection
+        if (next->selected) {
+            std::vector<ThumbBrowserEntryBase*>::iterator pos = std::find (selected.begin(), selected.end(), next);
+
+            if (pos != selected.end()) {
+                selected.erase (pos);
             }
 
-            MYWRITERLOCK_RELEASE(l);
+            next->selected = false;
+        }
+
+        if (!wasIdle && options.rtSettings.inputPrefetch > 0) {
+            // the files before the last one of the read ahead window have been read ahead already
+            addInputFiles (i + options.rtSettings.inputPrefetch, i + options.rtSettings.inputPrefetch + 1, prefetch);
+        }
+
+        last = i;
+    }
+
+    if (wasIdle && !started.empty()) {
+        // read the next files ahead while these ones are processed
+        addInputFiles (last + 1, last + 1 + std::max (options.rtSettings.inputPrefetch, 0), prefetch);
+    }
+}
+
+void BatchQueue::runEntries (const std::vector<StartedEntry>& started)
+{
+    joinFinishedWorkers ();
+
+    // the lock is held until the thread is registered, before it can finish
+    Glib::Threads::Mutex::Lock lock (slotMutex);
+
+    for (const auto& entry : started) {
+        workers.push_back (Glib::Threads::Thread::create (sigc::bind (sigc::mem_fun (*this, &BatchQueue::runEntry), entry.first, entry.second)));
+    }
+}
+
+void BatchQueue::runEntry (BatchQueueEntry* entry, rtengine::ProcessingJob* job)
+{
+    processEntry (entry, job);
+
+    Glib::Threads::Mutex::Lock lock (slotMutex);
+    finishedWorkers.push_back (Glib::Threads::Thread::self ());
+    workerFinished.broadcast ();
+}
+
+void BatchQueue::joinFinishedWorkers ()
+{
+    std::vector<Glib::Threads::Thread*> finished;
+
+    {
+        Glib::Threads::Mutex::Lock lock (slotMutex);
+        finished.swap (finishedWorkers);
+
+        for (const auto thread : finished) {
+            workers.erase (std::find (workers.begin (), workers.end (), thread));
+        }
+    }
+
+    // they have returned from processEntry already
+    for (const auto thread : finished) {
+        thread->join ();
+    }
+}
+
+void BatchQueue::processEntry (BatchQueueEntry* entry, rtengine::ProcessingJob* job)
+{
+    const unsigned int jobs = std::max (options.batchQueueJobs, 1);
+    const std::size_t budget = std::size_t (std::max (options.batchQueueMemoryBudget, 0)) << 20;
+
+#ifdef _OPENMP
+    // the number of threads is a per-thread setting, it has to be set in the worker thread
+    omp_set_num_threads (std::max (omp_get_num_procs () / int (jobs), 1));
+#endif
+
+    rtengine::TaskScheduler::Scope scope (rtengine::TaskScheduler::Priority::BATCH);
+
+    int errorCode;
+
+    if (!rtengine::loadProcessingJobImage (job, errorCode)) {
+        rtengine::ProcessingJob::destroy (job);
+        error (entry, M("MAIN_MSG_CANNOTLOAD"));
+        return;
+    }
+
+    // a job is always admitted when no other one is processed
+    const std::size_t memory = rtengine::estimateProcessingMemory (job);
 
-            // remove button set
-            next->removeButtonSet ();
+    {
+        Glib::Threads::Mutex::Lock lock (slotMutex);
 
-            // start batch processing
-            rtengine::startBatchProcessing (next->job, this, options.tunnelMetaData);
-            queue_draw ();
+        while (jobsRunning > 0 && (jobsRunning >= jobs || (budget > 0 && memoryUsed + memory > budget))) {
+            slotFreed.wait (slotMutex);
         }
+
+        ++jobsRunning;
+        memoryUsed += memory;
+    }
+
+    const auto releaseSlot = [this, memory]() {
+        Glib::Threads::Mutex::Lock lock (slotMutex);
+        --jobsRunning;
+        memoryUsed -= memory;
+        slotFreed.broadcast ();
+    };
+
+    if (stopping || (listener && !listener->canStartNext ())) {
+        // the queue has been stopped while the image was loaded ahead
+        releaseSlot ();
+        rtengine::ProcessingJob::destroy (job);
+        requeueEntry (entry);
+        return;
     }
+
+    JobProgress progress (this, entry);
+    const SaveFormat saveFormat = getSaveFormat (entry);
+    rtengine::IImage* img;
+
+    if (saveFormat.format == "tif" && saveFormat.tiffFloat) {
+        img = rtengine::processImageFloat (job, errorCode, &progress, options.tunnelMetaData, true);
+    } else {
+        img = rtengine::processImage (job, errorCode, &progress, options.tunnelMetaData, true);
+    }
+
+    releaseSlot ();
+
+    if (!img) {
+        error (entry, M("MAIN_MSG_CANNOTLOAD"));
+        return;
+    }
+
+    // the image is encoded and written while the next entries are processed
+    writer->push (img, [this, entry, saveFormat](rtengine::IImage* img) {
+        try {
+            saveEntry (entry, saveFormat, img);
+        } catch (Glib::Exception& ex) {
+            error (entry, ex.what ());
+            return;
+        }
+
+        finishEntry (entry);
+    });
 }
 
-rtengine::ProcessingJob* BatchQueue::imageReady (rtengine::IImage16* img)
+SaveFormat BatchQueue::getSaveFormat (const BatchQueueEntry* entry) const
+{
+    if (entry->outFileName != "" && entry->forceFormatOpts) {
+        return entry->saveFormat;
+    } else {
+        return options.saveFormatBatch;
+    }
+}
+
+void BatchQueue::saveEntry (BatchQueueEntry* entry, const SaveFormat& saveFormat, rtengine::IImage* img)
 {
 
     // save image img
     Glib::ustring fname;
-    SaveFormat saveFormat;
 
-    if (processing->outFileName == "") { // auto file name
-        Glib::ustring s = calcAutoFileNameBase (processing->filename, processing->sequence);
-        saveFormat = options.saveFormatBatch;
+    if (entry->outFileName == "") { // auto file name
+        Glib::ustring s = calcAutoFileNameBase (entry->filename, entry->sequence);
         fname = autoCompleteFileName (s, saveFormat.format);
     } else { // use the save-as filename with automatic completion for uniqueness
-        if (processing->forceFormatOpts) {
-            saveFormat = processing->saveFormat;
-        } else {
-            saveFormat = options.saveFormatBatch;
-        }
-
         // The output filename's extension is forced to the current or selected output format,
         // despite what the user have set in the fielneame's field of the "Save as" dialgo box
-        fname = autoCompleteFileName (removeExtension(processing->outFileName), saveFormat.format);
-        //fname = autoCompleteFileName (removeExtension(processing->outFileName), getExtension(processing->outFileName));
+        fname = autoCompleteFileName (removeExtension(entry->outFileName), saveFormat.format);
+        //fname = autoCompleteFileName (removeExtension(entry->outFileName), getExtension(entry->outFileName));
     }
 
     //printf ("fname=%s, %s\n", fname.c_str(), removeExtension(fname).c_str());
 
-    if (img && fname != "") {
-        int err = 0;
+    if (fname == "") {
+        return;
+    }
 
-        if (saveFormat.format == "tif") {
-            err = img->saveAsTIFF (fname, saveFormat.tiffBits, saveFormat.tiffUncompressed);
-        } else if (saveFormat.format == "png") {
-            err = img->saveAsPNG (fname, saveFormat.pngCompression, saveFormat.pngBits);
-        } else if (saveFormat.format == "jpg") {
-            err = img->saveAsJPEG (fname, saveFormat.jpegQuality, saveFormat.jpegSubSamp);
-        }
+    int err = 0;
 
-        img->free ();
+    if (saveFormat.format == "tif") {
+        err = img->saveAsTIFF (fname, saveFormat.tiffBits, saveFormat.tiffUncompressed, saveFormat.tiffFloat);
+    } else if (saveFormat.format == "png") {
+        err = img->saveAsPNG (fname, saveFormat.pngCompression, saveFormat.pngBits);
+    } else if (saveFormat.format == "jpg") {
+        err = img->saveAsJPEG (fname, saveFormat.jpegQuality, saveFormat.jpegSubSamp);
+    }
 
-        if (err) {
-            throw Glib::FileError(Glib::FileError::FAILED, M("MAIN_MSG_CANNOTSAVE") + "\n" + fname);
-        }
+    {
+        Glib::Threads::Mutex::Lock lock (slotMutex);
+        outputFiles.erase (fname);
+    }
 
-        if (saveFormat.saveParams) {
-            // We keep the extension to avoid overwriting the profile when we have
-            // the same output filename with different extension
-            //processing->params.save (removeExtension(fname) + paramFileExtension);
-            processing->params.save (fname + ".out" + paramFileExtension);
-        }
+    if (err) {
+        throw Glib::FileError(Glib::FileError::FAILED, M("MAIN_MSG_CANNOTSAVE") + "\n" + fname);
+    }
 
-        if (processing->thumbnail) {
-            processing->thumbnail->imageDeveloped ();
-            processing->thumbnail->imageRemovedFromQueue ();
-        }
+    if (saveFormat.saveParams) {
+        // We keep the extension to avoid overwriting the profile when we have
+        // the same output filename with different extension
+        //entry->params.save (removeExtension(fname) + paramFileExtension);
+        entry->params.save (fname + ".out" + paramFileExtension);
     }
 
+    if (entry->thumbnail) {
+        entry->thumbnail->imageDeveloped ();
+        entry->thumbnail->imageRemovedFromQueue ();
+    }
+}
+
+void BatchQueue::finishEntry (BatchQueueEntry* entry)
+{
     // save temporary params file name: delete as last thing
-    Glib::ustring processedParams = processing->savedParamsFile;
+    Glib::ustring processedParams = entry->savedParamsFile;
 
     // delete from the queue
     bool queueEmptied = false;
-    bool remove_button_set = false;
+    std::vector<StartedEntry> started;
+    std::vector<Glib::ustring> prefetch;
 
     {
         MYWRITERLOCK(l, entryRW);
 
-        delete processing;
-        processing = nullptr;
+        processing.erase (std::find (processing.begin (), processing.end (), entry));
+        fd.erase (std::find (fd.begin (), fd.end (), entry));
 
-        fd.erase (fd.begin());
+        rtengine::ProcessingJob::destroy (entry->job);
+        delete entry;
 
-        // return next job
+        // start the next jobs
         if (fd.empty()) {
             queueEmptied = true;
-        } else if (listener && listener->canStartNext ()) {
-            BatchQueueEntry* next = static_cast<BatchQueueEntry*>(fd[0]);
-            // tag it as selected and set sequence
-            next->processing = true;
-            next->sequence = ++sequence;
-            processing = next;
-
-            // remove from selection
-            if (processing->selected) {
-                std::vector<ThumbBrowserEntryBase*>::iterator pos = std::find (selected.begin(), selected.end(), processing);
-
-                if (pos != selected.end()) {
-                    selected.erase (pos);
-                }
-
-                processing->selected = false;
-            }
-
-            // remove button set
-            remove_button_set = true;
+        } else if (!stopping && listener && listener->canStartNext ()) {
+            startEntries (started, prefetch);
         }
     }
 
-    if (remove_button_set) {
+    rtengine::prefetchFiles (prefetch);
+
+    if (!started.empty()) {
         // ButtonSet have Cairo::Surface which might be rendered while we're trying to delete them
         GThreadLock lock;
-        processing->removeButtonSet ();
+
+        for (const auto& next : started) {
+            next.first->removeButtonSet ();
+        }
     }
 
+    runEntries (started);
+
     if (saveBatchQueue ()) {
         ::g_remove (processedParams.c_str ());
 
@@ -705,10 +925,17 @@ rtengine::ProcessingJob* BatchQueue::imageReady (rtengine::IImage16* img)
         }
     }
 
-    redraw ();
-    notifyListener (queueEmptied);
+    if (!stopping) {
+        redraw ();
+        notifyListener (queueEmptied);
+    }
+}
 
-    return processing ? processing->job : nullptr;
+void BatchQueue::addInputFiles (std::size_t first, std::size_t last, std::vector<Glib::ustring>& fnames) const
+{
+    for (std::size_t i = first; i < last && i < fd.size(); ++i) {
+        fnames.push_back (fd[i]->filename);
+    }
 }
 
 // Calculates automatic filename of processed batch entry, but just the base name
@@ -855,6 +1082,9 @@ Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, c
     // if that's not possible (e.g. locked by viewer, R/O), we revert to the standard naming scheme
     bool inOverwriteMode = options.overwriteOutputFile;
 
+    // the file names chosen by the other jobs are reserved until their images are saved
+    Glib::Threads::Mutex::Lock lock (slotMutex);
+
     for (int tries = 0; tries < 100; tries++) {
         if (tries == 0) {
             fname = Glib::ustring::compose ("%1.%2", Glib::build_filename (dstdir,  dstfname), format);
@@ -862,6 +1092,10 @@ Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, c
             fname = Glib::ustring::compose ("%1-%2.%3", Glib::build_filename (dstdir,  dstfname), tries, format);
         }
 
+        if (outputFiles.count (fname)) {
+            continue;
+        }
+
         int fileExists = Glib::file_test (fname, Glib::FILE_TEST_EXISTS);
 
         if (inOverwriteMode && fileExists) {
@@ -873,6 +1107,7 @@ Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, c
         }
 
         if (!fileExists) {
+            outputFiles.insert (fname);
             return fname;
         }
     }
@@ -880,11 +1115,13 @@ Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, c
     return "";
 }
 
-void BatchQueue::setProgress (double p)
+void BatchQueue::setProgress (BatchQueueEntry* entry, double p)
 {
 
-    if (processing) {
-        processing->progress = p;
+    entry->progress = p;
+
+    if (stopping) {
+        return;
     }
 
     // No need to acquire the GUI, setProgressUI will do it
@@ -949,21 +1186,38 @@ void BatchQueue::redrawNeeded (LWButton* button)
     queue_draw ();
 }
 
-void BatchQueue::error (Glib::ustring msg)
+void BatchQueue::requeueEntry (BatchQueueEntry* entry)
 {
+    {
+        MYWRITERLOCK(l, entryRW);
 
-    if (processing && processing->processing) {
-        // restore failed thumb
-        BatchQueueButtonSet* bqbs = new BatchQueueButtonSet (processing);
-        bqbs->setButtonListener (this);
-        processing->addButtonSet (bqbs);
-        processing->processing = false;
-        processing->job = rtengine::ProcessingJob::create(processing->filename, processing->thumbnail->getType() == FT_Raw, processing->params);
-        processing = nullptr;
-        redraw ();
+        processing.erase (std::find (processing.begin (), processing.end (), entry));
+        entry->processing = false;
+        entry->progress = 0.0;
     }
 
-    if (listener) {
+    if (stopping) {
+        return;
+    }
+
+    // restore failed thumb
+    BatchQueueButtonSet* bqbs = new BatchQueueButtonSet (entry);
+    bqbs->setButtonListener (this);
+    entry->addButtonSet (bqbs);
+    redraw ();
+}
+
+void BatchQueue::error (BatchQueueEntry* entry, const Glib::ustring& msg)
+{
+
+    {
+        MYWRITERLOCK(l, entryRW);
+        entry->failed = true;
+    }
+
+    requeueEntry (entry);
+
+    if (listener && !stopping) {
         NLParams* params = new NLParams;
         params->listener = listener;
         params->queueEmptied = false;
@@ -18,6 +18,12 @@
 #ifndef _BATCHQUEUE_
 #define _BATCHQUEUE_
 
+#include <atomic>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
 #include <gtkmm.h>
 #include "threadutils.h"
 #include "batchqueueentry.h"
@@ -37,9 +43,21 @@ public:
 
 class FileCatalog;
 
+namespace rtengine
+{
+class ImageWriter;
+}
+
+/**
+ * The batch queue processes up to options.batchQueueJobs entries at once, each in a thread of its own,
+ * provided that their estimated memory usage fits in options.batchQueueMemoryBudget. One more entry is
+ * started ahead: its image is loaded and decoded while the others are processed, then it waits for a slot.
+ * The entries being loaded or processed are the first ones of the queue, sequence numbers are given in
+ * queue order when they are started. The processed images are saved by an ImageWriter, which frees
+ * their slot for the next entries. The entries which failed are skipped until the user restarts the queue.
+ */
 class BatchQueue final :
     public ThumbBrowserBase,
-    public rtengine::BatchProcessingListener,
     public LWButtonListener
 {
 public:
@@ -54,7 +72,8 @@ public:
     void openItemInEditor(ThumbBrowserEntryBase* item);
     void openLastSelectedItemInEditor();
 
-    void startProcessing ();
+    // starts the entries fitting in the free slots, the failed ones too if restart is set
+    void startProcessing (bool restart = false);
 
     bool hasJobs ()
     {
@@ -62,9 +81,6 @@ public:
         return (!fd.empty());
     }
 
-    rtengine::ProcessingJob* imageReady (rtengine::IImage16* img);
-    void error (Glib::ustring msg);
-    void setProgress (double p);
     void rightClicked (ThumbBrowserEntryBase* entry);
     void doubleClicked (ThumbBrowserEntryBase* entry);
     bool keyPressed (GdkEventKey* event);
@@ -91,8 +107,32 @@ protected:
     Glib::ustring getTempFilenameForParams( const Glib::ustring &filename );
     bool saveBatchQueue ();
     void notifyListener (bool queueEmptied);
-
-    BatchQueueEntry* processing;  // holds the currently processed image
+    // adds the file names of the entries first to last - 1 (if present) to fnames, entryRW has to be locked
+    void addInputFiles (std::size_t first, std::size_t last, std::vector<Glib::ustring>& fnames) const;
+
+    class JobProgress;
+
+    // an entry started, and the job it is processed with
+    using StartedEntry = std::pair<BatchQueueEntry*, rtengine::ProcessingJob*>;
+
+    // starts the next entries as long as there are free slots, entryRW has to be locked
+    void startEntries (std::vector<StartedEntry>& started, std::vector<Glib::ustring>& prefetch);
+    void runEntries (const std::vector<StartedEntry>& started);
+    // the thread function of an entry
+    void runEntry (BatchQueueEntry* entry, rtengine::ProcessingJob* job);
+    void joinFinishedWorkers ();
+    void processEntry (BatchQueueEntry* entry, rtengine::ProcessingJob* job);
+    // the output format of an entry, chosen when its processing starts
+    SaveFormat getSaveFormat (const BatchQueueEntry* entry) const;
+    // runs on the writer threads, throws Glib::FileError if the image can not be saved
+    void saveEntry (BatchQueueEntry* entry, const SaveFormat& saveFormat, rtengine::IImage* img);
+    void finishEntry (BatchQueueEntry* entry);
+    // puts back an entry which has not been processed, to be started again
+    void requeueEntry (BatchQueueEntry* entry);
+    void error (BatchQueueEntry* entry, const Glib::ustring& msg);
+    void setProgress (BatchQueueEntry* entry, double p);
+
+    std::vector<BatchQueueEntry*> processing;  // the entries being loaded or processed, protected by entryRW
     FileCatalog* fileCatalog;
     int sequence; // holds the current sequence index
 
@@ -108,6 +148,19 @@ protected:
 
     BatchQueueListener* listener;
 
+    // Glib::Threads::Mutex rather than MyMutex, because it is used with Glib::Threads::Cond
+    Glib::Threads::Mutex slotMutex;
+    Glib::Threads::Cond slotFreed;
+    unsigned int jobsRunning;               // entries being processed, protected by slotMutex
+    std::size_t memoryUsed;                 // their estimated memory usage
+    std::set<Glib::ustring> outputFiles;    // the files being written
+    std::vector<Glib::Threads::Thread*> workers;            // the threads processing the entries
+    std::vector<Glib::Threads::Thread*> finishedWorkers;    // the ones done, to be joined
+    Glib::Threads::Cond workerFinished;
+
+    std::unique_ptr<rtengine::ImageWriter> writer;
+    std::atomic<bool> stopping;     // set by the destructor: no more entries are started, the GUI is left alone
+
     IdleRegister idle_register;
 };
 
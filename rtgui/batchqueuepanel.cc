@@ -285,7 +285,7 @@ void BatchQueuePanel::startBatchProc ()
         fdir->set_sensitive (false);
         fformat->set_sensitive (false);
         saveOptions();
-        batchQueue->startProcessing ();
+        batchQueue->startProcessing (true);
     } else {
         stopBatchProc ();
     }
@@ -312,6 +312,9 @@ void BatchQueuePanel::addBatchQueueJobs ( std::vector<BatchQueueEntry*> &entries
 
     if (stop->get_active () && autoStart->get_active ()) {
         startBatchProc ();
+    } else if (start->get_active ()) {
+        // fills the slots left free
+        batchQueue->startProcessing ();
     }
 }
 
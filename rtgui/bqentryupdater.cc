@@ -19,6 +19,7 @@
 #include "bqentryupdater.h"
 #include <gtkmm.h>
 #include "guiutils.h"
+#include "../rtengine/taskscheduler.h"
 
 BatchQueueEntryUpdater batchQueueEntryUpdater;
 
@@ -111,6 +112,7 @@ void BatchQueueEntryUpdater::processThread ()
 
         if (current.thumbnail && current.pparams) {
             // the thumbnail and the pparams are provided, it means that we have to build the original preview image
+            rtengine::TaskScheduler::Scope scope(rtengine::TaskScheduler::Priority::THUMBNAIL);
             double tmpscale;
             img = current.thumbnail->processThumbImage (*current.pparams, current.oh, tmpscale);
 
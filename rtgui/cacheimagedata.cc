@@ -18,7 +18,6 @@
  */
 #include "cacheimagedata.h"
 #include <vector>
-#include <glib/gstdio.h>
 #include "version.h"
 #include <locale.h>
 
@@ -31,16 +30,16 @@ CacheImageData::CacheImageData ()
 }
 
 /*
- * Load the General, DateTime, ExifInfo, File info and ExtraRawInfo sections of the image data file
+ * Load the General, DateTime, ExifInfo, File info and ExtraRawInfo sections of the image data record
  */
-int CacheImageData::load (const Glib::ustring& fname)
+int CacheImageData::load (const char* data, std::size_t size)
 {
     setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
 
     Glib::KeyFile keyFile;
 
     try {
-        if (keyFile.load_from_file (fname)) {
+        if (keyFile.load_from_data (std::string (data, size))) {
 
             if (keyFile.has_group ("General")) {
                 if (keyFile.has_key ("General", "MD5")) {
@@ -175,11 +174,11 @@ int CacheImageData::load (const Glib::ustring& fname)
         }
     } catch (Glib::Error &err) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::load / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("CacheImageData::load / Error code %d while reading values of \"%s\":\n%s\n", err.code(), md5.c_str(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::load / Unknown exception while trying to load \"%s\"!\n", fname.c_str());
+            printf("CacheImageData::load / Unknown exception while trying to load \"%s\"!\n", md5.c_str());
         }
     }
 
@@ -187,9 +186,9 @@ int CacheImageData::load (const Glib::ustring& fname)
 }
 
 /*
- * Save the General, DateTime, ExifInfo, File info and ExtraRawInfo sections of the image data file
+ * Save the General, DateTime, ExifInfo, File info and ExtraRawInfo sections of the image data record
  */
-int CacheImageData::save (const Glib::ustring& fname)
+int CacheImageData::save (std::string& data)
 {
 
     Glib::ustring keyData;
@@ -199,7 +198,7 @@ int CacheImageData::save (const Glib::ustring& fname)
     Glib::KeyFile keyFile;
 
     try {
-        keyFile.load_from_file (fname);
+        keyFile.load_from_data (data);
     } catch (Glib::Error&) {}
 
     keyFile.set_string  ("General", "MD5", md5);
@@ -251,11 +250,11 @@ int CacheImageData::save (const Glib::ustring& fname)
 
     } catch (Glib::Error &err) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::save / Error code %d while reading values from \"%s\":\n%s\n", err.code(), fname.c_str(), err.what().c_str());
+            printf("CacheImageData::save / Error code %d while reading values of \"%s\":\n%s\n", err.code(), md5.c_str(), err.what().c_str());
         }
     } catch (...) {
         if (options.rtSettings.verbose) {
-            printf("CacheImageData::save / Unknown exception while trying to save \"%s\"!\n", fname.c_str());
+            printf("CacheImageData::save / Unknown exception while trying to save \"%s\"!\n", md5.c_str());
         }
     }
 
@@ -263,18 +262,6 @@ int CacheImageData::save (const Glib::ustring& fname)
         return 1;
     }
 
-    FILE *f = g_fopen (fname.c_str (), "wt");
-
-    if (!f) {
-        if (options.rtSettings.verbose) {
-            printf("CacheImageData::save / Error: unable to open file \"%s\" with write access!\n", fname.c_str());
-        }
-
-        return 1;
-    } else {
-        fprintf (f, "%s", keyData.c_str ());
-        fclose (f);
-        return 0;
-    }
+    data = keyData;
+    return 0;
 }
-
@@ -19,6 +19,8 @@
 #ifndef _CACHEIMAGEDATA_
 #define _CACHEIMAGEDATA_
 
+#include <cstddef>
+#include <string>
 #include <glibmm.h>
 #include "options.h"
 
@@ -73,8 +75,10 @@ public:
 
     CacheImageData ();
 
-    int load (const Glib::ustring& fname);
-    int save (const Glib::ustring& fname);
+    // the image data record of the thumbnail cache, see CacheStore::Kind::DATA
+    int load (const char* data, std::size_t size);
+    // data holds the current record, which is updated
+    int save (std::string& data);
 
     Glib::ustring getCamera() const
     {
@@ -37,7 +37,10 @@ namespace
 {
 
 constexpr int cacheDirMode = 0777;
-constexpr const char* cacheDirs[] = { "profiles", "images", "aehistograms", "embprofiles", "data" };
+constexpr const char* storeName = "thumbnails.db";
+
+// One file per record in older versions, replaced by CacheStore
+constexpr const char* oldCacheDirs[] = { "images", "aehistograms", "embprofiles", "data" };
 
 }
 
@@ -55,17 +58,22 @@ void CacheManager::init ()
     baseDir = options.cacheBaseDir;
 
     auto error = g_mkdir_with_parents (baseDir.c_str(), cacheDirMode);
-
-    for (const auto& cacheDir : cacheDirs) {
-        error |= g_mkdir_with_parents (Glib::build_filename (baseDir, cacheDir).c_str(), cacheDirMode);
-    }
+    error |= g_mkdir_with_parents (Glib::build_filename (baseDir, "profiles").c_str(), cacheDirMode);
 
     if (error != 0 && options.rtSettings.verbose) {
         std::cerr << "Failed to create all cache directories: " << g_strerror(errno) << std::endl;
     }
+
+    if (!store.open (Glib::build_filename (baseDir, storeName)) && options.rtSettings.verbose) {
+        std::cerr << "Failed to open the thumbnail cache '" << Glib::build_filename (baseDir, storeName) << "'" << std::endl;
+    }
+
+    if (store.isNew ()) {
+        migrateCache ();
+    }
 }
 
-Thumbnail* CacheManager::getEntry (const Glib::ustring& fname)
+Thumbnail* CacheManager::getEntry (const Glib::ustring& fname, bool generate)
 {
     std::unique_ptr<Thumbnail> thumbnail;
 
@@ -93,13 +101,13 @@ Thumbnail* CacheManager::getEntry (const Glib::ustring& fname)
         return nullptr;
     }
 
-    const auto cacheName = getCacheFileName ("data", fname, ".txt", md5);
-
     // let's see if we have it in the cache
-    {
+    const auto data = store.get (md5, CacheStore::Kind::DATA);
+
+    if (data) {
         CacheImageData imageData;
 
-        const auto error = imageData.load (cacheName);
+        const auto error = imageData.load (data.data (), data.size ());
         if (error == 0 && imageData.supported) {
 
             thumbnail.reset (new Thumbnail (this, fname, &imageData));
@@ -110,7 +118,7 @@ Thumbnail* CacheManager::getEntry (const Glib::ustring& fname)
     }
 
     // if not, create a new one
-    if (!thumbnail) {
+    if (!thumbnail && generate) {
 
         thumbnail.reset (new Thumbnail (this, fname, md5));
         if (!thumbnail->isSupported ()) {
@@ -170,7 +178,7 @@ void CacheManager::deleteEntry (const Glib::ustring& fname)
     }
 }
 
-void CacheManager::clearFromCache (const Glib::ustring& fname, bool purge) const
+void CacheManager::clearFromCache (const Glib::ustring& fname, bool purge)
 {
     deleteFiles (fname, getMD5 (fname), purge, purge);
 }
@@ -181,14 +189,8 @@ void CacheManager::renameEntry (const std::string& oldfilename, const std::strin
 
     const auto newmd5 = getMD5 (newfilename);
 
-    auto error = g_rename (getCacheFileName ("profiles", oldfilename, paramFileExtension, oldmd5).c_str (), getCacheFileName ("profiles", newfilename, paramFileExtension, newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".rtti", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".rtti", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".cust16", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".cust16", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".cust", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".cust", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".jpg", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".jpg", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("aehistograms", oldfilename, "", oldmd5).c_str (), getCacheFileName ("aehistograms", newfilename, "", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("embprofiles", oldfilename, ".icc", oldmd5).c_str (), getCacheFileName ("embprofiles", newfilename, ".icc", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("data", oldfilename, ".txt", oldmd5).c_str (), getCacheFileName ("data", newfilename, ".txt", newmd5).c_str ());
+    const auto error = g_rename (getCacheFileName ("profiles", oldfilename, paramFileExtension, oldmd5).c_str (), getCacheFileName ("profiles", newfilename, paramFileExtension, newmd5).c_str ());
+    store.rename (oldmd5, newmd5);
 
     if (error != 0 && options.rtSettings.verbose) {
         std::cerr << "Failed to rename all files for cache entry '" << oldfilename << "': " << g_strerror(errno) << std::endl;
@@ -218,29 +220,27 @@ void CacheManager::closeThumbnail (Thumbnail* thumbnail)
     delete thumbnail;
 }
 
-void CacheManager::closeCache () const
+void CacheManager::closeCache ()
 {
     MyMutex::MyLock lock (mutex);
 
-    applyCacheSizeLimitation ();
+    store.limit (options.maxCacheEntries);
+    store.flush ();
 }
 
-void CacheManager::clearAll () const
+void CacheManager::clearAll ()
 {
     MyMutex::MyLock lock (mutex);
 
-    for (const auto& cacheDir : cacheDirs) {
-        deleteDir (cacheDir);
-    }
+    deleteDir ("profiles");
+    store.clear (true);
 }
 
-void CacheManager::clearImages () const
+void CacheManager::clearImages ()
 {
     MyMutex::MyLock lock (mutex);
 
-    deleteDir ("images");
-    deleteDir ("aehistograms");
-    deleteDir ("embprofiles");
+    store.clear (false);
 }
 
 void CacheManager::clearProfiles () const
@@ -268,29 +268,16 @@ void CacheManager::deleteDir (const Glib::ustring& dirName) const
     } catch (Glib::Error&) {}
 }
 
-void CacheManager::deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile) const
+void CacheManager::deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile)
 {
     if (md5.empty ()) {
         return;
     }
 
-    auto error = g_remove (getCacheFileName ("images", fname, ".rtti", md5).c_str ());
-    error |= g_remove (getCacheFileName ("images", fname, ".cust16", md5).c_str ());
-    error |= g_remove (getCacheFileName ("images", fname, ".cust", md5).c_str ());
-    error |= g_remove (getCacheFileName ("images", fname, ".jpg", md5).c_str ());
-    error |= g_remove (getCacheFileName ("aehistograms", fname, "", md5).c_str ());
-    error |= g_remove (getCacheFileName ("embprofiles", fname, ".icc", md5).c_str ());
-
-    if (purgeData) {
-        error |= g_remove (getCacheFileName ("data", fname, ".txt", md5).c_str ());
-    }
-
-    if (purgeProfile) {
-        error |= g_remove (getCacheFileName ("profiles", fname, paramFileExtension, md5).c_str ());
-    }
+    store.remove (md5, purgeData);
 
-    if (error != 0 && options.rtSettings.verbose) {
-        std::cerr << "Failed to delete all files for cache entry '" << fname << "': " << g_strerror(errno) << std::endl;
+    if (purgeProfile && g_remove (getCacheFileName ("profiles", fname, paramFileExtension, md5).c_str ()) != 0 && options.rtSettings.verbose) {
+        std::cerr << "Failed to delete the processing profile of cache entry '" << fname << "': " << g_strerror(errno) << std::endl;
     }
 }
 
@@ -342,50 +329,79 @@ Glib::ustring CacheManager::getCacheFileName (const Glib::ustring& subDir,
     return Glib::build_filename (dirName, baseName + fext);
 }
 
-void CacheManager::applyCacheSizeLimitation () const
+CacheStore& CacheManager::getStore ()
 {
-    using FNameMTime = std::pair<Glib::ustring, Glib::TimeVal>;
-    std::vector<FNameMTime> files;
-
-    try {
+    return store;
+}
 
-        const auto dirName = Glib::build_filename (baseDir, "data");
-        const auto dir = Gio::File::create_for_path (dirName);
+void CacheManager::migrateCache ()
+{
+    const auto dataDir = Glib::build_filename (baseDir, "data");
 
-        auto enumerator = dir->enumerate_children ("standard::name,time::modified");
+    if (!Glib::file_test (dataDir, Glib::FILE_TEST_IS_DIR)) {
+        return;
+    }
 
-        while (auto file = enumerator->next_file ()) {
-            files.emplace_back (file->get_name (), file->modification_time ());
-        }
+    // The records of an image were named <basename>.<md5><extension>,
+    // one image data file in "data" per entry
+    std::size_t count = 0;
 
-    } catch (Glib::Exception&) {}
+    try {
 
-    if (files.size () <= options.maxCacheEntries) {
-        return;
-    }
+        Glib::Dir dir (dataDir);
 
-    std::sort (files.begin (), files.end (), [] (const FNameMTime& lhs, const FNameMTime& rhs)
-    {
-        return lhs.second < rhs.second;
-    });
+        for (auto entry = dir.begin (); entry != dir.end (); ++entry) {
 
-    auto cacheEntries = files.size ();
+            const std::string& name = *entry;
 
-    for (auto entry = files.begin (); cacheEntries-- > options.maxCacheEntries; ++entry) {
+            constexpr auto md5_size = 32;
+            const auto name_size = name.size();
 
-        const auto& name = entry->first;
+            if (name_size < md5_size + 5 || name.compare (name_size - 4, 4, ".txt") != 0) {
+                continue;
+            }
 
-        constexpr auto md5_size = 32;
-        const auto name_size = name.size();
+            const auto stem = name.substr (0, name_size - 4);
+            const auto md5 = name.substr (name_size - md5_size - 4, md5_size);
 
-        if (name_size < md5_size + 5) {
-            continue;
+            if (importFile (Glib::build_filename (dataDir, name), md5, CacheStore::Kind::DATA)) {
+                importFile (Glib::build_filename (baseDir, "images", stem + ".rtti"), md5, CacheStore::Kind::IMAGE);
+                importFile (Glib::build_filename (baseDir, "aehistograms", stem), md5, CacheStore::Kind::AE_HISTOGRAM);
+                importFile (Glib::build_filename (baseDir, "embprofiles", stem + ".icc"), md5, CacheStore::Kind::EMB_PROFILE);
+                ++count;
+            }
         }
 
-        const auto fname = name.substr (0, name_size - md5_size - 5);
-        const auto md5 = name.substr (name_size - md5_size - 4, md5_size);
+    } catch (Glib::Error&) {}
+
+    // what is left are obsolete image formats and records without image data
+    for (const auto& cacheDir : oldCacheDirs) {
+        deleteDir (cacheDir);
+        g_rmdir (Glib::build_filename (baseDir, cacheDir).c_str ());
+    }
+
+    store.flush ();
 
-        deleteFiles (fname, md5, true, false);
+    if (options.rtSettings.verbose) {
+        std::cout << "Moved " << count << " entries to the thumbnail cache '" << storeName << "'" << std::endl;
     }
 }
 
+bool CacheManager::importFile (const Glib::ustring& fileName, const std::string& md5, CacheStore::Kind kind)
+{
+    gchar* contents = nullptr;
+    gsize length = 0;
+
+    if (!g_file_get_contents (fileName.c_str (), &contents, &length, nullptr)) {
+        return false;
+    }
+
+    const bool imported = store.put (md5, kind, contents, length);
+    g_free (contents);
+
+    if (imported) {
+        g_remove (fileName.c_str ());
+    }
+
+    return imported;
+}
@@ -26,6 +26,7 @@
 
 #include "../rtengine/noncopyable.h"
 
+#include "cachestore.h"
 #include "threadutils.h"
 
 class Thumbnail;
@@ -37,29 +38,35 @@ private:
     using Entries = std::map<std::string, Thumbnail*>;
     Entries openEntries;
     Glib::ustring    baseDir;
+    CacheStore       store;
     mutable MyMutex  mutex;
 
     void deleteDir   (const Glib::ustring& dirName) const;
-    void deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile) const;
+    void deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile);
 
-    void applyCacheSizeLimitation () const;
+    void migrateCache ();
+    bool importFile (const Glib::ustring& fileName, const std::string& md5, CacheStore::Kind kind);
 
 public:
     static CacheManager* getInstance ();
 
     void        init        ();
 
-    Thumbnail*  getEntry    (const Glib::ustring& fname);
+    // generate: false to get nullptr instead of a thumbnail made from the file when it is not in the cache
+    Thumbnail*  getEntry    (const Glib::ustring& fname, bool generate = true);
     void        deleteEntry (const Glib::ustring& fname);
     void        renameEntry (const std::string& oldfilename, const std::string& oldmd5, const std::string& newfilename);
 
     void closeThumbnail (Thumbnail* thumbnail);
-    void closeCache () const;
+    void closeCache ();
 
-    void clearAll () const;
-    void clearImages () const;
+    void clearAll ();
+    void clearImages ();
     void clearProfiles () const;
-    void clearFromCache (const Glib::ustring& fname, bool purge) const;
+    void clearFromCache (const Glib::ustring& fname, bool purge);
+
+    // holds the thumbnail images and image data, the processing profiles are kept in files
+    CacheStore& getStore ();
 
     static std::string getMD5 (const Glib::ustring& fname);
 
@@ -0,0 +1,740 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "cachestore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <glib/gstdio.h>
+#include <glibmm.h>
+
+#include "options.h"
+
+namespace
+{
+
+// File header: magic and generation. The generation changes whenever the
+// file is rewritten, so that an index saved for an older file is not used.
+constexpr char storeMagic[8] = {'R', 'T', 'T', 'H', 'U', 'M', 'B', '1'};
+constexpr char indexMagic[8] = {'R', 'T', 'T', 'H', 'I', 'D', 'X', '1'};
+constexpr std::size_t fileHeaderSize = 16;
+
+constexpr std::uint32_t recordMagic = 0x52435452; // "RTCR"
+constexpr std::size_t md5Size = 32;
+
+// Record types besides the kinds of CacheStore::Kind
+constexpr std::uint32_t removeType = 0x10;  // payload: mask of the removed kinds
+constexpr std::uint32_t moveType = 0x20;    // payload: the new key
+constexpr std::uint32_t allKinds = 0xf;
+
+// Record header, followed by the payload padded to 8 bytes
+struct RecordHeader {
+    std::uint32_t magic;
+    std::uint32_t type;
+    std::uint64_t size;
+    char md5[md5Size];
+};
+
+static_assert(sizeof(RecordHeader) == 48, "unexpected padding of RecordHeader");
+
+// Compacting a store of a few MiB is not worth the writes
+constexpr std::uint64_t minDeadBytes = 16 << 20;
+
+std::uint64_t padded (std::uint64_t size)
+{
+    return (size + 7) & ~std::uint64_t(7);
+}
+
+std::uint64_t recordSize (std::uint64_t payloadSize)
+{
+    return sizeof(RecordHeader) + padded(payloadSize);
+}
+
+std::string keyOf (const char* md5)
+{
+    return std::string(md5, strnlen(md5, md5Size));
+}
+
+void addRecord (std::string& buffer, const std::string& md5, std::uint32_t type, const char* data, std::size_t size)
+{
+    RecordHeader header = {recordMagic, type, size, {}};
+    md5.copy(header.md5, md5Size);
+
+    buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer.append(data, size);
+    buffer.append(padded(size) - size, '\0');
+}
+
+bool writeAll (FILE* file, const std::string& buffer)
+{
+    return fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && fflush(file) == 0;
+}
+
+std::int64_t tell (FILE* file)
+{
+#ifdef WIN32
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+}
+
+// Moves a file written completely over another one
+bool replaceFile (const Glib::ustring& source, const Glib::ustring& destination)
+{
+#ifdef WIN32
+    g_remove(destination.c_str());
+#endif
+
+    if (g_rename(source.c_str(), destination.c_str()) != 0) {
+        g_remove(source.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+CacheStore::Payload::Payload () :
+    begin(nullptr),
+    length(0)
+{
+}
+
+CacheStore::CacheStore () :
+    file(nullptr),
+    created(false),
+    generation(0),
+    liveBytes(0),
+    fileSize(0)
+{
+}
+
+CacheStore::~CacheStore ()
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool CacheStore::open (const Glib::ustring& fileName)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+
+    this->fileName = fileName;
+    created = false;
+    index.clear();
+    liveBytes = 0;
+    mapping.reset();
+
+    if (!map() || g_mapped_file_get_length(mapping.get()) < fileHeaderSize || memcmp(g_mapped_file_get_contents(mapping.get()), storeMagic, sizeof(storeMagic)) != 0) {
+        return create();
+    }
+
+    memcpy(&generation, g_mapped_file_get_contents(mapping.get()) + sizeof(storeMagic), sizeof(generation));
+
+    file = g_fopen(fileName.c_str(), "ab");
+
+    if (!file) {
+        return false;
+    }
+
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    if (!loadIndex()) {
+        index.clear();
+        liveBytes = 0;
+        fileSize = fileHeaderSize;
+    }
+
+    const std::uint64_t indexed = fileSize;
+
+    if (!scan(fileSize)) {
+        // Truncated record, most likely from a crash while writing it. Records appended
+        // after it would not be found by the next scan, so the store is rewritten now.
+        if (options.rtSettings.verbose) {
+            std::cerr << "Thumbnail cache: damaged record at offset " << fileSize << ", compacting" << std::endl;
+        }
+
+        compact();
+    }
+
+    if (options.rtSettings.verbose) {
+        std::cout << "Thumbnail cache: " << index.size() << " entries, " << fileSize - indexed << " bytes scanned" << std::endl;
+    }
+
+    return file != nullptr;
+}
+
+void CacheStore::flush ()
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!file) {
+        return;
+    }
+
+    const std::uint64_t deadBytes = fileSize - fileHeaderSize - liveBytes;
+
+    if (deadBytes > liveBytes && deadBytes >= minDeadBytes) {
+        compact();
+    }
+
+    if (file) {
+        saveIndex();
+    }
+}
+
+bool CacheStore::isNew () const
+{
+    MyMutex::MyLock lock(mutex);
+
+    return created;
+}
+
+CacheStore::Payload CacheStore::get (const std::string& md5, Kind kind) const
+{
+    MyMutex::MyLock lock(mutex);
+
+    Payload payload;
+
+    const auto entry = index.find(md5);
+
+    if (entry == index.end()) {
+        return payload;
+    }
+
+    const Location& location = entry->second.records[static_cast<std::size_t>(kind)];
+
+    if (!location.offset) {
+        return payload;
+    }
+
+    if ((!mapping || g_mapped_file_get_length(mapping.get()) < location.offset + location.size) && !map()) {
+        return payload;
+    }
+
+    const char* const contents = g_mapped_file_get_contents(mapping.get());
+
+    if (g_mapped_file_get_length(mapping.get()) < location.offset + location.size) {
+        return payload;
+    }
+
+    // The record has to be the one indexed, in case the file has been changed by another instance
+    RecordHeader header;
+    memcpy(&header, contents + location.offset - sizeof(header), sizeof(header));
+
+    if (header.magic != recordMagic || header.type != static_cast<std::uint32_t>(kind) || header.size != location.size) {
+        return payload;
+    }
+
+    payload.mapping = mapping;
+    payload.begin = contents + location.offset;
+    payload.length = location.size;
+    return payload;
+}
+
+bool CacheStore::put (const std::string& md5, Kind kind, const std::string& data)
+{
+    return put(md5, kind, data.data(), data.size());
+}
+
+bool CacheStore::put (const std::string& md5, Kind kind, const char* data, std::size_t size)
+{
+    MyMutex::MyLock lock(mutex);
+
+    std::string buffer;
+    addRecord(buffer, md5, static_cast<std::uint32_t>(kind), data, size);
+
+    std::uint64_t offset;
+
+    if (!append(buffer, offset)) {
+        return false;
+    }
+
+    apply(md5, static_cast<std::uint32_t>(kind), offset + sizeof(RecordHeader), size, data);
+    return true;
+}
+
+void CacheStore::remove (const std::string& md5, bool purgeData)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!index.count(md5)) {
+        return;
+    }
+
+    const std::uint32_t mask = purgeData ? allKinds : allKinds & ~(1 << static_cast<int>(Kind::DATA));
+
+    std::string buffer;
+    addRecord(buffer, md5, removeType, reinterpret_cast<const char*>(&mask), sizeof(mask));
+
+    std::uint64_t offset;
+
+    if (append(buffer, offset)) {
+        apply(md5, removeType, offset + sizeof(RecordHeader), sizeof(mask), reinterpret_cast<const char*>(&mask));
+    }
+}
+
+void CacheStore::rename (const std::string& oldMD5, const std::string& newMD5)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!index.count(oldMD5) || oldMD5 == newMD5) {
+        return;
+    }
+
+    std::string buffer;
+    addRecord(buffer, oldMD5, moveType, newMD5.data(), newMD5.size());
+
+    std::uint64_t offset;
+
+    if (append(buffer, offset)) {
+        apply(oldMD5, moveType, offset + sizeof(RecordHeader), newMD5.size(), newMD5.data());
+    }
+}
+
+void CacheStore::clear (bool purgeData)
+{
+    MyMutex::MyLock lock(mutex);
+
+    std::vector<std::string> keys;
+    keys.reserve(index.size());
+
+    for (const auto& entry : index) {
+        keys.push_back(entry.first);
+    }
+
+    removeAll(keys, purgeData ? allKinds : allKinds & ~(1 << static_cast<int>(Kind::DATA)));
+
+    // Only the image data can be left, give the space back now
+    compact();
+}
+
+void CacheStore::limit (std::size_t maxEntries)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (index.size() <= maxEntries) {
+        return;
+    }
+
+    using StampKey = std::pair<std::uint64_t, std::string>;
+    std::vector<StampKey> entries;
+    entries.reserve(index.size());
+
+    for (const auto& entry : index) {
+        entries.emplace_back(entry.second.stamp, entry.first);
+    }
+
+    const std::size_t count = index.size() - maxEntries;
+    std::nth_element(entries.begin(), entries.begin() + count, entries.end());
+
+    std::vector<std::string> keys;
+    keys.reserve(count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        keys.push_back(std::move(entries[i].second));
+    }
+
+    removeAll(keys, allKinds);
+}
+
+bool CacheStore::create ()
+{
+    const Glib::ustring tmpName = fileName + ".tmp";
+    FILE* const newFile = g_fopen(tmpName.c_str(), "wb");
+
+    if (!newFile) {
+        return false;
+    }
+
+    // A new file rather than truncating the old one, whose mapping may still be in use
+    generation = (std::uint64_t(g_random_int()) << 32) | g_random_int();
+
+    const bool written = fwrite(storeMagic, 1, sizeof(storeMagic), newFile) == sizeof(storeMagic)
+                         && fwrite(&generation, 1, sizeof(generation), newFile) == sizeof(generation);
+
+    if (fclose(newFile) != 0 || !written || !replaceFile(tmpName, fileName)) {
+        g_remove(tmpName.c_str());
+        return false;
+    }
+
+    if (file) {
+        fclose(file);
+    }
+
+    file = g_fopen(fileName.c_str(), "ab");
+
+    if (!file) {
+        return false;
+    }
+
+    setvbuf(file, nullptr, _IONBF, 0);
+    mapping.reset();
+    index.clear();
+    liveBytes = 0;
+    fileSize = fileHeaderSize;
+    created = true;
+    return true;
+}
+
+bool CacheStore::loadIndex ()
+{
+    gchar* contents = nullptr;
+    gsize length = 0;
+
+    if (!g_file_get_contents((fileName + ".idx").c_str(), &contents, &length, nullptr)) {
+        return false;
+    }
+
+    const std::unique_ptr<gchar, GFreeFunc> holder(contents, g_free);
+
+    // magic, generation, size of the store covered, number of entries
+    constexpr std::size_t headerSize = sizeof(indexMagic) + 3 * sizeof(std::uint64_t);
+    constexpr std::size_t entrySize = md5Size + sizeof(Entry::stamp) + kinds * sizeof(Location);
+
+    if (length < headerSize || memcmp(contents, indexMagic, sizeof(indexMagic)) != 0) {
+        return false;
+    }
+
+    std::uint64_t header[3];
+    memcpy(header, contents + sizeof(indexMagic), sizeof(header));
+
+    if (header[0] != generation || header[1] > g_mapped_file_get_length(mapping.get()) || header[2] != (length - headerSize) / entrySize) {
+        return false;
+    }
+
+    index.reserve(header[2]);
+
+    for (const char* pos = contents + headerSize; pos + entrySize <= contents + length; pos += entrySize) {
+        Entry entry;
+        memcpy(&entry.stamp, pos + md5Size, sizeof(entry.stamp));
+        memcpy(entry.records.data(), pos + md5Size + sizeof(entry.stamp), kinds * sizeof(Location));
+
+        for (const auto& location : entry.records) {
+            if (location.offset) {
+                liveBytes += recordSize(location.size);
+            }
+        }
+
+        index.emplace(keyOf(pos), entry);
+    }
+
+    fileSize = header[1];
+    return true;
+}
+
+void CacheStore::saveIndex () const
+{
+    std::string buffer;
+    buffer.reserve(sizeof(indexMagic) + 3 * sizeof(std::uint64_t) + index.size() * (md5Size + sizeof(Entry::stamp) + kinds * sizeof(Location)));
+
+    const std::uint64_t header[3] = {generation, fileSize, index.size()};
+    buffer.append(indexMagic, sizeof(indexMagic));
+    buffer.append(reinterpret_cast<const char*>(header), sizeof(header));
+
+    for (const auto& entry : index) {
+        char md5[md5Size] = {};
+        entry.first.copy(md5, md5Size);
+        buffer.append(md5, md5Size);
+        buffer.append(reinterpret_cast<const char*>(&entry.second.stamp), sizeof(entry.second.stamp));
+        buffer.append(reinterpret_cast<const char*>(entry.second.records.data()), kinds * sizeof(Location));
+    }
+
+    const Glib::ustring indexName = fileName + ".idx";
+    const Glib::ustring tmpName = indexName + ".tmp";
+    FILE* const indexFile = g_fopen(tmpName.c_str(), "wb");
+
+    if (!indexFile) {
+        return;
+    }
+
+    const bool written = fwrite(buffer.data(), 1, buffer.size(), indexFile) == buffer.size();
+
+    if (fclose(indexFile) != 0 || !written) {
+        g_remove(tmpName.c_str());
+        return;
+    }
+
+    replaceFile(tmpName, indexName);
+}
+
+bool CacheStore::scan (std::uint64_t from)
+{
+    if (!map()) {
+        return false;
+    }
+
+    const char* const contents = g_mapped_file_get_contents(mapping.get());
+    const std::uint64_t length = g_mapped_file_get_length(mapping.get());
+
+    fileSize = from;
+
+    while (fileSize + sizeof(RecordHeader) <= length) {
+        RecordHeader header;
+        memcpy(&header, contents + fileSize, sizeof(header));
+
+        if (header.magic != recordMagic || header.size > length - fileSize - sizeof(RecordHeader)) {
+            return false;
+        }
+
+        const std::uint64_t offset = fileSize + sizeof(RecordHeader);
+        apply(keyOf(header.md5), header.type, offset, header.size, contents + offset);
+        fileSize += recordSize(header.size);
+    }
+
+    return fileSize >= length;
+}
+
+bool CacheStore::map () const
+{
+    GMappedFile* const newMapping = g_mapped_file_new(fileName.c_str(), FALSE, nullptr);
+
+    if (!newMapping) {
+        return false;
+    }
+
+    mapping.reset(newMapping, g_mapped_file_unref);
+    return true;
+}
+
+bool CacheStore::append (const std::string& buffer, std::uint64_t& offset)
+{
+    if (!file || !writeAll(file, buffer)) {
+        return false;
+    }
+
+    // In append mode, the records of other instances may have been written before this one
+    const std::int64_t end = tell(file);
+    offset = end >= std::int64_t(buffer.size()) ? end - buffer.size() : fileSize;
+    fileSize = std::max<std::uint64_t>(fileSize, offset + buffer.size());
+    return true;
+}
+
+void CacheStore::apply (const std::string& md5, std::uint32_t type, std::uint64_t offset, std::uint64_t size, const char* payload)
+{
+    if (type < kinds) {
+        Entry& entry = index[md5];
+        Location& location = entry.records[type];
+
+        if (location.offset) {
+            liveBytes -= recordSize(location.size);
+        }
+
+        location = {offset, size};
+        liveBytes += recordSize(size);
+        entry.stamp = offset;
+        return;
+    }
+
+    const auto entry = index.find(md5);
+
+    if (entry == index.end()) {
+        return;
+    }
+
+    if (type == removeType && size == sizeof(std::uint32_t)) {
+        std::uint32_t mask;
+        memcpy(&mask, payload, sizeof(mask));
+        removeRecords(entry, mask);
+    } else if (type == moveType && size <= md5Size) {
+        const std::string newMD5(payload, size);
+        const Entry moved = entry->second;
+        index.erase(entry);
+
+        const auto replaced = index.find(newMD5);
+
+        if (replaced != index.end()) {
+            removeRecords(replaced, allKinds);
+        }
+
+        index[newMD5] = moved;
+    }
+}
+
+void CacheStore::removeRecords (Index::iterator entry, std::uint32_t mask)
+{
+    bool empty = true;
+
+    for (std::size_t kind = 0; kind < kinds; ++kind) {
+        Location& location = entry->second.records[kind];
+
+        if (location.offset && (mask & (1 << kind))) {
+            liveBytes -= recordSize(location.size);
+            location = {};
+        }
+
+        empty = empty && !location.offset;
+    }
+
+    if (empty) {
+        index.erase(entry);
+    }
+}
+
+void CacheStore::removeAll (const std::vector<std::string>& keys, std::uint32_t mask)
+{
+    if (keys.empty()) {
+        return;
+    }
+
+    // One write for all removal records
+    std::string buffer;
+    buffer.reserve(keys.size() * recordSize(sizeof(mask)));
+
+    for (const auto& key : keys) {
+        addRecord(buffer, key, removeType, reinterpret_cast<const char*>(&mask), sizeof(mask));
+    }
+
+    std::uint64_t offset;
+
+    if (!append(buffer, offset)) {
+        return;
+    }
+
+    for (const auto& key : keys) {
+        const auto entry = index.find(key);
+
+        if (entry != index.end()) {
+            removeRecords(entry, mask);
+        }
+    }
+}
+
+void CacheStore::compact ()
+{
+    if (!file || !map()) {
+        return;
+    }
+
+    const char* const contents = g_mapped_file_get_contents(mapping.get());
+    const std::uint64_t length = g_mapped_file_get_length(mapping.get());
+
+    // Oldest entries first, which keeps the order of the stamps
+    std::vector<Index::const_iterator> entries;
+    entries.reserve(index.size());
+
+    for (auto entry = index.cbegin(); entry != index.cend(); ++entry) {
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](Index::const_iterator lhs, Index::const_iterator rhs) {
+        return lhs->second.stamp < rhs->second.stamp;
+    });
+
+    const Glib::ustring tmpName = fileName + ".tmp";
+    FILE* const newFile = g_fopen(tmpName.c_str(), "wb");
+
+    if (!newFile) {
+        return;
+    }
+
+    const std::uint64_t newGeneration = (std::uint64_t(g_random_int()) << 32) | g_random_int();
+    std::string buffer(storeMagic, sizeof(storeMagic));
+    buffer.append(reinterpret_cast<const char*>(&newGeneration), sizeof(newGeneration));
+
+    Index newIndex;
+    newIndex.reserve(index.size());
+    std::uint64_t newSize = 0;
+    std::uint64_t newLiveBytes = 0;
+    bool written = true;
+
+    for (const auto& entry : entries) {
+        Entry& newEntry = newIndex[entry->first];
+
+        for (std::size_t kind = 0; kind < kinds; ++kind) {
+            const Location& location = entry->second.records[kind];
+
+            if (!location.offset || location.offset + location.size > length) {
+                newEntry.records[kind] = {};
+                continue;
+            }
+
+            newEntry.records[kind] = {newSize + buffer.size() + sizeof(RecordHeader), location.size};
+            newEntry.stamp = newEntry.records[kind].offset;
+            newLiveBytes += recordSize(location.size);
+            addRecord(buffer, entry->first, kind, contents + location.offset, location.size);
+        }
+
+        if (buffer.size() >= (1 << 20)) {
+            written = written && fwrite(buffer.data(), 1, buffer.size(), newFile) == buffer.size();
+            newSize += buffer.size();
+            buffer.clear();
+        }
+    }
+
+    written = written && fwrite(buffer.data(), 1, buffer.size(), newFile) == buffer.size();
+    newSize += buffer.size();
+
+    // Readers may still hold the old mapping, which stays valid (except on Windows, where
+    // the old file can not be replaced while mapped and the compaction is skipped)
+    mapping.reset();
+
+    if (fclose(newFile) != 0 || !written) {
+        g_remove(tmpName.c_str());
+        return;
+    }
+
+    fclose(file);
+
+    if (!replaceFile(tmpName, fileName)) {
+        if (options.rtSettings.verbose) {
+            std::cerr << "Thumbnail cache: could not replace " << fileName << " by its compacted version" << std::endl;
+        }
+
+        file = g_fopen(fileName.c_str(), "ab");
+
+        if (file) {
+            setvbuf(file, nullptr, _IONBF, 0);
+        }
+
+        return;
+    }
+
+    file = g_fopen(fileName.c_str(), "ab");
+
+    if (file) {
+        setvbuf(file, nullptr, _IONBF, 0);
+    }
+
+    // The entries left without records are the removed ones
+    for (auto entry = newIndex.begin(); entry != newIndex.end();) {
+        if (!entry->second.stamp) {
+            entry = newIndex.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+
+    index.swap(newIndex);
+    generation = newGeneration;
+    fileSize = newSize;
+    liveBytes = newLiveBytes;
+
+    if (options.rtSettings.verbose) {
+        std::cout << "Thumbnail cache: compacted from " << length << " to " << newSize << " bytes" << std::endl;
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glib.h>
+#include <glibmm/ustring.h>
+
+#include "../rtengine/noncopyable.h"
+
+#include "threadutils.h"
+
+/**
+ * Single file store of the thumbnail cache.
+ *
+ * The records of an image (thumbnail image, image data, auto exposure
+ * histogram and embedded profile) used to be one file each, in four
+ * directories. Here they are appended to one file, which is memory mapped
+ * for reading: a record is read in place, without a copy or a system call.
+ *
+ * Records are never modified. Writing a record again appends a new version,
+ * removing an entry appends a small removal record, and the index in memory
+ * (keyed by the MD5 identity of CacheManager::getMD5()) points to the latest
+ * versions. The index is saved next to the store by flush(), so that only the
+ * records appended since then have to be scanned when the store is opened.
+ * flush() also rewrites the store without the dead records once they take
+ * more space than the live ones.
+ *
+ * A record is written by a single write to the end of the file and carries
+ * its key, so a record appended by another instance of the application is
+ * not mistaken for one of ours.
+ */
+class CacheStore :
+    public rtengine::NonCopyable
+{
+public:
+    enum class Kind {
+        DATA,           // key file of CacheImageData and rtengine::Thumbnail
+        IMAGE,          // thumbnail image
+        AE_HISTOGRAM,   // auto exposure histogram
+        EMB_PROFILE     // embedded color profile
+    };
+
+    /** A record read in place, valid as long as the object is held, even if the store changes meanwhile. */
+    class Payload
+    {
+    public:
+        Payload ();
+
+        explicit operator bool () const
+        {
+            return mapping != nullptr;
+        }
+
+        const char* data () const
+        {
+            return begin;
+        }
+
+        std::size_t size () const
+        {
+            return length;
+        }
+
+    private:
+        friend class CacheStore;
+
+        std::shared_ptr<GMappedFile> mapping;
+        const char* begin;
+        std::size_t length;
+    };
+
+    CacheStore ();
+    ~CacheStore ();
+
+    /** Opens the store, creating it if needed.
+      * @param fileName the store file, the index is saved to fileName + ".idx"
+      * @return false if the store can not be written */
+    bool open (const Glib::ustring& fileName);
+
+    /** Saves the index and compacts the store if worth it. The store stays open. */
+    void flush ();
+
+    /** @return true if the store has been created by open() */
+    bool isNew () const;
+
+    Payload get (const std::string& md5, Kind kind) const;
+    bool put (const std::string& md5, Kind kind, const std::string& data);
+    bool put (const std::string& md5, Kind kind, const char* data, std::size_t size);
+
+    /** Removes the records of an entry, all of them or all but the image data */
+    void remove (const std::string& md5, bool purgeData);
+
+    /** Moves the records of an entry to a new key */
+    void rename (const std::string& oldMD5, const std::string& newMD5);
+
+    /** Removes the records of all entries, or all but the image data */
+    void clear (bool purgeData);
+
+    /** Removes the least recently written entries above maxEntries */
+    void limit (std::size_t maxEntries);
+
+private:
+    static constexpr std::size_t kinds = 4;
+
+    struct Location {
+        std::uint64_t offset;   // of the payload
+        std::uint64_t size;
+    };
+
+    struct Entry {
+        std::array<Location, kinds> records;
+        std::uint64_t stamp;    // offset of the last record written
+    };
+
+    using Index = std::unordered_map<std::string, Entry>;
+
+    bool create ();
+    bool loadIndex ();
+    void saveIndex () const;
+    bool scan (std::uint64_t from);
+    bool map () const;
+    bool append (const std::string& buffer, std::uint64_t& offset);
+    void apply (const std::string& md5, std::uint32_t type, std::uint64_t offset, std::uint64_t size, const char* payload);
+    void removeRecords (Index::iterator entry, std::uint32_t mask);
+    void removeAll (const std::vector<std::string>& keys, std::uint32_t mask);
+    void compact ();
+
+    mutable MyMutex mutex;
+    Glib::ustring fileName;
+    FILE* file;
+    bool created;
+    std::uint64_t generation;
+    std::uint64_t liveBytes;
+    std::uint64_t fileSize;
+    Index index;
+    mutable std::shared_ptr<GMappedFile> mapping;
+};
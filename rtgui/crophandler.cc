@@ -172,6 +172,11 @@ void CropHandler::setZoom (int z, int centerx, int centery)
 
     zoom = z;
 
+    // the raw data may only be binned, which is not enough anymore if the crop shows more than every cell'th pixel
+    if (!needsFullRefresh && (zoom >= 1000 ? 1 : zoom / 10) < ipc->getBinnedCell ()) {
+        needsFullRefresh = true;
+    }
+
     if (zoom >= 1000) {
         cw = ww * 1000 / zoom;
         ch = wh * 1000 / zoom;
@@ -1668,9 +1668,9 @@ void EditorPanel::procParamsChanged (Thumbnail* thm, int whoChangedIt)
     }
 }
 
-bool EditorPanel::idle_saveImage (ProgressConnector<rtengine::IImage16*> *pc, Glib::ustring fname, SaveFormat sf)
+bool EditorPanel::idle_saveImage (ProgressConnector<rtengine::IImage*> *pc, Glib::ustring fname, SaveFormat sf)
 {
-    rtengine::IImage16* img = pc->returnValue();
+    rtengine::IImage* img = pc->returnValue();
     delete pc;
 
     if ( img ) {
@@ -1681,13 +1681,13 @@ bool EditorPanel::idle_saveImage (ProgressConnector<rtengine::IImage16*> *pc, Gl
         img->setSaveProgressListener (parent->getProgressListener());
 
         if (sf.format == "tif")
-            ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage16::saveAsTIFF), fname, sf.tiffBits, sf.tiffUncompressed),
+            ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage::saveAsTIFF), fname, sf.tiffBits, sf.tiffUncompressed, sf.tiffFloat),
                            sigc::bind (sigc::mem_fun (*this, &EditorPanel::idle_imageSaved), ld, img, fname, sf));
         else if (sf.format == "png")
-            ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage16::saveAsPNG), fname, sf.pngCompression, sf.pngBits),
+            ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage::saveAsPNG), fname, sf.pngCompression, sf.pngBits),
                            sigc::bind (sigc::mem_fun (*this, &EditorPanel::idle_imageSaved), ld, img, fname, sf));
         else if (sf.format == "jpg")
-            ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage16::saveAsJPEG), fname, sf.jpegQuality, sf.jpegSubSamp),
+            ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage::saveAsJPEG), fname, sf.jpegQuality, sf.jpegSubSamp),
                            sigc::bind (sigc::mem_fun (*this, &EditorPanel::idle_imageSaved), ld, img, fname, sf));
     } else {
         Glib::ustring msg_ = Glib::ustring ("<b>") + fname + ": Error during image processing\n</b>";
@@ -1705,7 +1705,7 @@ bool EditorPanel::idle_saveImage (ProgressConnector<rtengine::IImage16*> *pc, Gl
     return false;
 }
 
-bool EditorPanel::idle_imageSaved (ProgressConnector<int> *pc, rtengine::IImage16* img, Glib::ustring fname, SaveFormat sf)
+bool EditorPanel::idle_imageSaved (ProgressConnector<int> *pc, rtengine::IImage* img, Glib::ustring fname, SaveFormat sf)
 {
     img->free ();
 
@@ -1833,9 +1833,16 @@ void EditorPanel::saveAsPressed ()
                 ipc->getParams (&pparams);
                 rtengine::ProcessingJob* job = rtengine::ProcessingJob::create (ipc->getInitialImage(), pparams);
 
-                ProgressConnector<rtengine::IImage16*> *ld = new ProgressConnector<rtengine::IImage16*>();
-                ld->startFunc (sigc::bind (sigc::ptr_fun (&rtengine::processImage), job, err, parent->getProgressListener(), options.tunnelMetaData, false ),
-                               sigc::bind (sigc::mem_fun ( *this, &EditorPanel::idle_saveImage ), ld, fnameOut, sf ));
+                ProgressConnector<rtengine::IImage*> *ld = new ProgressConnector<rtengine::IImage*>();
+
+                if (sf.format == "tif" && sf.tiffFloat) {
+                    ld->startFunc (sigc::bind (sigc::ptr_fun (&rtengine::processImageFloat), job, err, parent->getProgressListener(), options.tunnelMetaData, false ),
+                                   sigc::bind (sigc::mem_fun ( *this, &EditorPanel::idle_saveImage ), ld, fnameOut, sf ));
+                } else {
+                    ld->startFunc (sigc::bind (sigc::ptr_fun (&rtengine::processImage), job, err, parent->getProgressListener(), options.tunnelMetaData, false ),
+                                   sigc::bind (sigc::mem_fun ( *this, &EditorPanel::idle_saveImage ), ld, fnameOut, sf ));
+                }
+
                 saveimgas->set_sensitive (false);
                 sendtogimp->set_sensitive (false);
             }
@@ -1941,7 +1948,7 @@ bool EditorPanel::idle_sendToGimp ( ProgressConnector<rtengine::IImage16*> *pc,
 
         ProgressConnector<int> *ld = new ProgressConnector<int>();
         img->setSaveProgressListener (parent->getProgressListener());
-        ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage16::saveAsTIFF), fileName, sf.tiffBits, sf.tiffUncompressed),
+        ld->startFunc (sigc::bind (sigc::mem_fun (img, &rtengine::IImage16::saveAsTIFF), fileName, sf.tiffBits, sf.tiffUncompressed, sf.tiffFloat),
                        sigc::bind (sigc::mem_fun (*this, &EditorPanel::idle_sentToGimp), ld, img, fileName));
     } else {
         Glib::ustring msg_ = Glib::ustring ("<b> Error during image processing\n</b>");
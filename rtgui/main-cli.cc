@@ -26,6 +26,7 @@
 #include "config.h"
 #include <gtkmm.h>
 #include <giomm.h>
+#include <atomic>
 #include <iostream>
 #include <tiffio.h>
 #include "rtwindow.h"
@@ -38,6 +39,14 @@
 #include "rtimage.h"
 #include "version.h"
 #include "extprog.h"
+#include "../rtengine/fftwplancache.h"
+#include "../rtengine/imagewriter.h"
+#include "../rtengine/noncopyable.h"
+#include "../rtengine/profiler.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifndef WIN32
 #include <glibmm/fileutils.h>
@@ -83,6 +92,190 @@ Glib::ustring fname_to_utf8 (const char* fname)
 
 bool fast_export = false;
 
+struct OutputSettings {
+    std::string type;
+    int compression;
+    int subsampling;
+    int bits;
+    bool isFloat;   // floating point TIFF
+    bool copyParamsFile;
+};
+
+struct CliJob {
+    rtengine::ProcessingJob* job;
+    rtengine::InitialImage* ii;
+    rtengine::procparams::ProcParams params;
+    Glib::ustring inputFile;
+    Glib::ustring outputFile;
+};
+
+// Saves a processed image; returns false if it could not be written
+bool save (CliJob& cliJob, const OutputSettings& output, rtengine::IImage* resultImage)
+{
+    int errorCode;
+
+    if( output.type == "jpg" ) {
+        errorCode = resultImage->saveAsJPEG( cliJob.outputFile, output.compression, output.subsampling );
+    } else if( output.type == "tif" ) {
+        errorCode = resultImage->saveAsTIFF( cliJob.outputFile, output.bits, output.compression == 0, output.isFloat );
+    } else if( output.type == "png" ) {
+        errorCode = resultImage->saveAsPNG( cliJob.outputFile, output.compression, output.bits );
+    } else {
+        errorCode = resultImage->saveToFile (cliJob.outputFile);
+    }
+
+    if(errorCode) {
+        std::cerr << "Error saving to: " << cliJob.outputFile << std::endl;
+        return false;
+    }
+
+    if( output.copyParamsFile ) {
+        Glib::ustring outputProcessingParams = cliJob.outputFile + paramFileExtension;
+        cliJob.params.save( outputProcessingParams );
+    }
+
+    return true;
+}
+
+// Processes a prepared job and hands the result to the writer, which counts the failed saves in saveErrors;
+// returns false if the processing went wrong
+bool processAndSave (CliJob& cliJob, const OutputSettings& output, rtengine::ImageWriter& writer, std::atomic<unsigned int>& saveErrors)
+{
+    int errorCode;
+    rtengine::IImage* resultImage;
+
+    if (output.isFloat) {
+        resultImage = rtengine::processImageFloat (cliJob.job, errorCode, nullptr, options.tunnelMetaData);
+    } else {
+        resultImage = rtengine::processImage (cliJob.job, errorCode, nullptr, options.tunnelMetaData);
+    }
+
+    if( !resultImage ) {
+        std::cerr << "Error processing: " << cliJob.inputFile << std::endl;
+        rtengine::ProcessingJob::destroy( cliJob.job );
+        return false;
+    }
+
+    // the image holds a copy of the metadata
+    cliJob.ii->decreaseRef();
+
+    // encoded and written while the next files are processed
+    writer.push (resultImage, [cliJob, output, &saveErrors](rtengine::IImage* img) mutable {
+        if (!save (cliJob, output, img)) {
+            ++saveErrors;
+        }
+    });
+
+    return true;
+}
+
+/*
+ * Runs several jobs concurrently. A job is admitted only if a slot is free and if its estimated memory
+ * footprint fits in the memory budget (a job is always admitted when nothing else is running). The OpenMP
+ * threads are split evenly between the slots. The results are written by an ImageWriter, which frees the slot.
+ */
+class JobScheduler :
+    public rtengine::NonCopyable
+{
+public:
+    JobScheduler (unsigned int maxJobs, std::size_t memoryBudget, rtengine::ImageWriter& writer, std::atomic<unsigned int>& saveErrors) :
+        maxJobs_(std::max(maxJobs, 1u)),
+        threadsPerJob_(1),
+        memoryBudget_(memoryBudget),
+        memoryUsed_(0),
+        running_(0),
+        errors_(0),
+        writer_(writer),
+        saveErrors_(saveErrors),
+        threadPool_(maxJobs_, 0)
+    {
+#ifdef _OPENMP
+        threadsPerJob_ = std::max(omp_get_num_procs() / int(maxJobs_), 1);
+#endif
+    }
+
+    ~JobScheduler ()
+    {
+        wait ();
+    }
+
+    // Blocks until the job can be admitted, then runs it in the thread pool
+    void submit (const CliJob& cliJob, const OutputSettings& output, std::size_t memory)
+    {
+        Glib::Threads::Mutex::Lock lock(mutex_);
+
+        while (running_ > 0 && (running_ >= maxJobs_ || (memoryBudget_ > 0 && memoryUsed_ + memory > memoryBudget_))) {
+            finished_.wait(mutex_);
+        }
+
+        if (memoryBudget_ > 0 && memory > memoryBudget_) {
+            std::cout << "  Warning: the estimated memory usage (" << (memory >> 20) << " MiB) exceeds the memory budget" << std::endl;
+        }
+
+        ++running_;
+        memoryUsed_ += memory;
+
+        threadPool_.push(sigc::bind(sigc::mem_fun(*this, &JobScheduler::run), cliJob, output, memory));
+    }
+
+    // Waits for all the submitted jobs to complete
+    void wait ()
+    {
+        Glib::Threads::Mutex::Lock lock(mutex_);
+
+        while (running_ > 0) {
+            finished_.wait(mutex_);
+        }
+    }
+
+    unsigned int getErrors ()
+    {
+        Glib::Threads::Mutex::Lock lock(mutex_);
+        return errors_;
+    }
+
+    unsigned int getThreadsPerJob () const
+    {
+        return threadsPerJob_;
+    }
+
+private:
+    void run (CliJob cliJob, OutputSettings output, std::size_t memory)
+    {
+#ifdef _OPENMP
+        // the number of threads is a per-thread setting, it has to be set in the worker thread
+        omp_set_num_threads(threadsPerJob_);
+#endif
+
+        const bool success = processAndSave (cliJob, output, writer_, saveErrors_);
+
+        Glib::Threads::Mutex::Lock lock(mutex_);
+
+        if (!success) {
+            ++errors_;
+        }
+
+        --running_;
+        memoryUsed_ -= memory;
+        finished_.broadcast();
+    }
+
+    const unsigned int maxJobs_;
+    unsigned int threadsPerJob_;
+    const std::size_t memoryBudget_;
+    std::size_t memoryUsed_;
+    unsigned int running_;
+    unsigned int errors_;
+    rtengine::ImageWriter& writer_;
+    std::atomic<unsigned int>& saveErrors_;
+
+    // Need to be a Glib::Threads::Mutex because used in a Glib::Threads::Cond object
+    Glib::Threads::Mutex mutex_;
+    Glib::Threads::Cond finished_;
+
+    Glib::ThreadPool threadPool_;
+};
+
 }
 
 /* Process line command options
@@ -238,6 +431,8 @@ int main(int argc, char **argv)
     std::cout << "RawTherapee, version " << RTVERSION << ", command line" << std::endl;
     if (argc > 1) {
         ret = processLineParams(argc, argv);
+        rtengine::Profiler::getInstance().write();
+        rtengine::FFTWPlanCache::getInstance().saveWisdom();
     }
     else {
         std::cout << "Terminating without anything to do." << std::endl;
@@ -293,7 +488,10 @@ int processLineParams( int argc, char **argv )
     int compression = 92;
     int subsampling = 3;
     int bits = -1;
+    bool isFloat = false;
     std::string outputType = "";
+    unsigned int concurrentJobs = 1;
+    std::size_t memoryBudget = 0;
     unsigned errors = 0;
 
     for( int iArg = 1; iArg < argc; iArg++) {
@@ -388,16 +586,19 @@ int processLineParams( int argc, char **argv )
 
                 break;
 
-            case 'b':
-                sscanf(&argv[iArg][2], "%d", &bits);
+            case 'b': {
+                char floatSuffix = '\0';
+                sscanf(&argv[iArg][2], "%d%c", &bits, &floatSuffix);
+                isFloat = bits == 32 || floatSuffix == 'f';
 
-                if (bits != 8 && bits != 16) {
-                    std::cerr << "Error: specify -b8 for 8-bit or -b16 for 16-bit output." << std::endl;
+                if ((bits != 8 && bits != 16 && bits != 32) || (floatSuffix != '\0' && floatSuffix != 'f') || (bits == 8 && isFloat)) {
+                    std::cerr << "Error: specify -b8 for 8-bit, -b16 for 16-bit, -b16f for 16-bit float or -b32 for 32-bit float output." << std::endl;
                     deleteProcParams(processingParams);
                     return -3;
                 }
 
                 break;
+            }
 
             case 't':
                 outputType = "tif";
@@ -412,6 +613,51 @@ int processLineParams( int argc, char **argv )
             case 'f':
                 fast_export = true;
                 break;
+
+            case 'J': {
+                int jobs = -1;
+                sscanf(&argv[iArg][2], "%d", &jobs);
+
+                if (jobs < 0) {
+                    std::cerr << "Error: the -J switch requires a positive value, or 0 to let RawTherapee choose!" << std::endl;
+                    deleteProcParams(processingParams);
+                    return -3;
+                }
+
+                if (jobs == 0) {
+                    // most processing stages stop scaling beyond 8 threads
+                    jobs = 1;
+#ifdef _OPENMP
+                    jobs = std::max(omp_get_num_procs() / 8, 1);
+#endif
+                }
+
+                concurrentJobs = jobs;
+                break;
+            }
+
+            case '-':
+                if (strcmp(argv[iArg], "--mem-budget") == 0 && iArg + 1 < argc) {
+                    iArg++;
+                    unsigned long budget = 0;
+
+                    if (sscanf(argv[iArg], "%lu", &budget) != 1 || budget == 0) {
+                        std::cerr << "Error: the value accompanying the --mem-budget switch has to be a positive amount of MiB!" << std::endl;
+                        deleteProcParams(processingParams);
+                        return -3;
+                    }
+
+                    memoryBudget = std::size_t(budget) << 20;
+                } else if (strcmp(argv[iArg], "--profile") == 0 && iArg + 1 < argc) {
+                    iArg++;
+                    rtengine::Profiler::getInstance().enable(fname_to_utf8(argv[iArg]));
+                } else {
+                    std::cerr << "Error: unknown option \"" << argv[iArg] << "\"" << std::endl;
+                    deleteProcParams(processingParams);
+                    return -3;
+                }
+
+                break;
                 
             case 'c': // MUST be last option
                 while (iArg + 1 < argc) {
@@ -497,7 +743,7 @@ int processLineParams( int argc, char **argv )
                 std::cout << std::endl;
 #endif
                 std::cout << "Options:" << std::endl;
-                std::cout << "  " << Glib::path_get_basename(argv[0]) << " [-o <output>|-O <output>] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] [-js<1-3>] | [-b<8|16>] [-t[z] | [-n]] ] [-Y] [-f] -c <input>" << std::endl;
+                std::cout << "  " << Glib::path_get_basename(argv[0]) << " [-o <output>|-O <output>] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] [-js<1-3>] | [-b<8|16|16f|32>] [-t[z] | [-n]] ] [-Y] [-f] [-J<n>] [--mem-budget <MiB>] [--profile <trace.json>] -c <input>" << std::endl;
                 std::cout << std::endl;
                 std::cout << "  -q               Quick Start mode : do not load cached files to speedup start time." << std::endl;
                 std::cout << "  -c <files>       Specify one or more input files." << std::endl;
@@ -524,14 +770,21 @@ int processLineParams( int argc, char **argv )
                 std::cout << "                       Chroma halved horizontally." << std::endl;
                 std::cout << "                   3 = Best quality:       1x1, 1x1, 1x1 (4:4:4)" << std::endl;
                 std::cout << "                       No chroma subsampling." << std::endl;
-                std::cout << "  -b<8|16>         Specify bit depth per channel (default value: 16 for TIFF, 8 for PNG)." << std::endl;
+                std::cout << "  -b<8|16|16f|32>  Specify bit depth per channel (default value: 16 for TIFF, 8 for PNG)." << std::endl;
                 std::cout << "                   Only applies to TIFF and PNG output, JPEG is always 8." << std::endl;
+                std::cout << "                   16f (half) and 32 are floating point, for TIFF output only." << std::endl;
                 std::cout << "  -t[z]            Specify output to be TIFF." << std::endl;
                 std::cout << "                   Uncompressed by default, or deflate compression with 'z'." << std::endl;
                 std::cout << "  -n               Specify output to be compressed PNG." << std::endl;
                 std::cout << "                   Compression is hard-coded to 6." << std::endl;
                 std::cout << "  -Y               Overwrite output if present." << std::endl;
                 std::cout << "  -f               Use the custom fast-export processing pipeline." << std::endl;
+                std::cout << "  -J<n>            Process up to n files concurrently (default: 1)." << std::endl;
+                std::cout << "                   The processing threads are split between the files; 0 chooses n from the number of cores." << std::endl;
+                std::cout << "  --mem-budget <MiB>  Only start processing a file if its estimated memory usage fits, together with" << std::endl;
+                std::cout << "                   the files being processed, in the given amount of memory. Only useful with -J." << std::endl;
+                std::cout << "  --profile <trace.json>  Record the time spent in each processing stage and write it as a Chrome" << std::endl;
+                std::cout << "                   trace file (chrome://tracing). Can also be enabled with the RT_PROFILE environment variable." << std::endl;
                 std::cout << std::endl;
                 std::cout << "Your " << pparamsExt << " files can be incomplete, RawTherapee will build the final values as follows:" << std::endl;
                 std::cout << "  1- A new processing profile is created using neutral values," << std::endl;
@@ -575,6 +828,12 @@ int processLineParams( int argc, char **argv )
         }
     }
 
+    if (isFloat && outputType != "tif") {
+        std::cerr << "Error: floating point output is only supported for TIFF files." << std::endl;
+        deleteProcParams(processingParams);
+        return -3;
+    }
+
     if( !argv1.empty() ) {
         return 1;
     }
@@ -609,8 +868,38 @@ int processLineParams( int argc, char **argv )
         }
     }
 
+    if( outputType.empty() ) {
+        outputType = "jpg";
+    }
+
+    const OutputSettings output = {outputType, compression, subsampling, bits, isFloat, copyParamsFile};
+
+    // declared before the scheduler, whose jobs push to it
+    rtengine::ImageWriter writer (concurrentJobs, concurrentJobs);
+    std::atomic<unsigned int> saveErrors (0);
+
+    std::unique_ptr<JobScheduler> scheduler;
+
+    if (concurrentJobs > 1 || memoryBudget > 0) {
+        scheduler.reset (new JobScheduler (concurrentJobs, memoryBudget, writer, saveErrors));
+        std::cout << "Processing up to " << concurrentJobs << " files concurrently, " << scheduler->getThreadsPerJob () << " thread(s) each" << std::endl;
+    }
+
+    const size_t prefetchCount = std::max (options.rtSettings.inputPrefetch, 0);
+
     for( size_t iFile = 0; iFile < inputFiles.size(); iFile++) {
 
+        // Reads the next files ahead while this one is processed. The files
+        // before the last one of the window have been read ahead already.
+        if (prefetchCount > 0) {
+            const size_t first = iFile == 0 ? 1 : iFile + prefetchCount;
+            const size_t last = std::min (iFile + prefetchCount + 1, inputFiles.size());
+
+            if (first < last) {
+                rtengine::prefetchFiles (std::vector<Glib::ustring> (inputFiles.begin() + first, inputFiles.begin() + last));
+            }
+        }
+
         // Has to be reinstanciated at each profile to have a ProcParams object with default values
         rtengine::procparams::ProcParams currentParams;
 
@@ -624,10 +913,6 @@ int processLineParams( int argc, char **argv )
 
         Glib::ustring outputFile;
 
-        if( outputType.empty() ) {
-            outputType = "jpg";
-        }
-
         if( outputPath.empty() ) {
             Glib::ustring s = inputFile;
             Glib::ustring::size_type ext = s.find_last_of('.');
@@ -730,41 +1015,23 @@ int processLineParams( int argc, char **argv )
             continue;
         }
 
-        // Process image
-        rtengine::IImage16* resultImage = rtengine::processImage (job, errorCode, nullptr, options.tunnelMetaData);
-
-        if( !resultImage ) {
-            errors++;
-            std::cerr << "Error processing: " << inputFile << std::endl;
-            rtengine::ProcessingJob::destroy( job );
-            continue;
-        }
-
-        // save image to disk
-        if( outputType == "jpg" ) {
-            errorCode = resultImage->saveAsJPEG( outputFile, compression, subsampling );
-        } else if( outputType == "tif" ) {
-            errorCode = resultImage->saveAsTIFF( outputFile, bits, compression == 0  );
-        } else if( outputType == "png" ) {
-            errorCode = resultImage->saveAsPNG( outputFile, compression, bits );
-        } else {
-            errorCode = resultImage->saveToFile (outputFile);
-        }
+        CliJob cliJob = {job, ii, currentParams, inputFile, outputFile};
 
-        if(errorCode) {
+        if (scheduler) {
+            scheduler->submit (cliJob, output, rtengine::estimateProcessingMemory (job));
+        } else if (!processAndSave (cliJob, output, writer, saveErrors)) {
             errors++;
-            std::cerr << "Error saving to: " << outputFile << std::endl;
-        } else {
-            if( copyParamsFile ) {
-                Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
-                currentParams.save( outputProcessingParams );
-            }
         }
+    }
 
-        ii->decreaseRef();
-        resultImage->free();
+    if (scheduler) {
+        scheduler->wait ();
+        errors += scheduler->getErrors ();
     }
 
+    writer.wait ();
+    errors += saveErrors;
+
     if (imgParams) {
         imgParams->deleteInstance();
         delete imgParams;
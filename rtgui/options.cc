@@ -305,6 +305,7 @@ void Options::setDefaults ()
     saveFormat.pngBits = 8;
     saveFormat.tiffBits = 16;
     saveFormat.tiffUncompressed = true;
+    saveFormat.tiffFloat = false;
     saveFormat.saveParams = true;
 
     saveFormatBatch.format = "jpg";
@@ -314,6 +315,7 @@ void Options::setDefaults ()
     saveFormatBatch.pngBits = 8;
     saveFormatBatch.tiffBits = 16;
     saveFormatBatch.tiffUncompressed = true;
+    saveFormatBatch.tiffFloat = false;
     saveFormatBatch.saveParams = true;
 
     savePathTemplate = "%p1/converted/%f";
@@ -425,6 +427,9 @@ void Options::setDefaults ()
     curvebboxpos = 1;
     prevdemo = PD_Sidecar;
     rgbDenoiseThreadLimit = 0;
+    thumbnailDecodeLimit = 2;
+    batchQueueJobs = 1;
+    batchQueueMemoryBudget = 0;
 #if defined( _OPENMP ) && defined( __x86_64__ )
     clutCacheSize = omp_get_num_procs();
 #else
@@ -681,6 +686,16 @@ void Options::setDefaults ()
     rtSettings.HistogramWorking = false;
 
     rtSettings.daubech = false;
+    rtSettings.tiledExport = false;
+    rtSettings.tiledExportMemory = 8192;
+    rtSettings.demosaicCache = false;
+    rtSettings.demosaicCacheSize = 4096;
+    rtSettings.fusedCurves = false;
+    rtSettings.resizeEarly = false;
+    rtSettings.resizeEarlyMaxScale = 0.5;
+    rtSettings.mmapInput = true;
+    rtSettings.inputPrefetch = 2;
+    rtSettings.cpuTarget = "auto";
 
     rtSettings.nrauto = 10;//between 2 and 20
     rtSettings.nrautomax = 40;//between 5 and 100
@@ -901,6 +916,12 @@ int Options::readFromFile (Glib::ustring fname)
                     saveFormat.tiffUncompressed = keyFile.get_boolean ("Output", "TiffUncompressed");
                 }
 
+                if (keyFile.has_key ("Output", "TiffFloat")) {
+                    saveFormat.tiffFloat       = keyFile.get_boolean ("Output", "TiffFloat");
+                }
+
+                saveFormat.checkTiffFloat ();
+
                 if (keyFile.has_key ("Output", "SaveProcParams")) {
                     saveFormat.saveParams      = keyFile.get_boolean ("Output", "SaveProcParams");
                 }
@@ -934,6 +955,12 @@ int Options::readFromFile (Glib::ustring fname)
                     saveFormatBatch.tiffUncompressed = keyFile.get_boolean ("Output", "TiffUncompressedBatch");
                 }
 
+                if (keyFile.has_key ("Output", "TiffFloatBatch")) {
+                    saveFormatBatch.tiffFloat       = keyFile.get_boolean ("Output", "TiffFloatBatch");
+                }
+
+                saveFormatBatch.checkTiffFloat ();
+
                 if (keyFile.has_key ("Output", "SaveProcParamsBatch")) {
                     saveFormatBatch.saveParams      = keyFile.get_boolean ("Output", "SaveProcParamsBatch");
                 }
@@ -1176,6 +1203,18 @@ int Options::readFromFile (Glib::ustring fname)
                     rgbDenoiseThreadLimit      = keyFile.get_integer ("Performance", "RgbDenoiseThreadLimit");
                 }
 
+                if (keyFile.has_key ("Performance", "ThumbnailDecodeLimit")) {
+                    thumbnailDecodeLimit       = keyFile.get_integer ("Performance", "ThumbnailDecodeLimit");
+                }
+
+                if (keyFile.has_key ("Performance", "BatchQueueJobs")) {
+                    batchQueueJobs             = keyFile.get_integer ("Performance", "BatchQueueJobs");
+                }
+
+                if (keyFile.has_key ("Performance", "BatchQueueMemoryBudget")) {
+                    batchQueueMemoryBudget     = keyFile.get_integer ("Performance", "BatchQueueMemoryBudget");
+                }
+
                 if ( keyFile.has_key ("Performance", "NRauto")) {
                     rtSettings.nrauto          = keyFile.get_double  ("Performance", "NRauto");
                 }
@@ -1235,6 +1274,50 @@ int Options::readFromFile (Glib::ustring fname)
                 if (keyFile.has_key ("Performance", "SerializeTiffRead")) {
                     serializeTiffRead          = keyFile.get_boolean ("Performance", "SerializeTiffRead");
                 }
+
+                if (keyFile.has_key ("Performance", "TiledExport")) {
+                    rtSettings.tiledExport     = keyFile.get_boolean ("Performance", "TiledExport");
+                }
+
+                if (keyFile.has_key ("Performance", "TiledExportMemory")) {
+                    rtSettings.tiledExportMemory = keyFile.get_integer ("Performance", "TiledExportMemory");
+                }
+
+                if (rtSettings.tiledExportMemory < 1024) { // the strip height is computed from it, keep at least 1 MiB
+                    rtSettings.tiledExportMemory = 1024;
+                }
+
+                if (keyFile.has_key ("Performance", "DemosaicCache")) {
+                    rtSettings.demosaicCache     = keyFile.get_boolean ("Performance", "DemosaicCache");
+                }
+
+                if (keyFile.has_key ("Performance", "DemosaicCacheSize")) {
+                    rtSettings.demosaicCacheSize = keyFile.get_integer ("Performance", "DemosaicCacheSize");
+                }
+
+                if (keyFile.has_key ("Performance", "FusedCurves")) {
+                    rtSettings.fusedCurves       = keyFile.get_boolean ("Performance", "FusedCurves");
+                }
+
+                if (keyFile.has_key ("Performance", "ResizeEarly")) {
+                    rtSettings.resizeEarly       = keyFile.get_boolean ("Performance", "ResizeEarly");
+                }
+
+                if (keyFile.has_key ("Performance", "ResizeEarlyMaxScale")) {
+                    rtSettings.resizeEarlyMaxScale = keyFile.get_double ("Performance", "ResizeEarlyMaxScale");
+                }
+
+                if (keyFile.has_key ("Performance", "MemoryMappedInput")) {
+                    rtSettings.mmapInput         = keyFile.get_boolean ("Performance", "MemoryMappedInput");
+                }
+
+                if (keyFile.has_key ("Performance", "InputPrefetch")) {
+                    rtSettings.inputPrefetch     = keyFile.get_integer ("Performance", "InputPrefetch");
+                }
+
+                if (keyFile.has_key ("Performance", "CpuTarget")) {
+                    rtSettings.cpuTarget         = keyFile.get_string  ("Performance", "CpuTarget");
+                }
             }
 
             if (keyFile.has_group ("GUI")) {
@@ -1946,6 +2029,9 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_boolean ("Clipping Indication", "BlinkClipped", blinkClipped);
 
         keyFile.set_integer ("Performance", "RgbDenoiseThreadLimit", rgbDenoiseThreadLimit);
+        keyFile.set_integer ("Performance", "ThumbnailDecodeLimit", thumbnailDecodeLimit);
+        keyFile.set_integer ("Performance", "BatchQueueJobs", batchQueueJobs);
+        keyFile.set_integer ("Performance", "BatchQueueMemoryBudget", batchQueueMemoryBudget);
         keyFile.set_double  ("Performance", "NRauto", rtSettings.nrauto);
         keyFile.set_double  ("Performance", "NRautomax", rtSettings.nrautomax);
         keyFile.set_double  ("Performance", "NRhigh", rtSettings.nrhigh);
@@ -1960,6 +2046,16 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_integer ("Performance", "PreviewDemosaicFromSidecar", prevdemo);
         keyFile.set_boolean ("Performance", "Daubechies", rtSettings.daubech);
         keyFile.set_boolean ("Performance", "SerializeTiffRead", serializeTiffRead);
+        keyFile.set_boolean ("Performance", "TiledExport", rtSettings.tiledExport);
+        keyFile.set_integer ("Performance", "TiledExportMemory", rtSettings.tiledExportMemory);
+        keyFile.set_boolean ("Performance", "DemosaicCache", rtSettings.demosaicCache);
+        keyFile.set_integer ("Performance", "DemosaicCacheSize", rtSettings.demosaicCacheSize);
+        keyFile.set_boolean ("Performance", "FusedCurves", rtSettings.fusedCurves);
+        keyFile.set_boolean ("Performance", "ResizeEarly", rtSettings.resizeEarly);
+        keyFile.set_double  ("Performance", "ResizeEarlyMaxScale", rtSettings.resizeEarlyMaxScale);
+        keyFile.set_boolean ("Performance", "MemoryMappedInput", rtSettings.mmapInput);
+        keyFile.set_integer ("Performance", "InputPrefetch", rtSettings.inputPrefetch);
+        keyFile.set_string  ("Performance", "CpuTarget", rtSettings.cpuTarget);
 
         keyFile.set_string  ("Output", "Format", saveFormat.format);
         keyFile.set_integer ("Output", "JpegQuality", saveFormat.jpegQuality);
@@ -1968,6 +2064,7 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_integer ("Output", "PngBps", saveFormat.pngBits);
         keyFile.set_integer ("Output", "TiffBps", saveFormat.tiffBits);
         keyFile.set_boolean ("Output", "TiffUncompressed", saveFormat.tiffUncompressed);
+        keyFile.set_boolean ("Output", "TiffFloat", saveFormat.tiffFloat);
         keyFile.set_boolean ("Output", "SaveProcParams", saveFormat.saveParams);
 
         keyFile.set_string  ("Output", "FormatBatch", saveFormatBatch.format);
@@ -1977,6 +2074,7 @@ int Options::saveToFile (Glib::ustring fname)
         keyFile.set_integer ("Output", "PngBpsBatch", saveFormatBatch.pngBits);
         keyFile.set_integer ("Output", "TiffBpsBatch", saveFormatBatch.tiffBits);
         keyFile.set_boolean ("Output", "TiffUncompressedBatch", saveFormatBatch.tiffUncompressed);
+        keyFile.set_boolean ("Output", "TiffFloatBatch", saveFormatBatch.tiffFloat);
         keyFile.set_boolean ("Output", "SaveProcParamsBatch", saveFormatBatch.saveParams);
 
         keyFile.set_string  ("Output", "PathTemplate", savePathTemplate);
@@ -2271,6 +2369,8 @@ bool Options::load (bool lightweight)
         printf ("Cache directory (cacheBaseDir) = %s\n", cacheBaseDir.c_str());
     }
 
+    options.rtSettings.cacheDirectory = cacheBaseDir;
+
     // Update profile's path and recreate it if necessary
     options.updatePaths();
 
@@ -52,6 +52,7 @@ struct SaveFormat
         jpegSubSamp(2),
         tiffBits(8),
         tiffUncompressed(true),
+        tiffFloat(false),
         saveParams(true)
     {
     }
@@ -61,9 +62,18 @@ struct SaveFormat
     int pngCompression;
     int jpegQuality;
     int jpegSubSamp;  // 1=best compression, 3=best quality
-    int tiffBits;
+    int tiffBits;     // 16 or 32 if tiffFloat
     bool tiffUncompressed;
+    bool tiffFloat;   // floating point samples, without the quantization to 16 bits
     bool saveParams;
+
+    // floating point samples are written with 16 or 32 bits, other depths read from a file fall back to 32 bits
+    void checkTiffFloat ()
+    {
+        if (tiffFloat && tiffBits != 16 && tiffBits != 32) {
+            tiffBits = 32;
+        }
+    }
 };
 
 enum ThFileType {FT_Invalid = -1, FT_None = 0, FT_Raw = 1, FT_Jpeg = 2, FT_Tiff = 3, FT_Png = 4, FT_Custom = 5, FT_Tiff16 = 6, FT_Png16 = 7, FT_Custom16 = 8};
@@ -240,6 +250,9 @@ public:
     // Performance options
     Glib::ustring clutsDir;
     int rgbDenoiseThreadLimit; // maximum number of threads for the denoising tool ; 0 = use the maximum available
+    int thumbnailDecodeLimit;  // maximum number of thumbnail jobs decoding a raw file at once ; 0 = no limit
+    int batchQueueJobs;        // number of batch queue entries processed at once
+    int batchQueueMemoryBudget; // in MiB, a batch queue entry is started only if its estimated memory usage fits ; 0 = no limit
     int maxInspectorBuffers;   // maximum number of buffers (i.e. images) for the Inspector feature
     int clutCacheSize;
     bool filledProfile;  // Used as reminder for the ProfilePanel "mode"
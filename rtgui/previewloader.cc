@@ -17,14 +17,10 @@
  *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <set>
+#include <atomic>
 #include "previewloader.h"
 #include "guiutils.h"
-#include "threadutils.h"
-
-#ifdef _OPENMP
-#include <omp.h>
-#endif
+#include "thumbnailscheduler.h"
 
 #define DEBUG(format,args...)
 //#define DEBUG(format,args...) printf("PreviewLoader::%s: " format "\n", __FUNCTION__, ## args)
@@ -33,132 +29,69 @@ class PreviewLoader::Impl :
     public rtengine::NonCopyable
 {
 public:
-    struct Job {
-        Job(int dir_id, const Glib::ustring& dir_entry, PreviewLoaderListener* listener):
-            dir_id_(dir_id),
-            dir_entry_(dir_entry),
-            listener_(listener)
-        {}
-
-        Job():
-            dir_id_(0),
-            listener_(nullptr)
-        {}
-
-        int dir_id_;
-        Glib::ustring dir_entry_;
-        PreviewLoaderListener* listener_;
-    };
-    /* Issue 2406
-        struct OutputJob
-        {
-            bool complete;
-            int dir_id;
-            PreviewLoaderListener* listener;
-            FileBrowserEntry* fdn;
-        };
-    */
-    struct JobCompare {
-        bool operator()(const Job& lhs, const Job& rhs)
-        {
-            if ( lhs.dir_id_ == rhs.dir_id_ ) {
-                return lhs.dir_entry_ < rhs.dir_entry_;
-            }
-
-            return lhs.dir_id_ < rhs.dir_id_;
-        }
-    };
-
-    typedef std::set<Job, JobCompare> JobSet;
+    // Loading previews comes after updating the visible thumbnails
+    // and before the thumbnails outside of the browser window
+    static constexpr int priority = 1;
 
-    Impl(): nConcurrentThreads(0)
+    Impl(): pending(0)
     {
-#ifdef _OPENMP
-        int threadCount = omp_get_num_procs();
-#else
-        int threadCount = 2;
-#endif
-
-        threadPool_ = new Glib::ThreadPool(threadCount, 0);
     }
 
-    Glib::ThreadPool* threadPool_;
-    MyMutex mutex_;
-    JobSet jobs_;
-    gint nConcurrentThreads;
-// Issue 2406   std::vector<OutputJob *> output_;
+    // queued and running jobs, to detect when the last one has finished
+    std::atomic<int> pending;
 
-    void processNextJob()
+    // decode: true if the entry is not in the cache and the file has to be decoded
+    void addJob(int dir_id, const Glib::ustring& dir_entry, PreviewLoaderListener* l, bool decode)
     {
-        Job j;
-// Issue 2406       OutputJob *oj;
-        {
-            MyMutex::MyLock lock(mutex_);
-
-            // nothing to do; could be jobs have been removed
-            if ( jobs_.empty() ) {
-                DEBUG("processing: nothing to do");
-                return;
+        ++pending;
+
+        const bool added = ThumbnailScheduler::getInstance()->add(
+            this,
+            l,
+            Glib::ustring::compose("%1:%2", dir_id, dir_entry),
+            []() {
+                return priority;
+            },
+            decode,
+            [this, dir_id, dir_entry, l, decode]() {
+                processJob(dir_id, dir_entry, l, decode);
             }
+        );
 
-            // copy and remove front job
-            j = *jobs_.begin();
-            jobs_.erase(jobs_.begin());
-            DEBUG("processing %s", j.dir_entry_.c_str());
-            DEBUG("%d job(s) remaining", jobs_.size());
-            /* Issue 2406
-                        oj = new OutputJob();
-                        oj->complete = false;
-                        oj->dir_id = j.dir_id_;
-                        oj->listener = j.listener_;
-                        oj->fdn = 0;
-                        output_.push_back(oj);
-            */
+        // the job it replaced may have finished meanwhile
+        if (!added && --pending == 0) {
+            l->previewsFinished(dir_id);
         }
+    }
 
-        g_atomic_int_inc (&nConcurrentThreads);  // to detect when last thread in pool has run out
+    void processJob(int dir_id, const Glib::ustring& dir_entry, PreviewLoaderListener* listener, bool decode)
+    {
+        DEBUG("processing %s", dir_entry.c_str());
 
-        // unlock and do processing; will relock on block exit, then call listener
-        // if something got
-// Issue 2406       FileBrowserEntry* fdn = 0;
         try {
             Thumbnail* tmb = nullptr;
             {
-                if (Glib::file_test(j.dir_entry_, Glib::FILE_TEST_EXISTS)) {
-                    tmb = cacheMgr->getEntry(j.dir_entry_);
+                if (Glib::file_test(dir_entry, Glib::FILE_TEST_EXISTS)) {
+                    tmb = cacheMgr->getEntry(dir_entry, decode);
+
+                    if (!tmb && !decode) {
+                        // not in the cache, so the file is decoded by a job of its own: only those are
+                        // held back by the decode limit, the cache is read by as many jobs as there are workers
+                        addJob(dir_id, dir_entry, listener, true);
+                    }
                 }
             }
 
             if ( tmb ) {
                 DEBUG("Preview Ready\n");
-                j.listener_->previewReady(j.dir_id_, new FileBrowserEntry(tmb, j.dir_entry_));
-// Issue 2406               fdn = new FileBrowserEntry(tmb,j.dir_entry_);
+                listener->previewReady(dir_id, new FileBrowserEntry(tmb, dir_entry));
             }
 
         } catch (Glib::Error &e) {} catch(...) {}
 
-        /* Issue 2406
-                {
-                    // the purpose of the output_ vector is to deliver the previewReady() calls in the same
-                    // order as we got the jobs from the jobs_ queue.
-                    MyMutex::MyLock lock(mutex_);
-                    oj->fdn = fdn;
-                    oj->complete = true;
-                    while (output_.size() > 0 && output_.front()->complete) {
-                        oj = output_.front();
-                        if (oj->fdn) {
-                            oj->listener->previewReady(oj->dir_id,oj->fdn);
-                        }
-                        output_.erase(output_.begin());
-                        delete oj;
-                    }
-                }
-        */
-        bool last = g_atomic_int_dec_and_test (&nConcurrentThreads);
-
         // signal at end
-        if (last && jobs_.empty()) {
-            j.listener_->previewsFinished(j.dir_id_);
+        if (--pending == 0) {
+            listener->previewsFinished(dir_id);
         }
     }
 };
@@ -178,25 +111,15 @@ void PreviewLoader::add(int dir_id, const Glib::ustring& dir_entry, PreviewLoade
 {
     // somebody listening?
     if ( l != nullptr ) {
-        {
-            MyMutex::MyLock lock(impl_->mutex_);
+        DEBUG("saving job %s", dir_entry.c_str());
 
-            // create a new job and append to queue
-            DEBUG("saving job %s", dir_entry.c_str());
-            impl_->jobs_.insert(Impl::Job(dir_id, dir_entry, l));
-        }
-
-        // queue a run request
-        DEBUG("adding run request %s", dir_entry.c_str());
-        impl_->threadPool_->push(sigc::mem_fun(*impl_, &PreviewLoader::Impl::processNextJob));
+        // the entry is looked up in the cache first, another job decodes the file if needed
+        impl_->addJob(dir_id, dir_entry, l, false);
     }
 }
 
 void PreviewLoader::removeAllJobs()
 {
-    DEBUG("stop %d", impl_->nConcurrentThreads);
-    MyMutex::MyLock lock(impl_->mutex_);
-    impl_->jobs_.clear();
+    DEBUG("stop");
+    impl_->pending -= ThumbnailScheduler::getInstance()->cancel(impl_, nullptr, false);
 }
-
-
@@ -19,7 +19,6 @@
 #ifndef _PREVIEWLOADER_
 #define _PREVIEWLOADER_
 
-#include <set>
 #include <glibmm.h>
 
 #include "../rtengine/noncopyable.h"
@@ -67,8 +66,8 @@ public:
     /**
      * @brief Add an thumbnail image update request.
      *
-     * Code will add the request to the queue and, if needed, start a pool
-     * thread to process it.
+     * Code will add the request to the queue of the ThumbnailScheduler, ahead
+     * of the thumbnail image updates of the entries out of view.
      *
      * @param dir_id directory we're looking at
      * @param dir_entry entry in it
@@ -0,0 +1,767 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * rtbench: times individual engine kernels on deterministic synthetic input.
+ *
+ * Every kernel is run on images of several sizes and with several OpenMP
+ * thread counts; the best of a few runs is reported as throughput in
+ * megapixels per second. Results can be saved and later compared against,
+ * so that a regression of a single stage shows up without any raw file or
+ * network access.
+ */
+
+#ifdef __GNUC__
+#if defined(__FAST_MATH__)
+#error Using the -ffast-math CFLAG is known to lead to problems. Disable it to compile RawTherapee.
+#endif
+#endif
+
+#include "config.h"
+#include <giomm.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <locale.h>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "options.h"
+#include "../rtengine/rtengine.h"
+#include "../rtengine/rawimagesource.h"
+#include "../rtengine/improcfun.h"
+#include "../rtengine/curves.h"
+#include "../rtengine/gauss.h"
+#include "../rtengine/cieimage.h"
+#include "../rtengine/labimage.h"
+#include "../rtengine/color.h"
+#include "../rtengine/rawunpack.h"
+#include "../rtengine/cpudispatch.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+extern Options options;
+
+// stores path to data files
+Glib::ustring argv0;
+Glib::ustring argv1;
+bool simpleEditor;
+
+namespace
+{
+
+using namespace rtengine;
+using namespace rtengine::procparams;
+
+// Small deterministic generator, so that every run and every machine sees the same input
+class Random
+{
+public:
+    explicit Random(unsigned int seed) : state(seed ? seed : 1) {}
+
+    float operator()()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state & 0xffffff) / float(0x1000000);
+    }
+
+private:
+    unsigned int state;
+};
+
+// Smooth gradients with some texture and noise, roughly like a natural image, in [0;1]
+float synthetic(int x, int y, int channel, Random& rnd)
+{
+    const float fx = x * (0.013f + channel * 0.002f);
+    const float fy = y * (0.011f - channel * 0.001f);
+    const float v = 0.45f + 0.25f * std::sin(fx) * std::cos(fy) + 0.15f * std::sin((x + 3 * y) * 0.21f) + 0.05f * rnd();
+    return std::max(0.f, std::min(1.f, v));
+}
+
+class SyntheticRawImage :
+    public RawImage
+{
+public:
+    explicit SyntheticRawImage(bool xtransSensor) :
+        RawImage("")
+    {
+        // pattern of the X-Trans sensor of the X-Pro1, as in dcraw
+        static const char pattern[6][6] = {
+            {1, 1, 0, 1, 1, 2},
+            {1, 1, 2, 1, 1, 0},
+            {2, 0, 1, 0, 2, 1},
+            {1, 1, 2, 1, 1, 0},
+            {1, 1, 0, 1, 1, 2},
+            {0, 2, 1, 2, 0, 1}
+        };
+
+        colors = 3;
+        filters = xtransSensor ? 9 : 0x94949494; // RGGB
+        prefilters = filters;
+
+        for (int row = 0; row < 6; ++row) {
+            for (int col = 0; col < 6; ++col) {
+                xtrans[row][col] = xtrans_abs[row][col] = pattern[row][col];
+            }
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                rgb_cam[i][j] = i == j ? 1.f : 0.f;
+            }
+        }
+    }
+};
+
+// Gives access to the demosaicers on a synthetic mosaic
+class SyntheticRawImageSource :
+    public RawImageSource
+{
+public:
+    SyntheticRawImageSource(int width, int height, bool xtransSensor) :
+        original(width, height)
+    {
+        ri = new SyntheticRawImage(xtransSensor);
+        riFrames[0] = ri;
+        numFrames = 1;
+        W = width;
+        H = height;
+
+        Random rnd(W * 31 + H);
+
+        for (int i = 0; i < H; ++i) {
+            for (int j = 0; j < W; ++j) {
+                const int c = xtransSensor ? ri->XTRANSFC(i, j) : ri->FC(i, j);
+                original[i][j] = 65535.f * synthetic(j, i, c == 3 ? 1 : c, rnd);
+            }
+        }
+
+        rawData(W, H);
+        red(W, H);
+        green(W, H);
+        blue(W, H);
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < H; ++i) {
+            memcpy(rawData[i], original[i], W * sizeof(float));
+        }
+    }
+
+private:
+    array2D<float> original;
+};
+
+void fill(Imagefloat& img)
+{
+    Random rnd(img.getWidth() * 17 + img.getHeight());
+
+    for (int i = 0; i < img.getHeight(); ++i) {
+        for (int j = 0; j < img.getWidth(); ++j) {
+            img.r(i, j) = 65535.f * synthetic(j, i, 0, rnd);
+            img.g(i, j) = 65535.f * synthetic(j, i, 1, rnd);
+            img.b(i, j) = 65535.f * synthetic(j, i, 2, rnd);
+        }
+    }
+}
+
+void fill(LabImage& lab)
+{
+    Random rnd(lab.W * 13 + lab.H);
+
+    for (int i = 0; i < lab.H; ++i) {
+        for (int j = 0; j < lab.W; ++j) {
+            lab.L[i][j] = 32768.f * synthetic(j, i, 0, rnd);
+            lab.a[i][j] = 20000.f * (synthetic(j, i, 1, rnd) - 0.5f);
+            lab.b[i][j] = 20000.f * (synthetic(j, i, 2, rnd) - 0.5f);
+        }
+    }
+}
+
+class Benchmark
+{
+public:
+    virtual ~Benchmark() {}
+    // untimed, called before each run
+    virtual void prepare() {}
+    virtual void run() = 0;
+};
+
+using Factory = std::function<Benchmark* (int width, int height)>;
+
+struct Kernel {
+    std::string name;
+    Factory create;
+};
+
+class DemosaicBenchmark :
+    public Benchmark
+{
+public:
+    DemosaicBenchmark(int width, int height, bool xtransSensor, const char* method, bool binned = false) :
+        src(width, height, xtransSensor), binned(binned)
+    {
+        if (xtransSensor) {
+            raw.xtranssensor.method = method;
+        } else {
+            raw.bayersensor.method = method;
+        }
+    }
+
+    void prepare() override
+    {
+        src.reset();
+    }
+
+    void run() override
+    {
+        src.demosaic(raw, binned);
+    }
+
+private:
+    SyntheticRawImageSource src;
+    RAWParams raw;
+    bool binned;
+};
+
+class GaussianBlurBenchmark :
+    public Benchmark
+{
+public:
+    GaussianBlurBenchmark(int width, int height) :
+        W(width), H(height), src(width, height), dst(width, height)
+    {
+        Random rnd(W + H);
+
+        for (int i = 0; i < H; ++i) {
+            for (int j = 0; j < W; ++j) {
+                src[i][j] = 65535.f * synthetic(j, i, 1, rnd);
+            }
+        }
+    }
+
+    void run() override
+    {
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        gaussianBlur(src, dst, W, H, 5.0);
+    }
+
+private:
+    int W, H;
+    array2D<float> src, dst;
+};
+
+class DenoiseBenchmark :
+    public Benchmark
+{
+public:
+    DenoiseBenchmark(int width, int height) :
+        ipf(&params), src(width, height), dst(width, height), tileData(1024, 0.f)
+    {
+        params.dirpyrDenoise.enabled = true;
+        params.dirpyrDenoise.Cmethod = "MAN";
+        params.dirpyrDenoise.C2method = "MANU";
+        fill(src);
+    }
+
+    void run() override
+    {
+        float chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi;
+        NoiseCurve noiseLCurve, noiseCCurve;
+        ipf.RGB_denoise(2, &src, &dst, nullptr, tileData.data(), tileData.data(), tileData.data(), true, params.dirpyrDenoise, 0.0, noiseLCurve, noiseCCurve, chaut, redaut, blueaut, maxredaut, maxblueaut, nresi, highresi);
+    }
+
+private:
+    ProcParams params;
+    ImProcFunctions ipf;
+    Imagefloat src, dst;
+    std::vector<float> tileData;
+};
+
+class LanczosBenchmark :
+    public Benchmark
+{
+public:
+    LanczosBenchmark(int width, int height) :
+        ipf(&params), src(width, height), dst(width / 2, height / 2)
+    {
+        fill(src);
+    }
+
+    void run() override
+    {
+        ipf.Lanczos(&src, &dst, 0.5f);
+    }
+
+private:
+    ProcParams params;
+    ImProcFunctions ipf;
+    LabImage src, dst;
+};
+
+class RgbProcBenchmark :
+    public Benchmark
+{
+public:
+    RgbProcBenchmark(int width, int height) :
+        ipf(&params), src(width, height), working(width, height), lab(width, height)
+    {
+        fill(src);
+
+        LUTu hist16(65536), dummy;
+        hist16.clear();
+        hlCurve(65536);
+        shCurve(65536);
+        toneCurve(65536, 0);
+        const ToneCurveParams& tc = params.toneCurve;
+        CurveFactory::complexCurve(tc.expcomp, tc.black / 65535.0, tc.hlcompr, tc.hlcomprthresh, tc.shcompr, tc.brightness, tc.contrast,
+                                   tc.curveMode, tc.curve, tc.curveMode2, tc.curve2,
+                                   hist16, hlCurve, shCurve, toneCurve, dummy, customToneCurve1, customToneCurve2);
+        CurveFactory::RGBCurve(params.rgbCurves.rcurve, rCurve, 1);
+        CurveFactory::RGBCurve(params.rgbCurves.gcurve, gCurve, 1);
+        CurveFactory::RGBCurve(params.rgbCurves.bcurve, bCurve, 1);
+    }
+
+    void prepare() override
+    {
+        // rgbProc may alter its input
+        for (int i = 0; i < src.getHeight(); ++i) {
+            for (int j = 0; j < src.getWidth(); ++j) {
+                working.r(i, j) = src.r(i, j);
+                working.g(i, j) = src.g(i, j);
+                working.b(i, j) = src.b(i, j);
+            }
+        }
+    }
+
+    void run() override
+    {
+        double rrm, ggm, bbm;
+        float autor = -9000.f, autog, autob;
+        LUTu histToneCurve;
+        DCPProfile::ApplyState as;
+        ipf.rgbProc(&working, &lab, nullptr, hlCurve, shCurve, toneCurve, nullptr, params.toneCurve.saturation, rCurve, gCurve, bCurve, 1.f, 1.f,
+                    ctColorCurve, ctOpacityCurve, false, clToningCurve, cl2ToningCurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2,
+                    rrm, ggm, bbm, autor, autog, autob, params.toneCurve.expcomp, params.toneCurve.hlcompr, params.toneCurve.hlcomprthresh, nullptr, as, histToneCurve);
+    }
+
+private:
+    ProcParams params;
+    ImProcFunctions ipf;
+    Imagefloat src, working;
+    LabImage lab;
+    LUTf hlCurve, shCurve, toneCurve, rCurve, gCurve, bCurve, clToningCurve, cl2ToningCurve;
+    ToneCurve customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2;
+    ColorGradientCurve ctColorCurve;
+    OpacityCurve ctOpacityCurve;
+};
+
+class CiecamBenchmark :
+    public Benchmark
+{
+public:
+    CiecamBenchmark(int width, int height) :
+        ipf(&params), src(width, height), lab(width, height), cie(width, height)
+    {
+        params.colorappearance.enabled = true;
+        fill(src);
+
+        LUTu hist16(65536), dummy;
+        hist16.clear();
+        CurveFactory::curveLightBrightColor(params.colorappearance.curve, params.colorappearance.curve2, params.colorappearance.curve3,
+                                            hist16, dummy, dummy, dummy, customColCurve1, customColCurve2, customColCurve3, 1);
+    }
+
+    void prepare() override
+    {
+        lab.CopyFrom(&src);
+    }
+
+    void run() override
+    {
+        LUTu dummy;
+        LUTf CAMBrightCurveJ, CAMBrightCurveQ;
+        float CAMMean = NAN;
+        float d;
+        ipf.ciecam_02float(&cie, 2000.f, 0, lab.H, 1, 2, &lab, &params, customColCurve1, customColCurve2, customColCurve3, dummy, dummy, CAMBrightCurveJ, CAMBrightCurveQ, CAMMean, 5, 1, true, d, 1, 1);
+    }
+
+private:
+    ProcParams params;
+    ImProcFunctions ipf;
+    LabImage src, lab;
+    CieImage cie;
+    ColorAppearance customColCurve1, customColCurve2, customColCurve3;
+};
+
+class Lab2Rgb16Benchmark :
+    public Benchmark
+{
+public:
+    Lab2Rgb16Benchmark(int width, int height) :
+        ipf(&params), lab(width, height)
+    {
+        fill(lab);
+    }
+
+    void run() override
+    {
+        delete ipf.lab2rgb16(&lab, 0, 0, lab.W, lab.H, params.icm, false);
+    }
+
+private:
+    ProcParams params;
+    ImProcFunctions ipf;
+    LabImage lab;
+};
+
+// Unpacking of the rows of a packed raw file, as in DCraw::packed_load_raw()
+class UnpackBenchmark :
+    public Benchmark
+{
+public:
+    UnpackBenchmark(int width, int height, int bits) :
+        width(width),
+        height(height),
+        bits(bits),
+        rowBytes((width * bits + 7) / 8),
+        packed(rowBytes * height),
+        raw(static_cast<std::size_t>(width) * height),
+        unpack(getPackedRowUnpacker(bits, 1))
+    {
+        Random rnd(width * 7 + bits);
+
+        for (auto& byte : packed) {
+            byte = 255.f * rnd();
+        }
+    }
+
+    void run() override
+    {
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic,16)
+#endif
+
+        for (int row = 0; row < height; ++row) {
+            const std::uint8_t* src = packed.data() + static_cast<std::size_t>(row) * rowBytes;
+            std::uint16_t* dst = raw.data() + static_cast<std::size_t>(row) * width;
+
+            if (unpack) {
+                unpack(src, rowBytes, dst, width);
+            } else {
+                unpackPackedRowReference(src, rowBytes, dst, width, bits, 1);
+            }
+        }
+    }
+
+private:
+    const int width;
+    const int height;
+    const int bits;
+    const std::size_t rowBytes;
+    std::vector<std::uint8_t> packed;
+    std::vector<std::uint16_t> raw;
+    const PackedRowUnpacker unpack;
+};
+
+std::vector<Kernel> getKernels()
+{
+    std::vector<Kernel> kernels;
+
+    for (int i = 0; i < RAWParams::BayerSensor::numMethods; ++i) {
+        if (i == RAWParams::BayerSensor::mono || i == RAWParams::BayerSensor::none || i == RAWParams::BayerSensor::pixelshift) {
+            continue;
+        }
+
+        const char* method = RAWParams::BayerSensor::methodstring[i];
+        kernels.push_back({std::string("demosaic bayer ") + method, [method](int w, int h) {
+            return new DemosaicBenchmark(w, h, false, method);
+        }});
+    }
+
+    for (int i = 0; i < RAWParams::XTransSensor::numMethods; ++i) {
+        if (i == RAWParams::XTransSensor::mono || i == RAWParams::XTransSensor::none) {
+            continue;
+        }
+
+        const char* method = RAWParams::XTransSensor::methodstring[i];
+        kernels.push_back({std::string("demosaic xtrans ") + method, [method](int w, int h) {
+            return new DemosaicBenchmark(w, h, true, method);
+        }});
+    }
+
+    // the fast path of the previews below 100%
+    kernels.push_back({"demosaic bayer binned", [](int w, int h) {
+        return new DemosaicBenchmark(w, h, false, RAWParams::BayerSensor::methodstring[RAWParams::BayerSensor::fast], true);
+    }});
+    kernels.push_back({"demosaic xtrans binned", [](int w, int h) {
+        return new DemosaicBenchmark(w, h, true, RAWParams::XTransSensor::methodstring[RAWParams::XTransSensor::fast], true);
+    }});
+
+    kernels.push_back({"gaussianBlur", [](int w, int h) { return new GaussianBlurBenchmark(w, h); }});
+    kernels.push_back({"RGB_denoise", [](int w, int h) { return new DenoiseBenchmark(w, h); }});
+    kernels.push_back({"Lanczos", [](int w, int h) { return new LanczosBenchmark(w, h); }});
+    kernels.push_back({"rgbProc", [](int w, int h) { return new RgbProcBenchmark(w, h); }});
+    kernels.push_back({"ciecam_02float", [](int w, int h) { return new CiecamBenchmark(w, h); }});
+    kernels.push_back({"lab2rgb16", [](int w, int h) { return new Lab2Rgb16Benchmark(w, h); }});
+
+    for (const int bits : {10, 12, 14, 16}) {
+        kernels.push_back({"unpack packed " + std::to_string(bits) + " bit", [bits](int w, int h) {
+            return new UnpackBenchmark(w, h, bits);
+        }});
+    }
+
+    return kernels;
+}
+
+std::vector<double> parseList(const char* str)
+{
+    std::vector<double> values;
+    std::istringstream stream(str);
+    std::string item;
+
+    while (std::getline(stream, item, ',')) {
+        values.push_back(atof(item.c_str()));
+    }
+
+    return values;
+}
+
+std::string resultKey(const std::string& kernel, double mp, int threads)
+{
+    std::ostringstream key;
+    key << kernel << '\t' << mp << '\t' << threads;
+    return key.str();
+}
+
+// Reads a file written by --save: one "kernel<TAB>MP<TAB>threads<TAB>MP/s" line per result
+std::map<std::string, double> loadResults(const std::string& fname)
+{
+    std::map<std::string, double> results;
+    std::ifstream file(fname);
+    std::string line;
+
+    while (std::getline(file, line)) {
+        const auto pos = line.rfind('\t');
+
+        if (!line.empty() && line[0] != '#' && pos != std::string::npos) {
+            results[line.substr(0, pos)] = atof(line.c_str() + pos + 1);
+        }
+    }
+
+    return results;
+}
+
+void usage(const char* name)
+{
+    std::cout << "Usage: " << name << " [-s <MP,...>] [-t <threads,...>] [-r <runs>] [-f <filter>] [-l] [-c <target>] [--save <file>] [--baseline <file>] [--tolerance <%>]" << std::endl;
+    std::cout << "  -s <MP,...>         Image sizes in megapixels (default: 2,12,24)." << std::endl;
+    std::cout << "  -t <threads,...>    OpenMP thread counts (default: 1 and all cores)." << std::endl;
+    std::cout << "  -r <runs>           Runs per measurement, the fastest is reported (default: 3)." << std::endl;
+    std::cout << "  -f <filter>         Only run the kernels whose name contains filter." << std::endl;
+    std::cout << "  -l                  List the kernels and exit." << std::endl;
+    std::cout << "  -c <target>         Instruction set of the dispatched kernels: auto, generic or avx2 (default: CpuTarget of options)." << std::endl;
+    std::cout << "  --save <file>       Write the results to file, for use with --baseline." << std::endl;
+    std::cout << "  --baseline <file>   Compare against a previous --save and fail on regressions." << std::endl;
+    std::cout << "  --tolerance <%>     Slowdown tolerated by --baseline (default: 10)." << std::endl;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
+
+    Gio::init ();
+
+#ifdef BUILD_BUNDLE
+    char exname[512] = {0};
+#ifdef WIN32
+    WCHAR exnameU[512] = {0};
+    GetModuleFileNameW (NULL, exnameU, 512);
+    WideCharToMultiByte(CP_UTF8, 0, exnameU, -1, exname, 512, 0, 0 );
+#else
+
+    if (readlink("/proc/self/exe", exname, 512) < 0) {
+        strncpy(exname, argv[0], 512);
+    }
+
+#endif
+    const Glib::ustring exePath = Glib::path_get_dirname(exname);
+    argv0 = Glib::path_is_absolute(DATA_SEARCH_PATH) ? Glib::ustring(DATA_SEARCH_PATH) : Glib::build_filename(exePath, DATA_SEARCH_PATH);
+#else
+    argv0 = DATA_SEARCH_PATH;
+#endif
+
+    std::vector<double> sizes = {2, 12, 24};
+    std::vector<double> threads = {1};
+    int runs = 3;
+    std::string filter, saveFile, baselineFile, cpuTarget;
+    double tolerance = 10.0;
+    bool listOnly = false;
+
+#ifdef _OPENMP
+
+    if (omp_get_num_procs() > 1) {
+        threads.push_back(omp_get_num_procs());
+    }
+
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "-s" && hasValue) {
+            sizes = parseList(argv[++i]);
+        } else if (arg == "-t" && hasValue) {
+            threads = parseList(argv[++i]);
+        } else if (arg == "-r" && hasValue) {
+            runs = std::max(1, atoi(argv[++i]));
+        } else if (arg == "-f" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "-l") {
+            listOnly = true;
+        } else if (arg == "-c" && hasValue) {
+            cpuTarget = argv[++i];
+        } else if (arg == "--save" && hasValue) {
+            saveFile = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            baselineFile = argv[++i];
+        } else if (arg == "--tolerance" && hasValue) {
+            tolerance = atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : -1;
+        }
+    }
+
+    std::vector<Kernel> kernels = getKernels();
+    kernels.erase(std::remove_if(kernels.begin(), kernels.end(), [&filter](const Kernel& kernel) {
+        return kernel.name.find(filter) == std::string::npos;
+    }), kernels.end());
+
+    if (listOnly) {
+        for (const auto& kernel : kernels) {
+            std::cout << kernel.name << std::endl;
+        }
+
+        return 0;
+    }
+
+    // quickstart, the thumbnail cache is of no use here
+    if (!Options::load (true)) {
+        std::cerr << "Fatal error: could not load the options." << std::endl;
+        return -2;
+    }
+
+    if (!cpuTarget.empty()) {
+        rtengine::initCpuTarget(cpuTarget);
+    }
+
+    printf("CPU target: %s\n", rtengine::getCpuTargetName(rtengine::getCpuTarget()));
+
+    // a fast but wrong unpacker is of no use
+    if (std::any_of(kernels.begin(), kernels.end(), [](const Kernel& kernel) { return kernel.name.compare(0, 6, "unpack") == 0; })
+            && !checkPackedRowUnpackers()) {
+        std::cerr << "The packed row unpackers do not match the reference implementation." << std::endl;
+        return 1;
+    }
+
+    const std::map<std::string, double> baseline = baselineFile.empty() ? std::map<std::string, double>() : loadResults(baselineFile);
+    std::ofstream save;
+
+    if (!saveFile.empty()) {
+        save.open(saveFile);
+        save << "# kernel\tMP\tthreads\tMP/s" << std::endl;
+    }
+
+    int regressions = 0;
+
+    printf("%-30s %8s %8s %10s %10s\n", "kernel", "MP", "threads", "MP/s", "baseline");
+
+    for (const auto& kernel : kernels) {
+        for (const double mp : sizes) {
+            // 3:2 aspect ratio, even dimensions so that the CFA pattern is complete
+            const int width = 2 * int(std::sqrt(mp * 1e6 * 1.5) / 2);
+            const int height = 2 * int(width / 3);
+            std::unique_ptr<Benchmark> benchmark(kernel.create(width, height));
+
+            for (const double threadCount : threads) {
+#ifdef _OPENMP
+                omp_set_num_threads(std::max(1, int(threadCount)));
+#endif
+                double best = 0.0;
+
+                for (int run = 0; run < runs; ++run) {
+                    benchmark->prepare();
+                    const auto start = std::chrono::steady_clock::now();
+                    benchmark->run();
+                    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    best = std::max(best, width * double(height) / 1e6 / elapsed.count());
+                }
+
+                const std::string key = resultKey(kernel.name, mp, int(threadCount));
+                const auto reference = baseline.find(key);
+
+                printf("%-30s %8g %8d %10.2f", kernel.name.c_str(), mp, int(threadCount), best);
+
+                if (reference != baseline.end()) {
+                    const double change = 100.0 * (best - reference->second) / reference->second;
+                    const bool regression = change < -tolerance;
+                    printf(" %10.2f %+6.1f%%%s", reference->second, change, regression ? " REGRESSION" : "");
+                    regressions += regression;
+                }
+
+                printf("\n");
+                fflush(stdout);
+
+                if (save.is_open()) {
+                    save << key << '\t' << best << std::endl;
+                }
+            }
+        }
+    }
+
+    if (regressions) {
+        std::cerr << regressions << " measurement(s) more than " << tolerance << "% slower than the baseline." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -42,12 +42,16 @@ SaveFormatPanel::SaveFormatPanel () : listener (nullptr)
     format->append ("TIFF (16 bit)");
     format->append ("PNG (8 bit)");
     format->append ("PNG (16 bit)");
+    format->append ("TIFF (16 bit float)");
+    format->append ("TIFF (32 bit float)");
 
     fstr[0] = "jpg";
     fstr[1] = "tif";
     fstr[2] = "tif";
     fstr[3] = "png";
     fstr[4] = "png";
+    fstr[5] = "tif";
+    fstr[6] = "tif";
 
     hb1->attach (*flab, 0, 0, 1, 1);
     hb1->attach (*format, 1, 0, 1, 1);
@@ -135,6 +139,10 @@ void SaveFormatPanel::init (SaveFormat &sf)
         format->set_active (4);
     } else if (sf.format == "png" && sf.pngBits == 8) {
         format->set_active (3);
+    } else if (sf.format == "tif" && sf.tiffFloat && sf.tiffBits == 32) {
+        format->set_active (6);
+    } else if (sf.format == "tif" && sf.tiffFloat && sf.tiffBits == 16) {
+        format->set_active (5);
     } else if (sf.format == "tif" && sf.tiffBits == 16) {
         format->set_active (2);
     } else if (sf.format == "tif" && sf.tiffBits == 8) {
@@ -164,12 +172,16 @@ SaveFormat SaveFormatPanel::getFormat ()
         sf.pngBits = 8;
     }
 
-    if (sel == 2) {
+    if (sel == 2 || sel == 5) {
         sf.tiffBits = 16;
+    } else if (sel == 6) {
+        sf.tiffBits = 32;
     } else {
         sf.tiffBits = 8;
     }
 
+    sf.tiffFloat = sel == 5 || sel == 6;
+
     sf.pngCompression   = (int) pngCompr->getValue ();
     sf.jpegQuality      = (int) jpegQual->getValue ();
     sf.jpegSubSamp      = jpegSubSamp->get_active_row_number() + 1;
@@ -183,7 +195,7 @@ void SaveFormatPanel::formatChanged ()
 
     int act = format->get_active_row_number();
 
-    if (act < 0 || act > 4) {
+    if (act < 0 || act > 6) {
         return;
     }
 
@@ -213,7 +225,7 @@ void SaveFormatPanel::adjusterChanged (Adjuster* a, double newval)
 
     int act = format->get_active_row_number();
 
-    if (act < 0 || act > 4) {
+    if (act < 0 || act > 6) {
         return;
     }
 
@@ -45,7 +45,7 @@ protected:
     Gtk::Grid*          jpegOpts;
     Gtk::Label*         jpegSubSampLabel;
     FormatChangeListener* listener;
-    Glib::ustring       fstr[5];
+    Glib::ustring       fstr[7];
     Gtk::CheckButton*   savesPP;
 
 
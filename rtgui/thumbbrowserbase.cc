@@ -21,6 +21,7 @@
 #include "multilangmgr.h"
 #include "options.h"
 #include "../rtengine/mytime.h"
+#include "thumbnailscheduler.h"
 
 using namespace std;
 
@@ -855,18 +856,32 @@ bool ThumbBrowserBase::Internal::on_draw(const ::Cairo::RefPtr< Cairo::Context>
     Glib::RefPtr<Pango::Context> context = get_pango_context ();
     context->set_font_description (style->get_font());
 
+    bool moved = false;
+
     {
         MYWRITERLOCK(l, parent->entryRW);
 
         for (size_t i = 0; i < parent->fd.size() && !dirty; i++) { // if dirty meanwhile, cancel and wait for next redraw
-            if (!parent->fd[i]->drawable || !parent->fd[i]->insideWindow (0, 0, w, h)) {
-                parent->fd[i]->updatepriority = false;
+            int viewDistance = 0;
+
+            if (!parent->fd[i]->drawable) {
+                viewDistance = INT_MAX / 2;
+            } else if (!parent->fd[i]->insideWindow (0, 0, w, h)) {
+                viewDistance = parent->fd[i]->getDistanceToWindow (0, 0, w, h);
             } else {
-                parent->fd[i]->updatepriority = true;
                 parent->fd[i]->draw (cr);
             }
+
+            if (parent->fd[i]->viewDistance.exchange(viewDistance, std::memory_order_relaxed) != viewDistance) {
+                moved = true;
+            }
         }
     }
+
+    if (moved) {
+        // the queued thumbnail jobs follow their thumbnails
+        ThumbnailScheduler::getInstance()->updatePriorities();
+    }
     style->render_frame(cr, 0., 0., w, h);
 
     return true;
@@ -16,6 +16,8 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
+
 #include "thumbbrowserentrybase.h"
 #include "thumbbrowserbase.h"
 #include "options.h"
@@ -29,7 +31,7 @@ ThumbBrowserEntryBase::ThumbBrowserEntryBase (const Glib::ustring& fname)
       parent(nullptr), original(nullptr), bbSelected(false), bbFramed(false), bbPreview(nullptr), cursor_type(CSUndefined),
       thumbnail(nullptr), filename(fname), shortname(dispname), exifline(""), datetimeline(""),
       selected(false), drawable(false), filtered(false), framed(false), processing(false), italicstyle(false),
-      edited(false), recentlysaved(false), updatepriority(false), withFilename(WFNAME_NONE) {}
+      edited(false), recentlysaved(false), viewDistance(INT_MAX / 2), withFilename(WFNAME_NONE) {}
 
 ThumbBrowserEntryBase::~ThumbBrowserEntryBase ()
 {
@@ -555,6 +557,14 @@ bool ThumbBrowserEntryBase::insideWindow (int x, int y, int w, int h)
     return !(ofsX + startx > x + w || ofsX + startx + exp_width < x || ofsY + starty > y + h || ofsY + starty + exp_height < y);
 }
 
+int ThumbBrowserEntryBase::getDistanceToWindow (int x, int y, int w, int h)
+{
+
+    const int dx = std::max({0, x - (ofsX + startx + exp_width), ofsX + startx - (x + w)});
+    const int dy = std::max({0, y - (ofsY + starty + exp_height), ofsY + starty - (y + h)});
+    return dx + dy;
+}
+
 std::vector<Glib::RefPtr<Gdk::Pixbuf> > ThumbBrowserEntryBase::getIconsOnImageArea()
 {
     return std::vector<Glib::RefPtr<Gdk::Pixbuf> >();
@@ -19,6 +19,9 @@
 #ifndef _THUMBNAILBROWSERENTRYBASE_
 #define _THUMBNAILBROWSERENTRYBASE_
 
+#include <atomic>
+#include <climits>
+
 #include <gtkmm.h>
 #include "lwbuttonset.h"
 #include "thumbnail.h"
@@ -107,7 +110,7 @@ public:
     bool italicstyle;
     bool edited;
     bool recentlysaved;
-    bool updatepriority;
+    std::atomic<int> viewDistance; // distance in pixels to the visible area of the browser, 0 if visible, also read by the thumbnail workers
     eWithFilename withFilename;
 
     explicit ThumbBrowserEntryBase   (const Glib::ustring& fname);
@@ -164,6 +167,7 @@ public:
     bool inside             (int x, int y);
     void getPosInImgSpace   (int x, int y, rtengine::Coord2D &coord);
     bool insideWindow       (int x, int y, int w, int h);
+    int getDistanceToWindow (int x, int y, int w, int h);
     void setPosition        (int x, int y, int w, int h);
     void setOffset (int x, int y);
 
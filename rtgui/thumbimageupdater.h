@@ -62,16 +62,14 @@ public:
     /**
      * @brief Add an thumbnail image update request.
      *
-     * Code will add the request to the queue and, if needed, start a pool
-     * thread to process it.
+     * Code will add the request to the queue of the ThumbnailScheduler,
+     * ordered by the distance of the entry to the visible part of the browser.
      *
-     * @param t thumbnail
-     * @param params processing params (?)
-     * @param height how big
-     * @param priority if \c true then run as soon as possible
+     * @param tbe thumbnail browser entry
+     * @param upgrade if \c true then upgrade a quick thumbnail to a processed one
      * @param l listener waiting on update
      */
-    void add(ThumbBrowserEntryBase* tbe, bool* priority, bool upgrade, ThumbImageUpdateListener* l);
+    void add(ThumbBrowserEntryBase* tbe, bool upgrade, ThumbImageUpdateListener* l);
 
     /**
      * @brief Remove jobs associated with listener \c l.
@@ -93,9 +91,6 @@ public:
 private:
 
     ThumbImageUpdater();
-
-    class Impl;
-    Impl* impl_;
 };
 
 /**
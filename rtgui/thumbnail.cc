@@ -154,7 +154,7 @@ void Thumbnail::_generateThumbnailImage ()
         cfs.supported = true;
         needsReProcessing = true;
 
-        cfs.save (getCacheFileName ("data", ".txt"));
+        saveCacheImageData ();
 
         generateExifDateTimeStrings ();
     }
@@ -470,7 +470,7 @@ void Thumbnail::imageDeveloped ()
 {
 
     cfs.recentlySaved = true;
-    cfs.save (getCacheFileName ("data", ".txt"));
+    saveCacheImageData ();
 
     if (options.saveParamsCache) {
         pparams.save (getCacheFileName ("profiles", paramFileExtension));
@@ -770,7 +770,7 @@ int Thumbnail::infoFromImage (const Glib::ustring& fname, rtengine::RawMetaDataL
 /*
  * Read all thumbnail's data from the cache; build and save them if doesn't exist - NON PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -785,15 +785,21 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
     tpp = new rtengine::Thumbnail ();
     tpp->isRaw = (cfs.format == (int) FT_Raw);
 
+    const CacheStore& store = cachemgr->getStore ();
+
     // load supplementary data
-    bool succ = tpp->readData (getCacheFileName ("data", ".txt"));
+    const auto data = store.get (cfs.md5, CacheStore::Kind::DATA);
+    bool succ = data && tpp->readData (data.data (), data.size ());
 
     if (succ) {
         tpp->getAutoWBMultipliers(cfs.redAWBMul, cfs.greenAWBMul, cfs.blueAWBMul);
     }
 
     // thumbnail image
-    succ = succ && tpp->readImage (getCacheFileName ("images", ""));
+    if (succ) {
+        const auto image = store.get (cfs.md5, CacheStore::Kind::IMAGE);
+        succ = image && tpp->readImage (image.data (), image.size ());
+    }
 
     if (!succ && firstTrial) {
         _generateThumbnailImage ();
@@ -813,10 +819,12 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
 
     if ( cfs.thumbImgType == CacheImageData::FULL_THUMBNAIL ) {
         // load aehistogram
-        tpp->readAEHistogram (getCacheFileName ("aehistograms", ""));
+        const auto aeHistogram = store.get (cfs.md5, CacheStore::Kind::AE_HISTOGRAM);
+        tpp->readAEHistogram (aeHistogram.data (), aeHistogram.size ());
 
         // load embedded profile
-        tpp->readEmbProfile (getCacheFileName ("embprofiles", ".icc"));
+        const auto embProfile = store.get (cfs.md5, CacheStore::Kind::EMB_PROFILE);
+        tpp->readEmbProfile (embProfile.data (), embProfile.size ());
 
         tpp->init ();
     }
@@ -829,7 +837,7 @@ void Thumbnail::_loadThumbnail(bool firstTrial)
 /*
  * Read all thumbnail's data from the cache; build and save them if doesn't exist - MUTEX PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -843,7 +851,7 @@ void Thumbnail::loadThumbnail (bool firstTrial)
 /*
  * Save thumbnail's data to the cache - NON PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -855,30 +863,54 @@ void Thumbnail::_saveThumbnail ()
         return;
     }
 
-    if (g_remove (getCacheFileName ("images", ".rtti").c_str ()) != 0) {
-        // No file deleted, so we try to deleted obsolete files, if any
-        g_remove (getCacheFileName ("images", ".cust").c_str ());
-        g_remove (getCacheFileName ("images", ".cust16").c_str ());
-        g_remove (getCacheFileName ("images", ".jpg").c_str ());
-    }
+    CacheStore& store = cachemgr->getStore ();
+    std::string data;
 
     // save thumbnail image
-    tpp->writeImage (getCacheFileName ("images", ""), 1);
+    if (tpp->writeImage (data)) {
+        store.put (cfs.md5, CacheStore::Kind::IMAGE, data);
+    } else {
+        store.remove (cfs.md5, false);
+    }
 
     // save aehistogram
-    tpp->writeAEHistogram (getCacheFileName ("aehistograms", ""));
+    if (tpp->writeAEHistogram (data)) {
+        store.put (cfs.md5, CacheStore::Kind::AE_HISTOGRAM, data);
+    }
 
     // save embedded profile
-    tpp->writeEmbProfile (getCacheFileName ("embprofiles", ".icc"));
+    if (tpp->writeEmbProfile (data)) {
+        store.put (cfs.md5, CacheStore::Kind::EMB_PROFILE, data);
+    }
 
     // save supplementary data
-    tpp->writeData (getCacheFileName ("data", ".txt"));
+    const auto record = store.get (cfs.md5, CacheStore::Kind::DATA);
+    data = record ? std::string (record.data (), record.size ()) : std::string ();
+
+    if (tpp->writeData (data)) {
+        store.put (cfs.md5, CacheStore::Kind::DATA, data);
+    }
+}
+
+/*
+ * Save the CacheImageData values to the image data record, keeping the values stored by rtengine::Thumbnail
+ */
+void Thumbnail::saveCacheImageData ()
+{
+    CacheStore& store = cachemgr->getStore ();
+
+    const auto record = store.get (cfs.md5, CacheStore::Kind::DATA);
+    std::string data = record ? std::string (record.data (), record.size ()) : std::string ();
+
+    if (cfs.save (data) == 0) {
+        store.put (cfs.md5, CacheStore::Kind::DATA, data);
+    }
 }
 
 /*
  * Save thumbnail's data to the cache - MUTEX PROTECTED
  * This includes:
- *  - image's bitmap (*.rtti)
+ *  - image's bitmap
  *  - auto exposure's histogram (full thumbnail only)
  *  - embedded profile (full thumbnail only)
  *  - LiveThumbData section of the data file
@@ -907,7 +939,7 @@ void Thumbnail::updateCache (bool updatePParams, bool updateCacheImageData)
     }
 
     if (updateCacheImageData) {
-        cfs.save (getCacheFileName ("data", ".txt"));
+        saveCacheImageData ();
     }
 }
 
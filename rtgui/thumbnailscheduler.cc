@@ -0,0 +1,240 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "thumbnailscheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "guiutils.h"
+#include "options.h"
+
+#include "../rtengine/taskscheduler.h"
+
+ThumbnailScheduler* ThumbnailScheduler::getInstance ()
+{
+    // never destroyed, as the workers wait on its members until the end of the process
+    static ThumbnailScheduler* const instance = new ThumbnailScheduler ();
+    return instance;
+}
+
+ThumbnailScheduler::ThumbnailScheduler () :
+    prioritiesOutdated(false),
+    sequence(0),
+    maxQueued(0),
+    decoding(0),
+    completed(0),
+    cancelled(0),
+    totalWait(0.0),
+    maxWait(0.0),
+    totalRun(0.0)
+{
+    int threadCount = 1;
+#if !(__GNUC__ == 4 && __GNUC_MINOR__ == 8 && defined( WIN32 ) && defined(__x86_64__))
+    // See Issue 2431 for explanation
+#ifdef _OPENMP
+    threadCount = omp_get_num_procs();
+#else
+    threadCount = 2;
+#endif
+#endif
+
+    for (int i = 0; i < threadCount; ++i) {
+        Glib::Threads::Thread::create(sigc::mem_fun(*this, &ThumbnailScheduler::work));
+    }
+}
+
+bool ThumbnailScheduler::add (const void* group, const void* owner, const std::string& tag, Priority priority, bool decodes, Job job)
+{
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    const auto existing = queuedByKey.find(Key(group, owner, tag));
+
+    if (existing != queuedByKey.end()) {
+        const auto entry = existing->second;
+        // keeps its place among the jobs of equal priority
+        ready[entry->decodes].erase(entry);
+        entry->priority = std::move(priority);
+        entry->decodes = decodes;
+        entry->job = std::move(job);
+        entry->currentPriority = entry->priority();
+        ready[entry->decodes].insert(entry);
+        return false;
+    }
+
+    queued.push_back({group, owner, tag, std::move(priority), decodes, std::move(job), Clock::now(), sequence++, 0});
+    const auto entry = std::prev(queued.end());
+    entry->currentPriority = entry->priority();
+    link(entry);
+    maxQueued = std::max(maxQueued, queued.size());
+    jobAvailable.signal();
+    return true;
+}
+
+std::size_t ThumbnailScheduler::cancel (const void* group, const void* owner, bool wait)
+{
+    const auto matches = [group, owner](const Entry& entry) {
+        return entry.group == group && (!owner || entry.owner == owner);
+    };
+
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    std::size_t removed = 0;
+
+    for (auto entry = queued.begin(); entry != queued.end();) {
+        if (matches(*entry)) {
+            unlink(entry);
+            entry = queued.erase(entry);
+            ++removed;
+        } else {
+            ++entry;
+        }
+    }
+
+    cancelled += removed;
+
+    while (wait && std::any_of(running.begin(), running.end(), matches)) {
+        // XXX this is nasty... it would be nicer if we weren't called with
+        // this lock held
+        GThreadUnLock unlock;
+        jobFinished.wait(mutex);
+    }
+
+    return removed;
+}
+
+void ThumbnailScheduler::updatePriorities ()
+{
+    Glib::Threads::Mutex::Lock lock(mutex);
+    prioritiesOutdated = true;
+}
+
+ThumbnailScheduler::Statistics ThumbnailScheduler::getStatistics () const
+{
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    return {
+        queued.size(),
+        maxQueued,
+        running.size(),
+        completed,
+        cancelled,
+        completed ? totalWait / completed : 0.0,
+        maxWait,
+        completed ? totalRun / completed : 0.0
+    };
+}
+
+void ThumbnailScheduler::link (Entries::iterator entry)
+{
+    queuedByKey.emplace(Key(entry->group, entry->owner, entry->tag), entry);
+    ready[entry->decodes].insert(entry);
+}
+
+void ThumbnailScheduler::unlink (Entries::iterator entry)
+{
+    queuedByKey.erase(Key(entry->group, entry->owner, entry->tag));
+    ready[entry->decodes].erase(entry);
+}
+
+void ThumbnailScheduler::evaluatePriorities ()
+{
+    for (auto& jobs : ready) {
+        jobs.clear();
+    }
+
+    for (auto entry = queued.begin(); entry != queued.end(); ++entry) {
+        entry->currentPriority = entry->priority();
+        ready[entry->decodes].insert(entry);
+    }
+
+    prioritiesOutdated = false;
+}
+
+ThumbnailScheduler::Entries::iterator ThumbnailScheduler::pick ()
+{
+    if (prioritiesOutdated) {
+        evaluatePriorities();
+    }
+
+    const bool decodeAllowed = options.thumbnailDecodeLimit <= 0 || decoding < static_cast<std::size_t>(options.thumbnailDecodeLimit);
+
+    const Ready& other = ready[false];
+    const Ready& decoders = ready[true];
+
+    if (decodeAllowed && !decoders.empty() && (other.empty() || Order()(*decoders.begin(), *other.begin()))) {
+        return *decoders.begin();
+    }
+
+    return other.empty() ? queued.end() : *other.begin();
+}
+
+void ThumbnailScheduler::work ()
+{
+    Glib::Threads::Mutex::Lock lock(mutex);
+
+    while (true) {
+        const auto next = pick();
+
+        if (next == queued.end()) {
+            jobAvailable.wait(mutex);
+            continue;
+        }
+
+        const auto started = Clock::now();
+        const double waited = std::chrono::duration<double, std::milli>(started - next->added).count();
+
+        // moved to the running jobs, so that cancel() can wait for it
+        unlink(next);
+        running.splice(running.end(), queued, next);
+
+        if (next->decodes) {
+            ++decoding;
+        }
+
+        lock.release();
+
+        {
+            rtengine::TaskScheduler::Scope scope(rtengine::TaskScheduler::Priority::THUMBNAIL);
+            next->job();
+        }
+
+        lock.acquire();
+
+        if (next->decodes) {
+            --decoding;
+            // a job skipped because of the limit may run now
+            jobAvailable.signal();
+        }
+
+        ++completed;
+        totalWait += waited;
+        maxWait = std::max(maxWait, waited);
+        totalRun += std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+        running.erase(next);
+        jobFinished.broadcast();
+
+        if (options.rtSettings.verbose && queued.empty() && running.empty()) {
+            printf("Thumbnail jobs: %lu completed, %lu cancelled, %lu queued at most, wait %.1f ms (mean) %.1f ms (max), run %.1f ms (mean)\n",
+                   completed, cancelled, static_cast<unsigned long>(maxQueued), totalWait / completed, maxWait, totalRun / completed);
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+
+#include <glibmm.h>
+
+#include "../rtengine/noncopyable.h"
+
+/**
+ * Worker threads shared by the PreviewLoader and the ThumbImageUpdater.
+ *
+ * The priority of a queued job is a function, evaluated when the job is
+ * added and again after updatePriorities(), so that a job follows the
+ * position of its thumbnail in the file browser (see
+ * ThumbBrowserEntryBase::viewDistance) without being queued again. Jobs
+ * which decode a raw or image file are limited to
+ * options.thumbnailDecodeLimit at a time, to keep the disk reading
+ * sequentially.
+ */
+class ThumbnailScheduler :
+    public rtengine::NonCopyable
+{
+public:
+    // lower values run first, jobs of equal priority in the order they were added
+    using Priority = std::function<int ()>;
+    using Job = std::function<void ()>;
+
+    struct Statistics {
+        std::size_t queued;
+        std::size_t maxQueued;
+        std::size_t running;
+        unsigned long completed;
+        unsigned long cancelled;
+        double meanWait;    // in ms, from add() to the start of the completed jobs
+        double maxWait;
+        double meanRun;     // in ms
+    };
+
+    static ThumbnailScheduler* getInstance ();
+
+    /**
+     * @brief Queues a job.
+     *
+     * A job already queued with the same group, owner and tag is replaced.
+     *
+     * @param group the component adding the job
+     * @param owner the object the job is done for, see cancel()
+     * @param tag distinguishes the jobs of an owner
+     * @param priority evaluated with the scheduler locked, so it must neither block nor add jobs
+     * @param decodes true if the job decodes a raw or image file
+     * @param job the job, run without any lock held
+     * @return true if the job has been added, false if it replaced another one
+     */
+    bool add (const void* group, const void* owner, const std::string& tag, Priority priority, bool decodes, Job job);
+
+    /**
+     * @brief Removes the queued jobs of an owner, or of the whole group if owner is nullptr.
+     *
+     * @param wait if true, also waits for the running jobs of the owner. The GUI lock has to be held
+     *             by the caller in that case, it is released meanwhile.
+     * @return the number of removed jobs
+     */
+    std::size_t cancel (const void* group, const void* owner, bool wait);
+
+    /** Has the priorities of the queued jobs evaluated again before the next job is picked */
+    void updatePriorities ();
+
+    Statistics getStatistics () const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        const void* group;
+        const void* owner;
+        std::string tag;
+        Priority priority;
+        bool decodes;
+        Job job;
+        Clock::time_point added;
+        unsigned long sequence;     // order of addition among the jobs of equal priority
+        int currentPriority;        // last result of priority
+    };
+
+    using Entries = std::list<Entry>;
+    using Key = std::tuple<const void*, const void*, std::string>;
+
+    struct Order {
+        bool operator() (Entries::const_iterator a, Entries::const_iterator b) const
+        {
+            return a->currentPriority < b->currentPriority || (a->currentPriority == b->currentPriority && a->sequence < b->sequence);
+        }
+    };
+
+    // the queued jobs by priority, the ones which do not decode and the ones which do
+    using Ready = std::set<Entries::iterator, Order>;
+
+    ThumbnailScheduler ();
+
+    void link (Entries::iterator entry);
+    void unlink (Entries::iterator entry);
+    void evaluatePriorities ();
+    Entries::iterator pick ();
+    void work ();
+
+    // Glib::Threads::Mutex rather than MyMutex, because it is used with Glib::Threads::Cond
+    mutable Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond jobAvailable;
+    Glib::Threads::Cond jobFinished;
+    Entries queued;
+    std::map<Key, Entries::iterator> queuedByKey;
+    std::array<Ready, 2> ready;
+    bool prioritiesOutdated;
+    unsigned long sequence;
+    Entries running;
+    std::size_t maxQueued;
+    std::size_t decoding;
+    unsigned long completed;
+    unsigned long cancelled;
+    double totalWait;
+    double maxWait;
+    double totalRun;
+};